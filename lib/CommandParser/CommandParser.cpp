@@ -0,0 +1,77 @@
+#include <CommandParser.h>
+
+static bool isSeparator(char c)
+{
+    return c == ' ' || c == ',' || c == '\t' || c == '\r' || c == '\n';
+}
+
+CommandParser::CommandParser(const char* buf, uint16_t len)
+: m_buf(buf),
+  m_length(len),
+  m_command(ILLEGAL_COMMAND),
+  m_count(0),
+  m_valid(true)
+{
+    /* Skip leading whitespace, netcat and friends love a newline */
+    uint16_t i = 0;
+    while(i < len && isSeparator(buf[i])) i++;
+
+    if(i >= len) return;
+    m_command = buf[i++];
+
+    while(i < len)
+    {
+        if(isSeparator(buf[i]))
+        {
+            i++;
+            continue;
+        }
+
+        int32_t value;
+        if(m_count >= COMMAND_MAX_ARGUMENTS || !parseInteger(i, value))
+        {
+            m_valid = false;
+            return;
+        }
+        m_arguments[m_count++] = value;
+    }
+}
+
+bool CommandParser::hasArgument(int32_t min, int32_t max, uint8_t index)
+{
+    if(!m_valid || index >= m_count) return false;
+    return min <= m_arguments[index] && m_arguments[index] <= max;
+}
+
+/* Parses [+-]digits starting at i, leaving i on the first unused char */
+bool CommandParser::parseInteger(uint16_t& i, int32_t& value)
+{
+    bool negative = false;
+    if(m_buf[i] == '-' || m_buf[i] == '+')
+    {
+        negative = m_buf[i] == '-';
+        i++;
+    }
+
+    /* Accumulate negatively so INT32_MIN is representable */
+    int32_t  result = 0;
+    uint8_t  digits = 0;
+    while(i < m_length && m_buf[i] >= '0' && m_buf[i] <= '9')
+    {
+        int8_t digit = m_buf[i++] - '0';
+        if(result < (INT32_MIN + digit) / 10) return false; // Overflow
+        result = result * 10 - digit;
+        digits++;
+    }
+
+    /* Must be followed by a separator or the end of the buffer */
+    if(digits == 0 || (i < m_length && !isSeparator(m_buf[i]))) return false;
+
+    if(!negative)
+    {
+        if(result == INT32_MIN) return false;
+        result = -result;
+    }
+    value = result;
+    return true;
+}
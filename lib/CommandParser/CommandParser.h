@@ -0,0 +1,52 @@
+#ifndef COMMAND_PARSER
+#define COMMAND_PARSER 1
+
+#include <stdint.h> // Precise type allocation
+
+#define ILLEGAL_COMMAND         '`'
+#define COMMAND_MAX_ARGUMENTS   4
+
+/* Tokenises a single command in place, the buffer is never copied
+   and never read beyond 'len', so it need not be NUL terminated.
+
+   Format: <command>[<arg>][ <arg>...], e.g. "4123", "8 -30", "x 1,2"
+   Arguments are signed 32-bit decimals separated by spaces or commas. */
+class CommandParser{
+
+    public:
+
+        CommandParser(const char* buf, uint16_t len);
+
+        char    getCommand()        {return m_command;}
+        uint8_t getArgumentCount()  {return m_count;}
+        int32_t getArgument(uint8_t index = 0)
+        {
+            return index < m_count ? m_arguments[index] : 0;
+        }
+
+        /* True if argument 'index' exists and min <= argument <= max */
+        bool    hasArgument(int32_t min, int32_t max, uint8_t index = 0);
+
+        bool    hasParameter()      {return m_count > 0;}
+        bool    hasCommand()        {return m_command != ILLEGAL_COMMAND;}
+
+        /* False if any argument was malformed or overflowed */
+        bool    isValid()           {return m_valid;}
+
+        const char* getBuffer()     {return m_buf;}
+        uint16_t    getLength()     {return m_length;}
+
+    private:
+
+        const char* m_buf;
+        uint16_t    m_length;
+        char        m_command;
+        int32_t     m_arguments[COMMAND_MAX_ARGUMENTS];
+        uint8_t     m_count;
+        bool        m_valid;
+
+        bool        parseInteger(uint16_t& i, int32_t& value);
+
+};
+
+#endif
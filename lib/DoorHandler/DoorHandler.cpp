@@ -3,10 +3,37 @@
 #include <Dusk2Dawn.h>
 #include <ctime>
 #include "time.h"
+#include <Logger.h>
 
-#define MIN_DIFF_IN_LIGHT   5
 #define MOTOR_STEP_DELAY    1    // 100 millisecond delay
-#define ENCODER_MULTIPLIER  3000
+#define ENCODER_MULTIPLIER  3000 // Counts per position step, EEPROM layouts before 5
+#define MOTOR_SPINUP_TIME   1500 // ms, motor reaches RPM in 1.3s down and 1.44s up
+#define MOTOR_SETTLE_TIME   2500 // ms, door is left to settle before saving
+#define D_MOTOR_STALL_TIME  200  // ms without an encoder edge, or held back, before a moving door counts as jammed
+
+/* Speed profile and position loop, see MotorProfile and control() */
+#define MOTOR_FULL_SPEED    6000 // counts/s at full duty, door attached
+#define MOTOR_PLAN_SPEED    5400 // Fastest cruise planned, leaves the loop some headroom
+#define MOTOR_VELOCITY_AGE  100  // ms, an encoder velocity older than this is from the last move
+#define CONTROL_TOLERANCE   30   // counts either side of the target, 1% of a position
+#define CONTROL_REST_TIME   50   // ms on target without an encoder edge, the door has stopped
+#define CONTROL_SETTLE_TIME 3000 // ms after the profile ends for the door to come to rest, at least
+
+/* Obstructions, see heldBack() and obstructMotion() */
+#define OBSTRUCTION_SPEED     25   // %, a door this far below the planned speed is held back
+#define OBSTRUCTION_MIN_SPEED 1000 // counts/s, plans slower than this aren't checked, the ends of the ramps
+#define OBSTRUCTION_REVERSE   3000 // counts the door backs up after hitting something closing
+#define OBSTRUCTION_RETRIES   3    // Closes tried again before the door counts as blocked
+#define OBSTRUCTION_BACKOFF   5000 // ms before the first retry, doubling for each after
+
+/* Travel calibration, see calibrate() */
+#define CALIBRATION_DUTY       512   // Half power, end stops are found gently
+#define CALIBRATION_MARGIN     300   // counts the learned top is kept short of the top stop
+#define CALIBRATION_MIN_TRAVEL 3000  // counts, less between the stops and something is in the way
+#define CALIBRATION_TIMEOUT    60000 // ms, a pass this long never found its stop
+#define CALIBRATE_HOME         0     // Down onto the bottom stop from wherever the door is
+#define CALIBRATE_UP           1
+#define CALIBRATE_DOWN         2
 
 /* Macros for struct time       */
 #define SECOND              0
@@ -30,34 +57,53 @@
 #define MOTOR_SAVED_ENABLE      8
 #define MOTOR_MOVE_TIME         9
 #define TIME_ENABLE             10
+#define LAYOUT_VERSION          11
+#define MOTOR_ACCEL_TIME        12
+#define MOTOR_DECEL_TIME        13
+#define MOTOR_PROFILE_SHAPE     14
+#define CONTROL_GAINS           15
+#define CALIBRATION             16
 #define RESET                   99
 
+/* Bump when the EEPROM layout changes, see migrateSettings()
+   1 - Original, close offset unsigned byte at 5
+   2 - Close offset signed 16-bit at 12-13
+   3 - Motor accel, decel and profile shape at 14-16
+   4 - Position loop gains, 4 x uint16 thousandths at 17-24
+   5 - Position and top position int32 counts at 25-32, not
+       uint8 steps of ENCODER_MULTIPLIER at 1-2
+   6 - Calibrated speeds and travel times, 2 x uint16 each at
+       33-36 and 37-40, down first                            */
+#define EEPROM_LAYOUT           6
+#define CLOSE_OFFSET_ADDRESS    12
+#define MOTOR_ACCEL_ADDRESS     14
+#define MOTOR_DECEL_ADDRESS     15
+#define MOTOR_PROFILE_ADDRESS   16
+#define CONTROL_GAINS_ADDRESS   17
+#define MOTOR_POSITION_ADDRESS  25
+#define MOTOR_TOP_ADDRESS       29
+#define MOTOR_SPEED_ADDRESS     33
+#define TRAVEL_TIME_ADDRESS     37
+
 /* Macros for door and time      */
 #define DAY                     true
 #define NIGHT                   false
 #define OPEN_DOOR               true
 #define CLOSE_DOOR              false
 
-/* Default settings, written to EEPROM on init */
-#define D_MTR_STOP_TOP            10
-#define D_LIGHT_THRESHOLD_TOP     37    // Assumed with 200k~ LDR and 10k resistor in voltage divider
-#define D_LIGHT_THRESHOLD_BOTTOM  25
+/* Default settings, written to EEPROM on init, more in DoorHandler.h */
 #define D_CLOSE_OFFSET            0
 #define D_AUTOMATION_ENABLE       true
 #define D_LDR_ENABLE              false
 #define D_MOTOR_SAVED_ENABLE      true
 #define D_MOTOR_MOVE_TIME         75 // This value represents n*100ms where ms is milliseconds
 #define D_TIME_ENABLE             true
-
-#define DEBUG 1
-// end definitions
-#ifdef DEBUG
-    #define debug(x)   Serial.print (x)
-    #define debugln(x) Serial.println (x)
-#else
-    #define debug(x)
-    #define debugln(x)
-#endif
+#define D_MOTOR_ACCEL_TIME        10 // n*100ms, the motor took 1.3s to reach speed at full power
+#define D_MOTOR_DECEL_TIME        15 // n*100ms
+#define D_CONTROL_KP              4000  // Gains in thousandths, tuned with tools/motorsim
+#define D_CONTROL_KI              300
+#define D_CONTROL_KD              300
+#define D_CONTROL_KFF             170   // MOTOR_DUTY_MAX / MOTOR_FULL_SPEED
 
 
 //51.1497923,-0.23745
@@ -84,7 +130,9 @@ DoorHandler::DoorHandler(uint8_t mtrPin1, uint8_t mtrPin2, uint8_t encoderPin1,
 : m_mtrPin1(mtrPin1),
   m_mtrPin2(mtrPin2),
   m_encoder(encoderPin1, encoderPin2),
-  m_ldrPin(ldrPin)
+  m_motor(mtrPin1, mtrPin2),
+  m_ldrPin(ldrPin),
+  m_controller(DOOR_CONTROL_PERIOD/1000000.0f, MOTOR_DUTY_MAX)
 {
     /* Set these to 'off' by default until EEPROM is ready */
     m_ldrEnabled  = 0;
@@ -104,7 +152,32 @@ DoorHandler::DoorHandler(uint8_t mtrPin1, uint8_t mtrPin2, uint8_t encoderPin1,
     pinMode(m_ldrPin, INPUT);
 
     m_closed = true;
+    m_stalled = false;
     m_eepromNeedsSaving = false;
+    m_batching = false;
+
+    m_motionState = MOTION_IDLE;
+    m_direction = CLOSE_DOOR;
+    m_motionTimer = 0;
+    m_motionStartCount = 0;
+    m_stallTime = D_MOTOR_STALL_TIME;
+    m_motionTarget = 0;
+    m_overshoot = 0;
+    m_settleTime = CONTROL_SETTLE_TIME;
+    m_controlSteps = 0;
+    m_controlling = false;
+    m_controlPosition = 0;
+    m_heldBack = false;
+    m_heldSince = 0;
+    m_reversing = false;
+    m_blocked = false;
+    m_retries = 0;
+    m_calibrationStep = CALIBRATE_HOME;
+    m_calibrationPeak = 0;
+    m_calibrationStop = 0;
+    m_motorSpeed[0] = m_motorSpeed[1] = 0;
+    m_travelTime[0] = m_travelTime[1] = 0;
+    m_pollCount = 0;
 }
 
 void DoorHandler::configureNTP()
@@ -119,46 +192,48 @@ void DoorHandler::configureNTP()
 uint8_t DoorHandler::setLightUpperThreshold(uint8_t value)
 {
     /* If the value suggested is inadequate then stop here. */
-    if(value <= 0 || value <= m_lightLowerThreshold || value >= 255)
-    {
-        return m_lightUpperThreshold;
-    }
-    else
+    if(validLightThresholds(value, m_lightLowerThreshold))
     {
-        // Need signed so we don't underflow
-        int8_t difference = value - m_lightLowerThreshold;
-        if(difference >= MIN_DIFF_IN_LIGHT)
-        {
-            saveSetting(LIGHT_THRESHOLD_TOP);
-            m_lightUpperThreshold = value;
-        }
-        return m_lightUpperThreshold;
+        m_lightUpperThreshold = value;
+        saveSetting(LIGHT_THRESHOLD_TOP);
     }
+    return m_lightUpperThreshold;
 }
 
 uint8_t DoorHandler::setLightLowerThreshold(uint8_t value)
 {
     /* If the value suggested is inadequate then stop here. */
-    if(value > 255 || value >= m_lightUpperThreshold)
+    if(validLightThresholds(m_lightUpperThreshold, value))
     {
-        return m_lightLowerThreshold;
+        m_lightLowerThreshold = value;
+        saveSetting(LIGHT_THRESHOLD_BOTTOM);
     }
-    else
+    return m_lightLowerThreshold;
+}
+
+/* Both at once, for a pair neither setter alone could reach from the
+   current one, e.g. 40 and 60 from 25 and 37. False if refused.     */
+bool DoorHandler::setLightThresholds(uint8_t upper, uint8_t lower)
+{
+    if(!validLightThresholds(upper, lower)) return false;
+
+    if(upper != m_lightUpperThreshold)
     {
-        int8_t difference = m_lightUpperThreshold - value;
-        if(difference >= MIN_DIFF_IN_LIGHT)
-        {
-            saveSetting(LIGHT_THRESHOLD_BOTTOM);
-            m_lightLowerThreshold = value;
-        }
-        return m_lightLowerThreshold;
+        m_lightUpperThreshold = upper;
+        saveSetting(LIGHT_THRESHOLD_TOP);
+    }
+    if(lower != m_lightLowerThreshold)
+    {
+        m_lightLowerThreshold = lower;
+        saveSetting(LIGHT_THRESHOLD_BOTTOM);
     }
+    return true;
 }
 
-uint8_t DoorHandler::setTopPosition(uint8_t value)
+int32_t DoorHandler::setTopPosition(int32_t value)
 {
     /* Setting an incredibly high value can be dangerous - caution advised */
-    if(value > 0 && value < 255)
+    if(validTopPosition(value))
     {
         m_motorTopPosition = value;
         saveSetting(MTR_STOP_TOP);
@@ -181,10 +256,47 @@ uint8_t DoorHandler::setMotorMoveSpeed(uint8_t value)
 {
     if(value == 0) value = 1;
     m_motorMoveTime = value;
+    saveSetting(MOTOR_MOVE_TIME);
     return m_motorMoveTime;
 }
 
-void DoorHandler::setDoorCloseTime(uint8_t value)
+uint8_t DoorHandler::setMotorAccelTime(uint8_t value)
+{
+    m_motorAccelTime = value;
+    saveSetting(MOTOR_ACCEL_TIME);
+    return m_motorAccelTime;
+}
+
+uint8_t DoorHandler::setMotorDecelTime(uint8_t value)
+{
+    m_motorDecelTime = value;
+    saveSetting(MOTOR_DECEL_TIME);
+    return m_motorDecelTime;
+}
+
+uint8_t DoorHandler::setMotorProfile(uint8_t shape)
+{
+    if(validMotorProfile(shape))
+    {
+        m_motorProfile = shape;
+        saveSetting(MOTOR_PROFILE_SHAPE);
+    }
+    return m_motorProfile;
+}
+
+void DoorHandler::setGains(const PositionGains& gains)
+{
+    m_controller.setGains(gains);
+    saveSetting(CONTROL_GAINS);
+}
+
+uint16_t DoorHandler::setStallTime(uint16_t value)
+{
+    if(value > 0) m_stallTime = value;
+    return m_stallTime;
+}
+
+void DoorHandler::setDoorCloseTime(int16_t value)
 {
     m_minuteOffset = value;
     saveSetting(CLOSE_OFFSET);
@@ -192,7 +304,7 @@ void DoorHandler::setDoorCloseTime(uint8_t value)
 
 void DoorHandler::setTimeEnabled(bool flag)
 {
-    if(m_ldrEnabled != flag)
+    if(m_timeEnabled != flag)
     {
         m_timeEnabled = flag;
         saveSetting(TIME_ENABLE);
@@ -215,14 +327,12 @@ void DoorHandler::setMotorSaved(bool flag)
     /* Disabling saving mtr position */
     if(!flag)
     {
-        debug("setMotorSaved() Disabling motor saving...");
-        debug(" - Door closed: ");
         m_closed = isClosed();
-        debugln(m_closed);
+        m_stalled = !m_closed && !isOpen();
+        logDebug(DOOR, "setMotorSaved() Disabling motor saving... - Door closed: %d", m_closed);
     }
     else // Enabling
     {
-        debug("setMotorSaved() Enabling motor saving...");
         if(m_closed)
 
         {
@@ -232,25 +342,30 @@ void DoorHandler::setMotorSaved(bool flag)
         {
             m_motorPosition = m_motorTopPosition;
         }
-        debug(" m_closed=");
-        debug(m_closed);
-        debug(" - MTR_POS: ");
-        debugln(m_motorPosition);
+        logDebug(DOOR, "setMotorSaved() Enabling motor saving... m_closed=%d - MTR_POS: %d", m_closed, m_motorPosition);
     }
     m_motorPositionSaved=flag;
 }
 
 void DoorHandler::forcedOpen()
 {
+    stopMotor();
+    m_motionState = MOTION_IDLE;
+    m_blocked = false;
     m_closed = false;
+    m_stalled = false;
     m_motorPosition = m_motorTopPosition;
-    m_encoder.write(m_motorPosition*ENCODER_MULTIPLIER);
+    m_encoder.write(m_motorPosition);
     saveSettings();
 }
 
 void DoorHandler::forcedClosed()
 {
+    stopMotor();
+    m_motionState = MOTION_IDLE;
+    m_blocked = false;
     m_closed = true;
+    m_stalled = false;
     m_motorPosition = 0;
     m_encoder.write(0);
     saveSettings();   
@@ -258,9 +373,17 @@ void DoorHandler::forcedClosed()
 
 /* ------------------------ GENERAL FUNCTIONS ------------------------*/
 
+/* Starts the door moving and returns straight away, the
+   motion itself is advanced by repeated calls to update() */
 bool DoorHandler::moveDoor(bool direction)
 {
 
+    if(m_motionState != MOTION_IDLE)
+    {
+        /* Already busy moving or settling */
+        return false;
+    }
+
     if(
         (  direction && isOpen() )
             ||
@@ -273,82 +396,275 @@ bool DoorHandler::moveDoor(bool direction)
     }
 
     /* direction=true (Open door), direction=false (Close door) */
+    logDebug(DOOR, "moveDoor() Starting motor, direction=%d", direction);
 
-    /* Power Motor */
-    digitalWrite(m_mtrPin1, direction);
-    digitalWrite(m_mtrPin2, !direction);
+    /* Asked to move, so whatever blocked the door is dealt with */
+    m_blocked   = false;
+    m_reversing = false;
+    m_retries   = 0;
 
-    /* Takes 1.3 seconds to RPM once going DOWN */
-    /* Because of torque, it takes 1.444r seconds to RPM going UP */
+    startMotion(direction ? m_motorTopPosition : 0);
+    return true;
+}
 
-    int32_t top = m_motorTopPosition*ENCODER_MULTIPLIER;
-    int32_t tmp = m_motorPosition;
-    /* Are we saving the position of the motor ? */
-    if(m_motorPositionSaved)
+/* Plans a move from wherever the door is to 'target' and hands the
+   motor to control(), for moveDoor() and the obstruction retries */
+void DoorHandler::startMotion(int32_t target)
+{
+    m_motionStartCount = m_encoder.read();
+    m_direction        = target > m_motionStartCount;
+    m_motionTimer      = millis();
+    m_motionState      = MOTION_STARTING;
+    m_heldBack         = false;
+
+    /* A full travel takes m_motorMoveTime, part of one in proportion,
+       no faster than calibrate() found the motor goes this way, and
+       the feedforward is scaled to that speed as kff is to the full. */
+    int32_t  travel   = m_motorTopPosition;
+    int32_t  distance = target - m_motionStartCount;
+    uint32_t time     = (uint64_t)m_motorMoveTime*100*(distance < 0 ? -distance : distance)/travel;
+    uint16_t speed    = m_motorSpeed[m_direction] ? m_motorSpeed[m_direction] : MOTOR_FULL_SPEED;
+    m_profile.plan(distance, time, m_motorAccelTime*100, m_motorDecelTime*100,
+                   (float)speed*MOTOR_PLAN_SPEED/MOTOR_FULL_SPEED, m_motorProfile);
+
+    /* As long to come to rest as calibrate()'s pass at CALIBRATION_DUTY
+       took over the distance, a door the loop drives harder is there
+       by then. CONTROL_SETTLE_TIME at least, and uncalibrated.        */
+    m_settleTime = CONTROL_SETTLE_TIME;
+    if(m_travelTime[m_direction])
     {
-        if(direction)   // Opening door
-        {
-            while( m_encoder.read() < top )
+        uint32_t calibrated = (uint64_t)m_travelTime[m_direction]*(distance < 0 ? -distance : distance)/
+                              (travel + CALIBRATION_MARGIN);
+        if(calibrated > m_settleTime) m_settleTime = calibrated;
+    }
+
+    m_motionTarget = target;
+    m_overshoot    = 0;
+    m_controlSteps = 0;
+    m_controller.reset();
+    m_controller.setFeedforwardScale((float)MOTOR_FULL_SPEED/speed);
+
+    /* Power Motor, control() drives it from here. Published last, a
+       step that preempts this sees none of the move or all of it.   */
+    m_controlPosition = m_motionStartCount;
+    __atomic_store_n(&m_controlling, true, __ATOMIC_RELEASE);
+}
+
+/* Homes the door and learns its travel: down onto the bottom stop,
+   up onto the top stop and back down, each at CALIBRATION_DUTY with
+   the stall check for an end stop. The top position is learned from
+   the counts between the stops, the speed and travel time each way
+   from the passes. Leaves the door closed, run it with the doorway
+   clear as anything in the way reads as a stop.                    */
+bool DoorHandler::calibrate()
+{
+    if(m_motionState != MOTION_IDLE) return false;
+
+    logInfo(DOOR, "calibrate() Homing, driving down onto the bottom stop");
+    m_blocked   = false;
+    m_reversing = false;
+    m_retries   = 0;
+    startCalibration(CALIBRATE_HOME);
+    return true;
+}
+
+/* Drives open loop towards the next stop, control() stays idle */
+void DoorHandler::startCalibration(uint8_t step)
+{
+    m_calibrationStep  = step;
+    m_calibrationPeak  = 0;
+    m_direction        = step == CALIBRATE_UP;
+    m_motionStartCount = m_encoder.read();
+    m_motionTimer      = millis();
+    m_motionState      = MOTION_CALIBRATING;
+    m_motor.drive(m_direction ? CALIBRATION_DUTY : -CALIBRATION_DUTY);
+
+    /* control() only samples the encoder, as startMotion() publishes */
+    m_controlPosition = m_motionStartCount;
+    __atomic_store_n(&m_controlling, true, __ATOMIC_RELEASE);
+}
+
+/* One update() of a calibration pass, done once the door has been
+   at a stop for the stall window. Anything off leaves the settings
+   as they were and the door where it stopped.                     */
+void DoorHandler::stepCalibration()
+{
+    int32_t  position = m_controlPosition;
+    uint32_t elapsed  = millis() - m_motionTimer;
+    int32_t  speed    = measuredVelocity();
+    if(speed < 0) speed = -speed;
+    if((uint32_t)speed > m_calibrationPeak) m_calibrationPeak = speed;
+
+    if(m_motorPositionSaved) m_motorPosition = position;
+
+    if(elapsed >= CALIBRATION_TIMEOUT)
+    {
+        logError(DOOR, "calibrate() No end stop after %dms, pass %d at %d", elapsed, m_calibrationStep, position);
+        readCalibration();
+        stallMotion(position);
+        return;
+    }
+
+    /* Still running, or still spinning up from rest */
+    uint32_t still = m_encoder.sinceLastEdge();
+    if(elapsed < MOTOR_SPINUP_TIME || still < (uint32_t)m_stallTime * 1000) return;
+
+    /* Peak speed at CALIBRATION_DUTY, scaled up to full duty */
+    uint32_t fullSpeed  = m_calibrationPeak * MOTOR_DUTY_MAX / CALIBRATION_DUTY;
+    uint32_t travelTime = elapsed - still / 1000;
+    if(fullSpeed > 65535) fullSpeed = 65535;
+
+    switch(m_calibrationStep)
+    {
+        case CALIBRATE_HOME:
+            logDebug(DOOR, "calibrate() Home at %d, driving up", position);
+            m_controlling = false;  // No sampling whilst the count is reset under it
+            m_encoder.write(0);
+            startCalibration(CALIBRATE_UP);
+            return;
+        case CALIBRATE_UP:
+            if(position < CALIBRATION_MIN_TRAVEL)
             {
-                //moveMotor(MOTOR_STEP_DELAY);
-                debugln(m_encoder.read());
-                m_motorPosition = m_encoder.read()/ENCODER_MULTIPLIER;  
-                // if(tmp == m_motorPosition)
-                // {
-                //     debugln("Motor failed to move, encoder is not responding.");
-                //     break;
-                // }           
+                logError(DOOR, "calibrate() Top stop only %d counts up, keeping the old travel", position);
+                stallMotion(position);
+                return;
             }
-            m_motorPosition = m_motorTopPosition;
-        }
-        else            // Closing door
-        {
-
-            while( m_encoder.read() > 0 )
+            if(position - CALIBRATION_MARGIN > DOOR_MAX_TOP_POSITION)
             {
-                //moveMotor(MOTOR_STEP_DELAY);
-                debugln(m_encoder.read());
-                m_motorPosition = m_encoder.read()/ENCODER_MULTIPLIER;  
+                logError(DOOR, "calibrate() Top stop %d counts up, past the %d allowed, keeping the old travel",
+                         position, DOOR_MAX_TOP_POSITION + CALIBRATION_MARGIN);
+                readCalibration();
+                stallMotion(position);
+                return;
             }
+            m_calibrationStop = position;
+            m_motorSpeed[1]   = fullSpeed;
+            m_travelTime[1]   = travelTime;
+            startCalibration(CALIBRATE_DOWN);
+            return;
+        default:
+            break;
+    }
 
-            m_motorPosition = 0;
-        }
-
+    /* Back on the bottom stop, the count here is how far the encoder drifted */
+    if(position > CALIBRATION_MARGIN || position < -CALIBRATION_MARGIN)
+    {
+        logError(DOOR, "calibrate() Came back down to %d not 0, keeping the old travel", position);
+        readCalibration();
+        stallMotion(position);
+        return;
     }
-    /* We're not saving the motor position to EEPROM, upon power
-        failure, if the door/motor did not finish moving, we must
-        assume a failure. */
-    else
+
+    stopMotor();
+    m_encoder.write(0);
+    m_motorSpeed[0]    = fullSpeed;
+    m_travelTime[0]    = travelTime;
+    m_motorTopPosition = m_calibrationStop - CALIBRATION_MARGIN;
+    m_motorPosition    = 0;
+    m_closed           = true;
+    saveSetting(CALIBRATION);
+
+    logInfo(DOOR, "calibrate() Top %d, up %dms at %d counts/s, down %dms at %d counts/s", m_motorTopPosition,
+            m_travelTime[1], m_motorSpeed[1], m_travelTime[0], m_motorSpeed[0]);
+
+    m_motionTimer = millis();
+    m_motionState = MOTION_SETTLING;
+}
+
+/* Advances the motion state machine by one step, returns
+   true whilst the door is still moving or settling.      */
+bool DoorHandler::update()
+{
+    switch(m_motionState)
     {
-        tmp = m_encoder.read();
-        debugln("moveDoor() Moving motor without EEPROM Seconds");
-        while(direction && m_encoder.read() < top)
+        case MOTION_STARTING:
+        case MOTION_TRAVELLING:
         {
-            if(tmp == m_encoder.read())
+            int32_t  position = m_controlPosition;
+            int32_t  error    = m_motionTarget - position;
+            bool     onTarget = (error < 0 ? -error : error) <= CONTROL_TOLERANCE;
+            uint32_t elapsed  = (uint64_t)m_controlSteps*DOOR_CONTROL_PERIOD/1000;
+
+            /* Are we saving the position of the motor ? */
+            if(m_motorPositionSaved) m_motorPosition = position;
+
+            /* Profile done, the loop brings the door to rest on the target */
+            if(elapsed >= m_profile.duration())
+            {
+                if(onTarget && m_encoder.sinceLastEdge() >= CONTROL_REST_TIME*1000UL)
+                {
+                    logDebug(DOOR, "update() Door settled at %d, %d past the target at most", position, m_overshoot);
+                    finishMotion();
+                    break;
+                }
+                if(elapsed - m_profile.duration() >= m_settleTime)
+                {
+                    /* Still hunting about the target is as good as there */
+                    if(onTarget)
+                    {
+                        finishMotion();
+                        break;
+                    }
+                    logError(DOOR, "update() Door stopped short at %d, target %d", position, m_motionTarget);
+                    stallMotion(position);
+                    break;
+                }
+            }
+
+            if(m_motionState == MOTION_STARTING)
             {
-                debugln("moveDoor() Motor failed to move, encoder is not responding.");
+                /* Takes 1.3 seconds to RPM once going DOWN */
+                /* Because of torque, it takes 1.444r seconds to RPM going UP */
+                if(position != m_motionStartCount)
+                {
+                    m_motionState = MOTION_TRAVELLING;
+                }
+                else if(millis() - m_motionTimer >= MOTOR_SPINUP_TIME)
+                {
+                    logError(DOOR, "update() Motor failed to move, encoder is not responding.");
+                    stallMotion(position);
+                    break;
+                }
+            }
+            else if(!onTarget && m_encoder.sinceLastEdge() >= (uint32_t)m_stallTime * 1000)
+            {
+                /* Turning and then nothing, the door is jammed */
+                logError(DOOR, "update() Door stalled at %d, no encoder edge for %dms", position, m_stallTime);
+                obstructMotion(position);
                 break;
             }
-        }
-        while(!direction && m_encoder.read() > 0)
-        {
-            if(tmp == m_encoder.read())
+            else if(heldBack(elapsed))
             {
-                debugln("moveDoor() Motor failed to move, encoder is not responding.");
+                logError(DOOR, "update() Door held back at %d, under %d%% of the planned speed for %dms",
+                         position, OBSTRUCTION_SPEED, m_stallTime);
+                obstructMotion(position);
                 break;
             }
+            break;
         }
-        m_closed = !m_closed;
+        case MOTION_BACKOFF:
+            /* Backed away from an obstruction, give it a while to clear */
+            if(millis() - m_motionTimer >= (uint32_t)OBSTRUCTION_BACKOFF << (m_retries - 1))
+            {
+                logInfo(DOOR, "update() Closing again, retry %d of %d", m_retries, OBSTRUCTION_RETRIES);
+                startMotion(0);
+            }
+            break;
+        case MOTION_CALIBRATING:
+            stepCalibration();
+            break;
+        case MOTION_SETTLING:
+            if(millis() - m_motionTimer >= MOTOR_SETTLE_TIME)
+            {
+                logDebug(DOOR, "update() Finished Moving Motor");
+                m_motionState = MOTION_IDLE;
+                saveSettings();
+            }
+            break;
+        default:
+            break;
     }
-
-    /* Depower Motor*/
-    digitalWrite(m_mtrPin1, LOW);
-    digitalWrite(m_mtrPin2, LOW);
-    delay(2500);
-    debugln("moveDoor() Finished Moving Motor");
-    saveSettings();
-
-    return true;
+    return m_motionState != MOTION_IDLE;
 }
 
 void DoorHandler::factoryReset()
@@ -373,65 +689,50 @@ DoorHandler::Response DoorHandler::getState()
         m_motorMoveTime,
         m_minuteToClose,
         m_minuteToOpen,
-        m_minuteOffset
+        m_minuteOffset,
+        m_motionState
     );
 }
 
 bool DoorHandler::poll()
 {
-    static uint8_t timeCalculation = 0;
     //printLocalTime();
 
-    // debug("Date: ");
-    // debug(getTimeValue(TDAY));
-    // debug("/");
-    // debug(getTimeValue(MONTH));
-    // debug("/");
-    // debug(getTimeValue(YEAR));
-    // debug(" ");    
-    // debug(getTimeValue(HOUR));
-    // debug(":");
-    // debug(getTimeValue(MINUTE));
-    // debug(":");
-    // debug(getTimeValue(SECOND));
+    // logDebug(DOOR, "Date: %d/%d/%d %d:%d:%d", getTimeValue(TDAY), getTimeValue(MONTH), getTimeValue(YEAR),
+    //          getTimeValue(HOUR), getTimeValue(MINUTE), getTimeValue(SECOND));
+
+    /* Motion in progress, let update() finish it first */
+    if(m_motionState != MOTION_IDLE) return false;
+
+    /* Left where it is until someone moves it, see obstructMotion() */
+    if(m_blocked)
+    {
+        logDebug(DOOR, "poll() Door is blocked at %d", m_motorPosition);
+        return false;
+    }
 
     if(getDoorState() == 2)
     {
-        debugln("poll() Door was 'stuck', forcefully closed it");
-        moveDoor(false);
-        return true;
+        logInfo(DOOR, "poll() Door was 'stuck', forcefully closed it");
+        return moveDoor(false);
     }
 
-    if((timeCalculation++)%10==0) calculateTimeToMove();
+    if((m_pollCount++)%10==0) calculateTimeToMove();
 
     /* If automation is disabled OR neither sensor/time is enabled */
     if( ! isAutomated() || ( !m_ldrEnabled && !m_timeEnabled ))
     {
-        debug( ! isAutomated() ? "poll() Automation is disabled " : "poll()  LDR/TIME are both disabled. ");
-        if(!m_ldrEnabled && !m_timeEnabled)
-        {
-            debug("LDR: ");
-            debug(m_ldrEnabled);
-            debug(" TIME: ");
-            debug(m_timeEnabled);
-        }
-        debugln("");
+        logDebug(DOOR, "poll() Automation=%d LDR: %d TIME: %d", isAutomated(), m_ldrEnabled, m_timeEnabled);
         return false;
     }
 
-    debug("poll() Door is ");
-    debug(isClosed() ? "Closed" : "Open");
-    debug(" -> ");
 
     if(isOpen())
     {
         bool darkOutside = !m_ldrEnabled || getLight() <= m_lightLowerThreshold; 
         bool bedtime = !m_timeEnabled || checkTime(NIGHT);
 
-        debug("Light: ");
-        debug(darkOutside);
-        debug(" - Time: ");
-        debugln(bedtime);
+        logDebug(DOOR, "poll() Door is Open -> Light: %d - Time: %d", darkOutside, bedtime);
 
         if(darkOutside && bedtime)
         {
@@ -443,10 +744,7 @@ bool DoorHandler::poll()
         bool lightOutside = !m_ldrEnabled || getLight() >= m_lightUpperThreshold;
         bool wakeup = !m_timeEnabled || checkTime(DAY);
 
-        debug("Light: ");
-        debug(lightOutside);
-        debug(" - Time: ");
-        debugln(wakeup);
+        logDebug(DOOR, "poll() Door is Closed -> Light: %d - Time: %d", lightOutside, wakeup);
 
         if(lightOutside && wakeup)
         {
@@ -461,11 +759,14 @@ bool DoorHandler::poll()
 /* ------------------------ PRIVATE FUNCTIONS ------------------------*/
 /* -------------------------------------------------------------------*/
 
+/* A blocked door is neither open nor closed, wherever it stopped */
 bool DoorHandler::isClosed()
 {
+    if(m_blocked) return false;
+
     if(m_motorPositionSaved)
     {
-        return m_motorPosition == 0;
+        return m_motorPosition >= -POSITION_TOLERANCE && m_motorPosition <= POSITION_TOLERANCE;
     }
     else
     {
@@ -475,13 +776,16 @@ bool DoorHandler::isClosed()
 
 bool DoorHandler::isOpen()
 {
+    if(m_blocked) return false;
+
     if(m_motorPositionSaved)
     {
-        return m_motorPosition == m_motorTopPosition;
+        return m_motorPosition >= m_motorTopPosition - POSITION_TOLERANCE &&
+               m_motorPosition <= m_motorTopPosition + POSITION_TOLERANCE;
     }
     else
     {
-        return !m_closed;
+        return !m_closed && !m_stalled;
     }
 }
 
@@ -492,13 +796,18 @@ bool DoorHandler::isMoving()
         return !isClosed() && !isOpen();
     }
     else
-    {   // Without position saving, we don't know.
-        return false;
+    {   // Without position saving, only that a move stopped short.
+        return m_stalled;
     }
 }
 
 uint8_t DoorHandler::getDoorState()
 {
+    if( m_motionState == MOTION_STARTING ||
+        m_motionState == MOTION_TRAVELLING ||
+        m_motionState == MOTION_BACKOFF ||
+        m_motionState == MOTION_CALIBRATING ) return 2;
+    if( m_blocked  ) return 4;
     if( isClosed() ) return 0;
     if( isOpen()   ) return 1;
     if( isMoving() ) return 2;
@@ -561,6 +870,157 @@ void DoorHandler::moveMotor(int motorDelay)
     delay(motorDelay);
 }
 
+void DoorHandler::stopMotor()
+{
+    /* Depower Motor, control() leaves it alone from here*/
+    m_controlling = false;
+    m_motor.stop();
+}
+
+/* One step of the position loop, every DOOR_CONTROL_PERIOD from the
+   control task (src/main.cpp) or a simulation, idle unless moving.
+   The only caller of m_encoder.sample(), update() works from the
+   position published here. The task runs above the door task on the
+   same core and can preempt startMotion() part way through, it is
+   only safe because m_controlling is stored last with release and
+   loaded here with acquire: a step sees the whole move or nothing. */
+void DoorHandler::control()
+{
+    if(!__atomic_load_n(&m_controlling, __ATOMIC_ACQUIRE)) return;
+
+    int32_t position  = m_encoder.sample();
+    m_controlPosition = position;
+
+    /* Calibration drives the motor open loop, only the samples are wanted */
+    if(m_motionState == MOTION_CALIBRATING) return;
+
+    ProfilePoint point    = m_profile.at((uint64_t)m_controlSteps*DOOR_CONTROL_PERIOD/1000);
+    float        duty     = m_controller.step(m_motionStartCount + point.position, point.velocity, position, measuredVelocity());
+
+    /* Furthest past the target, for tuning */
+    int32_t past = m_direction ? position - m_motionTarget : m_motionTarget - position;
+    if(past > m_overshoot) m_overshoot = past;
+
+    m_motor.drive((int16_t)duty);
+    m_controlSteps++;
+}
+
+/* Cuts the motor, records where the door ended up and lets it settle */
+void DoorHandler::finishMotion()
+{
+    stopMotor();
+
+    if(m_motorPositionSaved)
+    {
+        /* Wherever the loop settled, inside POSITION_TOLERANCE */
+        m_motorPosition = m_encoder.read();
+    }
+    else
+    {
+        m_closed  = !m_direction;
+        m_stalled = m_reversing;    // Only backed off, short of the top
+    }
+
+    m_motionTimer = millis();
+
+    /* Backed off an obstruction, the close is tried again from here */
+    if(m_reversing)
+    {
+        m_reversing   = false;
+        m_motionState = MOTION_BACKOFF;
+        return;
+    }
+
+    m_retries     = 0;
+    m_motionState = MOTION_SETTLING;
+}
+
+/* Encoder speed in counts/s, 0 once the last edge is too old to say */
+float DoorHandler::measuredVelocity()
+{
+    return m_encoder.sinceLastEdge() < MOTOR_VELOCITY_AGE*1000UL ? m_encoder.velocity() : 0;
+}
+
+/* True once the door has been well under the planned speed for the
+   whole stall window. Catches something soft that slows the door
+   without stopping it, which the edge check alone would miss.      */
+bool DoorHandler::heldBack(uint32_t elapsed)
+{
+    float planned  = m_profile.at(elapsed).velocity;
+    float measured = measuredVelocity();
+    if(planned < 0)
+    {
+        planned  = -planned;
+        measured = -measured;
+    }
+
+    if(planned < OBSTRUCTION_MIN_SPEED || measured*100 >= planned*OBSTRUCTION_SPEED)
+    {
+        m_heldBack = false;
+        return false;
+    }
+
+    if(!m_heldBack)
+    {
+        m_heldBack  = true;
+        m_heldSince = millis();
+    }
+    return millis() - m_heldSince >= m_stallTime;
+}
+
+/* The door hit something. Closing, it backs up OBSTRUCTION_REVERSE
+   and tries again after a backoff, OBSTRUCTION_RETRIES times before
+   giving up as blocked. Opening there is nothing to back away from,
+   it stops as any stall does, and fails to back off means blocked. */
+void DoorHandler::obstructMotion(int32_t position)
+{
+    stopMotor();
+
+    if(m_direction)
+    {
+        if(m_reversing) m_blocked = true;
+        stallMotion(position);
+        return;
+    }
+
+    if(m_retries >= OBSTRUCTION_RETRIES)
+    {
+        logError(DOOR, "obstructMotion() Door blocked at %d after %d retries", position, m_retries);
+        m_blocked = true;
+        stallMotion(position);
+        return;
+    }
+
+    int32_t back = position + OBSTRUCTION_REVERSE;
+    if(back > m_motorTopPosition) back = m_motorTopPosition;
+
+    m_retries++;
+    logInfo(DOOR, "obstructMotion() Obstructed closing at %d, backing up to %d", position, back);
+    startMotion(back);
+    m_reversing = true;
+}
+
+/* Cuts the motor where it stopped short, the door is neither open
+   nor closed so the next poll() will try to close it again.      */
+void DoorHandler::stallMotion(int32_t position)
+{
+    stopMotor();
+    m_reversing = false;
+
+    if(m_motorPositionSaved)
+    {
+        m_motorPosition = position;
+    }
+    else
+    {
+        m_closed  = false;
+        m_stalled = true;
+    }
+
+    m_motionTimer = millis();
+    m_motionState = MOTION_SETTLING;
+}
+
 int DoorHandler::getTimeValue(int choice)
 {
     struct tm timeinfo;
@@ -585,19 +1045,17 @@ int DoorHandler::getTimeValue(int choice)
 
 void DoorHandler::printLocalTime()
 {
-    #ifdef DEBUG
     struct tm timeinfo;
     if(!getLocalTime(&timeinfo)){
-        Serial.println("Failed to obtain time");
+        logError(DOOR, "printLocalTime() Failed to obtain time");
         return;
     }
-    Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
-    #endif
+    logDebug(DOOR, "printLocalTime() %02d/%02d/%d %02d:%02d:%02d", timeinfo.tm_mday, timeinfo.tm_mon + 1, timeinfo.tm_year + 1900,
+             timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
 }
 
 void DoorHandler::calculateTimeToMove()
 {
-    debug("calculateTimeToMove() Calcuating time to move, open=");
     int year  = getTimeValue(YEAR);
     int month = getTimeValue(MONTH);
     int day   = getTimeValue(TDAY);
@@ -605,59 +1063,54 @@ void DoorHandler::calculateTimeToMove()
 
     /* Value remains the same */
     m_minuteToOpen = movingTime.sunrise(year, month, day, dst);   
-    debug(m_minuteToOpen);
-    debug(", close=");
 
     // char buf[6];
     // movingTime.min2str(buf, m_minuteToOpen);
-    // debug("Sunrise: (");
-    // debug(m_minuteToOpen);
-    // debug(") ");
-    // debugln(buf);
+    // logDebug(DOOR, "Sunrise: (%d) %s", m_minuteToOpen, buf);
 
     /* Sunset, add 30 as this is the offset to allow later sleepers */
     m_minuteToClose = movingTime.sunset(year, month, day, dst) + m_minuteOffset;
-    debugln(m_minuteToClose);
+    logDebug(DOOR, "calculateTimeToMove() Calcuating time to move, open=%d, close=%d", m_minuteToOpen, m_minuteToClose);
     // movingTime.min2str(buf, m_minuteToClose);
-    // debug("Sunset: (");
-    // debug(m_minuteToClose);
-    // debug(") ");
-    // debugln(buf);
-
-    // debugln(buf);
+    // logDebug(DOOR, "Sunset: (%d) %s", m_minuteToClose, buf);
 }
 
 void DoorHandler::saveSettings()
 {
-    debugln("saveSettings() Saving all settings.");
+    logDebug(DOOR, "saveSettings() Saving all settings.");
     EEPROM.write(0, m_id);
-    EEPROM.write(1, m_motorPosition);
-    EEPROM.write(2, m_motorTopPosition);
+    EEPROM.put(MOTOR_POSITION_ADDRESS, m_motorPosition);
+    EEPROM.put(MOTOR_TOP_ADDRESS, m_motorTopPosition);
     EEPROM.write(3, m_lightUpperThreshold);
     EEPROM.write(4, m_lightLowerThreshold);
-    EEPROM.write(5, m_minuteOffset);
+    EEPROM.put(CLOSE_OFFSET_ADDRESS, m_minuteOffset);
     EEPROM.write(6, m_automationEnabled);
     EEPROM.write(7, m_ldrEnabled);
     EEPROM.write(8, m_motorPositionSaved);
     EEPROM.write(9, m_motorMoveTime);
     EEPROM.write(10, m_timeEnabled);
-    EEPROM.commit();
+    EEPROM.write(11, EEPROM_LAYOUT);
+    EEPROM.write(MOTOR_ACCEL_ADDRESS, m_motorAccelTime);
+    EEPROM.write(MOTOR_DECEL_ADDRESS, m_motorDecelTime);
+    EEPROM.write(MOTOR_PROFILE_ADDRESS, m_motorProfile);
+    writeGains();
+    writeCalibration();
+    commitSettings();
 }
 
 void DoorHandler::saveSetting(int choice)
 {
-    debug("Saving setting: ");
-    debugln(choice);
+    logDebug(DOOR, "saveSetting() Saving setting: %d", choice);
     switch(choice)
     {
         case DOOR_ID:
             EEPROM.write(0, m_id);
             break;
         case MTR_POSITION:
-            EEPROM.write(1, m_motorPosition);
+            EEPROM.put(MOTOR_POSITION_ADDRESS, m_motorPosition);
             break;
         case MTR_STOP_TOP:
-            EEPROM.write(2, m_motorTopPosition);
+            EEPROM.put(MOTOR_TOP_ADDRESS, m_motorTopPosition);
             break;
         case LIGHT_THRESHOLD_TOP:
             EEPROM.write(3, m_lightUpperThreshold);
@@ -666,7 +1119,7 @@ void DoorHandler::saveSetting(int choice)
             EEPROM.write(4, m_lightLowerThreshold);
             break;
         case CLOSE_OFFSET:
-            EEPROM.write(5, m_minuteOffset);
+            EEPROM.put(CLOSE_OFFSET_ADDRESS, m_minuteOffset);
             break;
         case AUTOMATION_ENABLE:
             EEPROM.write(6, m_automationEnabled);
@@ -683,16 +1136,56 @@ void DoorHandler::saveSetting(int choice)
         case TIME_ENABLE:
             EEPROM.write(10, m_timeEnabled);
             break;
+        case MOTOR_ACCEL_TIME:
+            EEPROM.write(MOTOR_ACCEL_ADDRESS, m_motorAccelTime);
+            break;
+        case MOTOR_DECEL_TIME:
+            EEPROM.write(MOTOR_DECEL_ADDRESS, m_motorDecelTime);
+            break;
+        case MOTOR_PROFILE_SHAPE:
+            EEPROM.write(MOTOR_PROFILE_ADDRESS, m_motorProfile);
+            break;
+        case CONTROL_GAINS:
+            writeGains();
+            break;
+        case CALIBRATION:
+            EEPROM.put(MOTOR_TOP_ADDRESS, m_motorTopPosition);
+            writeCalibration();
+            break;
         case RESET:
             /* Reset door to closed position ( 0 ), then reset EEPROM. */
             //if(m_motorPositionSaved)
-            debugln("saveSetting() Resetting EEPROM.");
+            logInfo(DOOR, "saveSetting() Resetting EEPROM.");
             flash();
             break;
         default:
             return;
     }
+    commitSettings();
+}
+
+void DoorHandler::beginBatch()
+{
+    m_batching = true;
+}
+
+void DoorHandler::endBatch()
+{
+    m_batching = false;
+    if(m_eepromNeedsSaving) commitSettings();
+}
+
+/* Flash has limited write cycles, hold off whilst batching */
+void DoorHandler::commitSettings()
+{
+    if(m_batching)
+    {
+        m_eepromNeedsSaving = true;
+        return;
+    }
+    logDebug(DOOR, "commitSettings() Committing EEPROM.");
     EEPROM.commit();
+    m_eepromNeedsSaving = false;
 }
 
 void DoorHandler::loadSettings()
@@ -707,18 +1200,86 @@ void DoorHandler::loadSettings()
         return;
     }
 
-    m_motorPosition       = EEPROM.read(1);
-    m_motorTopPosition    = EEPROM.read(2);
+    EEPROM.get(MOTOR_POSITION_ADDRESS, m_motorPosition);
+    EEPROM.get(MOTOR_TOP_ADDRESS, m_motorTopPosition);
     m_lightUpperThreshold = EEPROM.read(3);
     m_lightLowerThreshold = EEPROM.read(4);
-    m_minuteOffset        = EEPROM.read(5);
+    EEPROM.get(CLOSE_OFFSET_ADDRESS, m_minuteOffset);
     m_automationEnabled   = EEPROM.read(6);
     m_ldrEnabled          = EEPROM.read(7);
     m_motorPositionSaved  = EEPROM.read(8);
     m_motorMoveTime       = EEPROM.read(9);
     m_timeEnabled         = EEPROM.read(10);
+    m_motorAccelTime      = EEPROM.read(MOTOR_ACCEL_ADDRESS);
+    m_motorDecelTime      = EEPROM.read(MOTOR_DECEL_ADDRESS);
+    m_motorProfile        = EEPROM.read(MOTOR_PROFILE_ADDRESS);
+    readGains();
+    readCalibration();
+
+    /* Older images are upgraded in place */
+    uint8_t layout = EEPROM.read(11);
+    if(layout != EEPROM_LAYOUT) migrateSettings(layout);
+
+    /* startMotion() divides by the top, an old image's byte can make it
+       0 (or 765000 from an erased one), so it goes back to the default */
+    if(m_motorTopPosition < DOOR_MIN_TOP_POSITION || m_motorTopPosition > DOOR_MAX_TOP_POSITION)
+    {
+        logError(DOOR, "loadSettings() Top position %d out of range, using %d", m_motorTopPosition, D_MTR_STOP_TOP);
+        m_motorTopPosition = D_MTR_STOP_TOP;
+        if(m_motorPosition > m_motorTopPosition) m_motorPosition = m_motorTopPosition;
+        saveSetting(MTR_STOP_TOP);
+    }
 
-    m_encoder.write(m_motorPosition*ENCODER_MULTIPLIER);
+    m_encoder.write(m_motorPosition);
+}
+
+/* Converts an EEPROM image written by older firmware to EEPROM_LAYOUT */
+void DoorHandler::migrateSettings(uint8_t layout)
+{
+    /* Images before layout versioning hold anything at 11 */
+    if(layout == 0 || layout > EEPROM_LAYOUT) layout = 1;
+
+    logInfo(DOOR, "migrateSettings() Upgrading EEPROM layout from %d", layout);
+
+    if(layout < 2)
+    {
+        m_minuteOffset = EEPROM.read(5);
+        EEPROM.put(CLOSE_OFFSET_ADDRESS, m_minuteOffset);
+    }
+
+    if(layout < 3)
+    {
+        m_motorAccelTime = D_MOTOR_ACCEL_TIME;
+        m_motorDecelTime = D_MOTOR_DECEL_TIME;
+        m_motorProfile   = D_MOTOR_PROFILE;
+        EEPROM.write(MOTOR_ACCEL_ADDRESS, m_motorAccelTime);
+        EEPROM.write(MOTOR_DECEL_ADDRESS, m_motorDecelTime);
+        EEPROM.write(MOTOR_PROFILE_ADDRESS, m_motorProfile);
+    }
+
+    if(layout < 4)
+    {
+        defaultGains();
+        writeGains();
+    }
+
+    if(layout < 5)
+    {
+        m_motorPosition    = EEPROM.read(1) * ENCODER_MULTIPLIER;
+        m_motorTopPosition = EEPROM.read(2) * ENCODER_MULTIPLIER;
+        EEPROM.put(MOTOR_POSITION_ADDRESS, m_motorPosition);
+        EEPROM.put(MOTOR_TOP_ADDRESS, m_motorTopPosition);
+    }
+
+    if(layout < 6)
+    {
+        m_motorSpeed[0] = m_motorSpeed[1] = 0;
+        m_travelTime[0] = m_travelTime[1] = 0;
+        writeCalibration();
+    }
+
+    EEPROM.write(11, EEPROM_LAYOUT);
+    commitSettings();
 }
 
 /* No true rng, too heavy - utilising psuedo */
@@ -742,18 +1303,27 @@ void DoorHandler::seedRandomNumberGenerator()
 
 void DoorHandler::flash()
 {
-    debugln("Flashing EEPROM.");
+    logInfo(DOOR, "flash() Flashing EEPROM.");
     EEPROM.write(0, generateUniqueID());
-    EEPROM.write(1, 0); // Door position
-    EEPROM.write(2, D_MTR_STOP_TOP);
+    EEPROM.put(MOTOR_POSITION_ADDRESS, (int32_t)0); // Door position
+    EEPROM.put(MOTOR_TOP_ADDRESS, (int32_t)D_MTR_STOP_TOP);
     EEPROM.write(3, D_LIGHT_THRESHOLD_TOP);
     EEPROM.write(4, D_LIGHT_THRESHOLD_BOTTOM);
-    EEPROM.write(5, D_CLOSE_OFFSET);
+    EEPROM.put(CLOSE_OFFSET_ADDRESS, (int16_t)D_CLOSE_OFFSET);
     EEPROM.write(6, D_AUTOMATION_ENABLE);
     EEPROM.write(7, D_LDR_ENABLE);
     EEPROM.write(8, D_MOTOR_SAVED_ENABLE);
     EEPROM.write(9, D_MOTOR_MOVE_TIME);
     EEPROM.write(10, D_TIME_ENABLE);
+    EEPROM.write(11, EEPROM_LAYOUT);
+    EEPROM.write(MOTOR_ACCEL_ADDRESS, D_MOTOR_ACCEL_TIME);
+    EEPROM.write(MOTOR_DECEL_ADDRESS, D_MOTOR_DECEL_TIME);
+    EEPROM.write(MOTOR_PROFILE_ADDRESS, D_MOTOR_PROFILE);
+    defaultGains();
+    writeGains();
+    m_motorSpeed[0] = m_motorSpeed[1] = 0;
+    m_travelTime[0] = m_travelTime[1] = 0;
+    writeCalibration();
 
     m_motorPosition       = 0;
     m_motorTopPosition    = D_MTR_STOP_TOP;
@@ -765,8 +1335,59 @@ void DoorHandler::flash()
     m_motorPositionSaved  = D_MOTOR_SAVED_ENABLE;
     m_motorMoveTime       = D_MOTOR_MOVE_TIME;
     m_timeEnabled         = D_TIME_ENABLE;
+    m_motorAccelTime      = D_MOTOR_ACCEL_TIME;
+    m_motorDecelTime      = D_MOTOR_DECEL_TIME;
+    m_motorProfile        = D_MOTOR_PROFILE;
 
-    EEPROM.commit();
+    commitSettings();
     
 }
 
+/* Gains are kept as thousandths, like the 'x' command sends them */
+void DoorHandler::readGains()
+{
+    uint16_t thousandths[4];
+    EEPROM.get(CONTROL_GAINS_ADDRESS, thousandths);
+
+    PositionGains gains;
+    gains.kp  = thousandths[0] / 1000.0f;
+    gains.ki  = thousandths[1] / 1000.0f;
+    gains.kd  = thousandths[2] / 1000.0f;
+    gains.kff = thousandths[3] / 1000.0f;
+    m_controller.setGains(gains);
+}
+
+void DoorHandler::writeGains()
+{
+    const PositionGains& gains = m_controller.gains();
+    uint16_t thousandths[4] = {
+        (uint16_t)(gains.kp  * 1000 + 0.5f),
+        (uint16_t)(gains.ki  * 1000 + 0.5f),
+        (uint16_t)(gains.kd  * 1000 + 0.5f),
+        (uint16_t)(gains.kff * 1000 + 0.5f)
+    };
+    EEPROM.put(CONTROL_GAINS_ADDRESS, thousandths);
+}
+
+void DoorHandler::defaultGains()
+{
+    PositionGains gains;
+    gains.kp  = D_CONTROL_KP  / 1000.0f;
+    gains.ki  = D_CONTROL_KI  / 1000.0f;
+    gains.kd  = D_CONTROL_KD  / 1000.0f;
+    gains.kff = D_CONTROL_KFF / 1000.0f;
+    m_controller.setGains(gains);
+}
+
+/* Zeros until calibrate() has run, startMotion() falls back on MOTOR_FULL_SPEED */
+void DoorHandler::readCalibration()
+{
+    EEPROM.get(MOTOR_SPEED_ADDRESS, m_motorSpeed);
+    EEPROM.get(TRAVEL_TIME_ADDRESS, m_travelTime);
+}
+
+void DoorHandler::writeCalibration()
+{
+    EEPROM.put(MOTOR_SPEED_ADDRESS, m_motorSpeed);
+    EEPROM.put(TRAVEL_TIME_ADDRESS, m_travelTime);
+}
@@ -5,23 +5,56 @@
 #include <stdint.h> // Precise type allocation
 #include <stdio.h> // Sprintf
 
-#include <Encoder.h> // For motor
+/* Motor encoder, the pulse counter backend is opt in with -DENCODER_PCNT */
+#ifdef ENCODER_PCNT
+#include <PcntEncoder.h>
+typedef PcntEncoder DoorEncoder;
+#else
+#include <Encoder.h>
+typedef Encoder DoorEncoder;
+#endif
+#include <Telemetry.h> // Binary heartbeat
+#include <MotorDriver.h>  // LEDC PWM on the motor pins
+#include <MotorProfile.h> // Ramped moves
+#include <PositionController.h> // Closed loop on encoder counts
 
 #define RESPONSE_LENGTH 250
 
+/* Motion states, advanced a step at a time by update() */
+#define MOTION_IDLE         0
+#define MOTION_STARTING     1
+#define MOTION_TRAVELLING   2
+#define MOTION_SETTLING     3
+#define MOTION_BACKOFF      4       // Backed away from an obstruction, waiting to close again
+#define MOTION_CALIBRATING  5       // Running between the end stops, see calibrate()
+
+#define DOOR_CONTROL_PERIOD 2000    // us, position loop step, see control()
+#define DOOR_MAX_TOP_POSITION 300000 // counts, highest setTopPosition() allows
+#define POSITION_TOLERANCE  150  // counts either side of the ends still open or closed
+#define DOOR_MIN_TOP_POSITION (POSITION_TOLERANCE + 1) // counts, lowest, open must be clear of closed
+#define MIN_DIFF_IN_LIGHT   5    // Upper light threshold over the lower, at least
+
+/* Default settings the setters and commands check against, the rest are in DoorHandler.cpp */
+#define D_MTR_STOP_TOP            30000 // counts, ten of the old 3000 count steps
+#define D_LIGHT_THRESHOLD_TOP     37    // Assumed with 200k~ LDR and 10k resistor in voltage divider
+#define D_LIGHT_THRESHOLD_BOTTOM  25
+#define D_MOTOR_PROFILE           PROFILE_SCURVE
+
 /* Singleton wrapper */
 class DoorHandler{
 
     public:    // Inner class declaration
 
-        /* Wrapper for Char* UDP packet */
+        /* Snapshot of the door, rendered either as the text
+           "!ID=..." heartbeat or as a binary telemetry frame.
+           Text is only formatted the first time it is asked for. */
         class Response{
 
             public:
                 Response(uint8_t id,
                         uint8_t state,
-                        uint8_t mtrPos,
-                        uint8_t mtrTopPos,
+                        int32_t mtrPos,
+                        int32_t mtrTopPos,
                         uint8_t mtrUpperLight,
                         uint8_t mtrLowerLight,
                         uint8_t currentLight,
@@ -32,35 +65,91 @@ class DoorHandler{
                         uint8_t motorTime,
                         uint16_t closingTimeMinute,
                         uint16_t openingTimeMinute,
-                        uint8_t minuteOffset)
+                        int16_t minuteOffset,
+                        uint8_t motionState)
                 {
+                    m_status.sequence            = 0;
+                    m_status.id                  = id;
+                    m_status.state               = state;
+                    m_status.motionState         = motionState;
+                    m_status.flags               = (automated   ? TELEMETRY_FLAG_AUTOMATED   : 0)
+                                                 | (ldrEnabled  ? TELEMETRY_FLAG_LDR         : 0)
+                                                 | (timeEnabled ? TELEMETRY_FLAG_TIME        : 0)
+                                                 | (motorSaved  ? TELEMETRY_FLAG_MOTOR_SAVED : 0);
+                    m_status.motorPosition       = mtrPos;
+                    m_status.motorTopPosition    = mtrTopPos;
+                    m_status.lightUpperThreshold = mtrUpperLight;
+                    m_status.lightLowerThreshold = mtrLowerLight;
+                    m_status.currentLight        = currentLight;
+                    m_status.motorMoveTime       = motorTime;
+                    m_status.closingMinute       = closingTimeMinute;
+                    m_status.openingMinute       = openingTimeMinute;
+                    m_status.minuteOffset        = minuteOffset;
+                    m_status.uptime              = 0;
+                    m_length = 0;
+                }
 
-                    m_length = sprintf(m_buffer, "!ID=%d,STATE=%d,MTR_POS=%d,TOPPOS=%d,UL=%d,LL=%d,LIT=%d,AUTO=%d,LDR=%d,TIME=%d,MTRSAVE=%d,MTRTIME=%d,CLOSE=%d,OPEN=%d,C+OFF=%d,MOFF=%d",
-                     id, state, mtrPos, mtrTopPos, mtrUpperLight, mtrLowerLight,
-                     currentLight, automated, ldrEnabled, timeEnabled, motorSaved, motorTime,
-                     closingTimeMinute-minuteOffset, openingTimeMinute, closingTimeMinute, minuteOffset);
-
+                char* getResponse()
+                {
+                    if(m_length == 0) format();
+                    return m_buffer;
+                }
+                uint8_t getLength()
+                {
+                    if(m_length == 0) format();
+                    return m_length;
                 }
-                char* getResponse(){return m_buffer;}
-                uint8_t getLength(){return m_length;}
+
+                /* Fields for a binary frame, sequence and uptime are left to the sender */
+                TelemetryStatus& getStatus(){return m_status;}
 
             private:
-                char m_buffer[RESPONSE_LENGTH];
+                TelemetryStatus m_status;
+                char    m_buffer[RESPONSE_LENGTH];
                 uint8_t m_length;
 
+                void format()
+                {
+                    TelemetryStatus& s = m_status;
+                    m_length = sprintf(m_buffer, "!ID=%d,STATE=%d,MTR_POS=%d,TOPPOS=%d,UL=%d,LL=%d,LIT=%d,AUTO=%d,LDR=%d,TIME=%d,MTRSAVE=%d,MTRTIME=%d,CLOSE=%d,OPEN=%d,C+OFF=%d,MOFF=%d,MOTION=%d",
+                     s.id, s.state, s.motorPosition, s.motorTopPosition, s.lightUpperThreshold, s.lightLowerThreshold,
+                     s.currentLight, (s.flags & TELEMETRY_FLAG_AUTOMATED) != 0, (s.flags & TELEMETRY_FLAG_LDR) != 0,
+                     (s.flags & TELEMETRY_FLAG_TIME) != 0, (s.flags & TELEMETRY_FLAG_MOTOR_SAVED) != 0, s.motorMoveTime,
+                     s.closingMinute-s.minuteOffset, s.openingMinute, s.closingMinute, s.minuteOffset,
+                     s.motionState);
+                }
+
         };
 
         /* Main class declarations, members and functions */
         DoorHandler(uint8_t mtrPin1, uint8_t mtrPin2, uint8_t encoderPin1, uint8_t encoderPin2, uint8_t ldrPin);
 
         /* Getters */
-        uint8_t getPosition()           {return m_motorPosition;}
-        uint8_t getTopPosition()        {return m_motorTopPosition;}
+        int32_t getPosition()           {return m_motorPosition;}    // Encoder counts
+        int32_t getTopPosition()        {return m_motorTopPosition;}
         uint8_t getLightUpperThreshold(){return m_lightUpperThreshold;}
         uint8_t getLightLowerThreshold(){return m_lightLowerThreshold;}
-        uint8_t getOpenTime()           {return m_minuteOffset;}
+        int16_t getOpenTime()           {return m_minuteOffset;}
 	    uint8_t getLightLevel()		    {return getLight();}
         uint8_t getID()                 {return m_id;}
+        uint8_t getMotionState()        {return m_motionState;}
+        uint16_t getStallTime()         {return m_stallTime;}
+        uint8_t getMotorMoveTime()      {return m_motorMoveTime;}
+        uint8_t getMotorAccelTime()     {return m_motorAccelTime;}
+        uint8_t getMotorDecelTime()     {return m_motorDecelTime;}
+        uint8_t getMotorProfile()       {return m_motorProfile;}
+        const PositionGains& getGains() {return m_controller.gains();}
+        int32_t getVelocity()           {return m_encoder.velocity();}
+        uint16_t getMotorSpeed(bool up) {return m_motorSpeed[up];}  // counts/s at full duty, 0 uncalibrated
+        uint16_t getTravelTime(bool up) {return m_travelTime[up];}  // ms stop to stop at calibration duty
+
+        /* Whether the setters would take a value, e.g. setLightThresholds() the pair */
+        static bool validLightThresholds(uint8_t upper, uint8_t lower)
+                    {return upper < 255 && lower < upper && upper - lower >= MIN_DIFF_IN_LIGHT;}
+        static bool validTopPosition(int32_t value)
+                    {return value >= DOOR_MIN_TOP_POSITION && value <= DOOR_MAX_TOP_POSITION;}
+        static bool validMotorProfile(uint8_t shape)
+                    {return shape == PROFILE_TRAPEZOID || shape == PROFILE_SCURVE;}
 
         /* Queries */
         bool isAutomated  (){return m_automationEnabled;}
@@ -68,6 +157,7 @@ class DoorHandler{
         bool isClosed     ();
         bool isOpen       ();
         bool isMoving     ();
+        bool isBlocked    (){return m_blocked;}
         bool ldrEnabled   (){return m_ldrEnabled;}
         bool timeEnabled(){return m_timeEnabled;}
 
@@ -76,15 +166,21 @@ class DoorHandler{
         void setTimeEnabled(bool flag);
         void setAutomated (bool flag){m_automationEnabled=flag;}
         void setMotorSaved(bool flag);
-        void setDoorCloseTime(uint8_t time);
+        void setDoorCloseTime(int16_t minutes);
         void forcedOpen();
         void forcedClosed();
 
         uint8_t setLightUpperThreshold(uint8_t value);
         uint8_t setLightLowerThreshold(uint8_t value);
-        uint8_t setTopPosition(uint8_t value);
+        bool    setLightThresholds(uint8_t upper, uint8_t lower);
+        int32_t setTopPosition(int32_t value);
         uint8_t setDoorId(uint8_t value);
         uint8_t setMotorMoveSpeed(uint8_t value);
+        uint8_t setMotorAccelTime(uint8_t value);
+        uint8_t setMotorDecelTime(uint8_t value);
+        uint8_t setMotorProfile(uint8_t shape);
+        uint16_t setStallTime(uint16_t ms);
+        void    setGains(const PositionGains& gains);
 
         /* General functions */
         void     loadSettings();
@@ -92,12 +188,20 @@ class DoorHandler{
         void     printLocalTime();
         Response getState();
         bool     moveDoor(bool direction);
+        bool     calibrate();
+        bool     update();
+        void     control();
         bool     poll();
         void     factoryReset();
 
         void     saveSettings();
         void     saveSetting(int choice);
 
+        /* Defers EEPROM commits until endBatch(), so a burst of
+           settings changes costs a single flash write.        */
+        void     beginBatch();
+        void     endBatch();
+
     private:
         /* Used for networking */
         uint8_t m_id;
@@ -105,15 +209,16 @@ class DoorHandler{
         /* Pins used on board */
         uint8_t m_mtrPin1;
         uint8_t m_mtrPin2;
-        Encoder m_encoder;
+        DoorEncoder m_encoder;
+        MotorDriver m_motor;
         uint8_t m_ldrPin; // Must be analog
 
         /* EEPROM Values */
-        uint8_t m_motorPosition;
-        uint8_t m_motorTopPosition;
+        int32_t m_motorPosition;        // Encoder counts, 0 is closed
+        int32_t m_motorTopPosition;
         uint8_t m_lightUpperThreshold;
         uint8_t m_lightLowerThreshold;
-        uint8_t m_minuteOffset;         // The offset value from opening, default is 100 (1 step equals 2 minutes, i.e 10 = -3hours from opening)
+        int16_t m_minuteOffset;         // Minutes added to sunset before closing, negative closes earlier
         bool    m_automationEnabled;
         bool    m_motorPositionSaved;
 
@@ -125,10 +230,45 @@ class DoorHandler{
         bool    m_ldrEnabled;
         bool    m_timeEnabled;
 
+        /* Speed profile, times are n*100ms */
+        uint8_t m_motorMoveTime;        // A full travel, closed to m_motorTopPosition
+        uint8_t m_motorAccelTime;
+        uint8_t m_motorDecelTime;
+        uint8_t m_motorProfile;         // PROFILE_TRAPEZOID or PROFILE_SCURVE
+
+        /* Learned by calibrate(), indexed by direction, 1 is up */
+        uint16_t m_motorSpeed[2];       // counts/s at full duty
+        uint16_t m_travelTime[2];       // ms between the end stops
+
         /* If m_motorPositionSaved = false, these members become used */
-        uint8_t m_motorMoveTime;
         bool    m_closed;
+        bool    m_stalled;              // Stopped short of either end, until a move ends or forced
         bool    m_eepromNeedsSaving;
+        bool    m_batching;
+        uint8_t m_pollCount;            // Sunrise/sunset are recalculated every 10th poll
+
+        /* Motion state machine, see update() */
+        uint8_t  m_motionState;
+        bool     m_direction;
+        uint32_t m_motionTimer;
+        int32_t  m_motionStartCount;
+        uint16_t m_stallTime;           // ms without an encoder edge before giving up on a move
+        MotorProfile m_profile;         // Planned by moveDoor()
+        PositionController m_controller;
+        int32_t  m_motionTarget;        // Encoder count the move ends on
+        int32_t  m_overshoot;           // Furthest past m_motionTarget this move
+        uint32_t m_settleTime;          // ms after the profile before a door short of the target has stopped short
+        volatile uint32_t m_controlSteps; // control() steps into the move
+        volatile bool m_controlling;    // control() is sampling the encoder, and driving the motor unless calibrating
+        volatile int32_t m_controlPosition; // Last sampled by control(), what update() works from
+        bool     m_heldBack;            // Under the planned speed since m_heldSince
+        uint32_t m_heldSince;
+        bool     m_reversing;           // Backing away from an obstruction
+        bool     m_blocked;             // Gave up closing, until moveDoor() or forced
+        uint8_t  m_retries;             // Closes tried again this move
+        uint8_t  m_calibrationStep;     // Which pass calibrate() is on
+        uint32_t m_calibrationPeak;     // Fastest counts/s this pass
+        int32_t  m_calibrationStop;     // Top end stop, until the pass down confirms it
 
         /* Private functions */
         uint8_t  getDoorState();
@@ -137,11 +277,27 @@ class DoorHandler{
         uint8_t  getLight();
         bool     checkTime(bool dayOrNight);
         void     moveMotor(int delay);
+        void     stopMotor();
+        void     finishMotion();
+        void     stallMotion(int32_t position);
+        void     obstructMotion(int32_t position);
+        void     startMotion(int32_t target);
+        bool     heldBack(uint32_t elapsed);
+        void     startCalibration(uint8_t step);
+        void     stepCalibration();
+        float    measuredVelocity();
         int      getTimeValue(int choice);
         void     calculateTimeToMove();
         uint8_t  generateUniqueID();
         void     seedRandomNumberGenerator();
         void     flash();
+        void     commitSettings();
+        void     migrateSettings(uint8_t layout);
+        void     readGains();
+        void     writeGains();
+        void     defaultGains();
+        void     readCalibration();
+        void     writeCalibration();
         
 
 };
@@ -0,0 +1,532 @@
+#include <DoorTask.h>
+#include <Logger.h>
+#include <string.h>
+
+/* Argument bounds for every recognised command */
+struct CommandBounds{
+    char    command;
+    bool    hasArgument;
+    int32_t min;
+    int32_t max;
+};
+
+static const CommandBounds commandBounds[] = {
+    {'0', true,  0, 1},     // Automation
+    {'1', false, 0, 0},     // Unused
+    {'2', true,  0, 1},     // Move door
+    {'4', true,  DOOR_MIN_TOP_POSITION, DOOR_MAX_TOP_POSITION}, // Motor top position in encoder counts
+    {'5', true,  0, 254},   // Lower light threshold
+    {'6', true,  1, 254},   // Upper light threshold
+    {'7', true,  1, 254},   // Door ID, 255 is reserved
+    {'8', true,  -MAX_CLOSE_OFFSET, MAX_CLOSE_OFFSET},
+    {'9', false, 0, 0},     // Unused
+    {'a', false, 0, 0},     // Disable automation delay
+    {'b', true,  0, 2},     // Heartbeat format
+    {'g', true,  0, 1},     // Remote log format
+    {'k', false, 0, 0},     // Request keyframe
+    {'m', true,  0, 1},     // Save motor position
+    {'n', true,  1, 255},   // Motor travel time
+    {'u', true,  0, 100},   // Motor accel time
+    {'w', true,  0, 100},   // Motor decel time
+    {'j', true,  0, 1},     // Motor profile shape
+    {'f', false, 0, 0},     // Factory reset
+    {'h', false, 0, 0},     // Help
+    {'o', false, 0, 0},     // Forced open
+    {'c', false, 0, 0},     // Forced closed
+    {'p', false, 0, 0},     // Reserved
+    {'d', false, 0, 0},     // Reserved
+    {'l', true,  0, 1},     // LDR enable
+    {'t', true,  0, 1},     // Time enable
+    {'r', false, 0, 0},     // Restart
+    {'s', true,  50, 10000},// Stall time in ms
+    {'x', true,  0, 65535}, // Position loop gains in thousandths
+    {'z', false, 0, 0},     // Calibrate travel
+    {'v', false, 0, 0},     // Version
+};
+
+/* Sent a part at a time, the whole text is longer than RESPONSE_LENGTH */
+static const char* const helpText[] = {
+    "1 [1:0]=LDR on\n2 [1:0]=MV Door\n4 [counts]=MTR Top\n5 [0-254]=LWR Light\n6 [1-254]=UPR Light\n7 [1-254]=ID\n8 [+-720]=Close offset mins\n;=Separates commands, e.g. 4 12;5 20;v\na=Disable Automation delay\n",
+    "b [0-2]=Heartbeat text/binary/delta\ng [1:0]=Binary log\nk=Keyframe\nm [1:0]=SaveMTRPos\nn/u/w [x100ms]=MTR travel/accel/decel\nj [1:0]=MTR S-curve\ns [50-10000]=Stall ms\nx kp,ki,kd,kff [x0.001]=MTR gains\n",
+    "z=Calibrate MTR travel\nf=Reset\no=Open\nc=Close\n",
+};
+
+thread_local DoorTask* DoorTask::s_active = NULL;
+
+DoorTask::DoorTask(DoorHandler& door, Scheduler& scheduler, const DoorLink& link)
+: m_door(door),
+  m_scheduler(scheduler),
+  m_link(link),
+  m_automationDelay(true),
+  m_automationJob(SCHEDULER_NO_JOB),
+  m_motionJob(SCHEDULER_NO_JOB),
+  m_heartbeatFormat(HEARTBEAT_TEXT),
+  m_heartbeatSequence(0)
+{
+}
+
+void DoorTask::begin(uint32_t heartbeatDelay)
+{
+    /* Registration order decides who runs first on a shared deadline */
+    m_scheduler.add(doorJob, POLLING_PERIOD, POLLING_PERIOD);
+    m_scheduler.add(offlineJob, OFFLINE_PERIOD, OFFLINE_PERIOD);
+    m_motionJob     = m_scheduler.add(doorMotionJob, MOTION_PERIOD, 0, false);
+    m_scheduler.add(heartbeatJob, HEARTBEAT_PERIOD, heartbeatDelay);
+    m_automationJob = m_scheduler.add(automationExpiryJob, 0, AUTOMATION_DELAY_X);
+}
+
+/*
+-----------------------------------------------------------
+----------------- SCHEDULED JOBS  -------------------------
+-----------------------------------------------------------
+*/
+void DoorTask::doorJob()
+{
+    DoorTask& self = *s_active;
+    if(self.m_link.connected()) self.pollDoor();
+}
+
+/* Every second as the old loop did, offline the door still follows the LDR */
+void DoorTask::offlineJob()
+{
+    DoorTask& self = *s_active;
+    if(!self.m_door.ldrEnabled()) return;
+
+    logDebug(MAIN, "offlineJob() Light: %d", self.m_door.getLightLevel());
+    if(!self.m_link.connected()) self.pollDoor();
+}
+
+/* Only armed whilst the door is moving */
+void DoorTask::doorMotionJob()
+{
+    DoorTask& self = *s_active;
+    if(self.m_door.update()) return;
+
+    self.m_scheduler.disarm(self.m_motionJob);
+    self.doorMoveFinished();
+}
+
+void DoorTask::heartbeatJob()
+{
+    DoorTask& self = *s_active;
+    if(self.m_link.connected()) self.acknowledge();
+}
+
+void DoorTask::automationExpiryJob()
+{
+    logDebug(MAIN, "automationExpiryJob() Automation delay has expired.");
+    s_active->m_automationDelay = false;
+}
+
+/*
+-----------------------------------------------------------
+----------------- DOOR        -----------------------------
+-----------------------------------------------------------
+*/
+bool DoorTask::pollDoor()
+{
+    /* If the automation is disabled then return */
+    if(m_automationDelay)
+    {
+        uint32_t remaining = m_scheduler.timeUntil(m_automationJob)/1000;
+        logRemote(MAIN, "pollDoor() automationDelay=1, time until automation enabled=%u", remaining);
+        return false;
+    }
+
+    bool doorMoved = m_door.poll();
+
+    logRemote(MAIN, "pollDoor() Door moved=%d", doorMoved);
+
+    /* Motion is finished off by doorMotionJob() */
+    if(doorMoved) m_scheduler.arm(m_motionJob, 0);
+
+    return doorMoved;
+}
+
+/* Called once the door has come to rest after moving */
+void DoorTask::doorMoveFinished()
+{
+    logRemote(MAIN, "doorMoveFinished() Door has come to rest, closed=%d", m_door.isClosed());
+    if(m_door.isBlocked())     updateReliable("pollDoor() DM:4"); // As getDoorState()
+    else if(m_door.isClosed()) updateReliable("pollDoor() DM:0");
+    else if(m_door.isOpen())   updateReliable("pollDoor() DM:1");
+
+    // Light may cause problems, we don't want the door flinging open and closed every 30 seconds
+    if(m_door.ldrEnabled() && !m_door.timeEnabled())
+    {
+      delayAutomation();
+    }
+}
+
+bool DoorTask::moveDoor(bool direction)
+{
+    /* Regardless of direction, did the door move? */
+    bool result = m_door.moveDoor(direction);
+    logDebug(MAIN, "moveDoor() direction=%d, Door moved=%d", direction, result);
+    if(result)
+    {
+        /* Manual moved, as such delay automation from
+           forcing the door back in a previous state  */
+        delayAutomation();
+        m_scheduler.arm(m_motionJob, 0);
+    }
+    return result;
+}
+
+/* Command 'z', the door runs between its end stops learning the travel */
+bool DoorTask::calibrateDoor()
+{
+    bool result = m_door.calibrate();
+    logDebug(MAIN, "calibrateDoor() Calibrating=%d", result);
+    if(result)
+    {
+        delayAutomation();
+        m_scheduler.arm(m_motionJob, 0);
+    }
+    return result;
+}
+
+/* Holds off automation for AUTOMATION_DELAY_X, restarting the window */
+void DoorTask::delayAutomation()
+{
+    m_automationDelay = true;
+    m_scheduler.arm(m_automationJob, AUTOMATION_DELAY_X);
+}
+
+/* Command 'x', gains in thousandths and in the order kp, ki, kd, kff.
+   Only those given change, e.g. "x 4000" retunes kp alone.          */
+void DoorTask::setControlGains(CommandParser& pb)
+{
+    PositionGains gains = m_door.getGains();
+    float* fields[] = {&gains.kp, &gains.ki, &gains.kd, &gains.kff};
+    for(uint8_t i = 0; i < pb.getArgumentCount(); i++)
+    {
+        *fields[i] = pb.getArgument(i) / 1000.0f;
+    }
+    m_door.setGains(gains);
+
+    char reply[RESPONSE_LENGTH];
+    snprintf(reply, sizeof(reply), "setControlGains() kp=%d ki=%d kd=%d kff=%d",
+             (int)(gains.kp * 1000 + 0.5f), (int)(gains.ki * 1000 + 0.5f),
+             (int)(gains.kd * 1000 + 0.5f), (int)(gains.kff * 1000 + 0.5f));
+    update(reply);
+}
+
+/*
+-----------------------------------------------------------
+----------------- COMMANDS    -----------------------------
+-----------------------------------------------------------
+*/
+
+/* A datagram carries one or more ';' separated commands, e.g.
+   "4 12;5 20;6 40;v". Every command is checked before any is run,
+   each against what the commands before it leave behind, so a
+   request is applied whole or not at all. The sender gets a single
+   reply: "R:<result per command>;<state snapshot>".              */
+uint16_t DoorTask::execute(const char* packet, uint16_t length, char* reply, uint16_t size)
+{
+    uint8_t     results[REQUEST_MAX_COMMANDS];
+    uint8_t     count = 0;
+    bool        valid = true;
+    RequestPlan plan;
+    startPlan(plan);
+
+    /* First pass, validate */
+    for(uint16_t start = 0, end = 0; start < length; start = end + 1)
+    {
+        end = segmentEnd(packet, length, start);
+
+        CommandParser pb(packet + start, end - start);
+        if(!pb.hasCommand()) continue; // Empty segment, e.g. trailing ';'
+
+        if(count >= REQUEST_MAX_COMMANDS)
+        {
+            results[REQUEST_MAX_COMMANDS-1] = RESULT_TOO_MANY;
+            valid = false;
+            break;
+        }
+        results[count] = checkCommand(pb);
+        if(results[count] == RESULT_OK) results[count] = planCommand(pb, count, plan);
+        if(results[count++] != RESULT_OK) valid = false;
+    }
+
+    /* The thresholds as the request leaves them, "5 40;6 60" is fine from 37 and 25 */
+    if(plan.lastThreshold >= 0 && !DoorHandler::validLightThresholds(plan.upper, plan.lower))
+    {
+        if(results[plan.lastThreshold] == RESULT_OK) results[plan.lastThreshold] = RESULT_BAD_ARGUMENT;
+        valid = false;
+    }
+
+    /* Second pass, apply in order */
+    uint8_t index = 0;
+    for(uint16_t start = 0, end = 0; start < length && index < count; start = end + 1)
+    {
+        end = segmentEnd(packet, length, start);
+
+        CommandParser pb(packet + start, end - start);
+        if(!pb.hasCommand()) continue;
+
+        if(!valid)
+        {
+            if(results[index] == RESULT_OK) results[index] = RESULT_SKIPPED;
+        }
+        else if(!applyCommand(pb, plan)) results[index] = RESULT_FAILED;
+        index++;
+    }
+
+    logDebug(MAIN, "executeRequest() Commands=%d applied=%d", count, valid);
+    return formatReply(results, count, reply, size);
+}
+
+uint16_t DoorTask::reject(uint8_t result, char* reply, uint16_t size)
+{
+    return formatReply(&result, 1, reply, size);
+}
+
+/* "(ID:n)-R:<results>;<state>", its length */
+uint16_t DoorTask::formatReply(const uint8_t* results, uint8_t count, char* reply, uint16_t size)
+{
+    int written = snprintf(reply, size, "(ID:%d)-R:", m_door.getID());
+    for(uint8_t i = 0; i < count && written < size; i++)
+    {
+        written += snprintf(reply + written, size - written, i ? ",%d" : "%d", results[i]);
+    }
+    if(written < size)
+    {
+        written += snprintf(reply + written, size - written, ";%s", m_door.getState().getResponse());
+    }
+    return written < size ? written : size - 1;
+}
+
+/* Index of the ';' ending the command starting at 'start', or the length */
+uint16_t DoorTask::segmentEnd(const char* packet, uint16_t length, uint16_t start)
+{
+    while(start < length && packet[start] != ';') start++;
+    return start;
+}
+
+/* Result code for a command before it is run, see commandBounds */
+uint8_t DoorTask::checkCommand(CommandParser& pb)
+{
+    if(!pb.isValid()) return RESULT_MALFORMED;
+
+    for(uint8_t i = 0; i < sizeof(commandBounds)/sizeof(commandBounds[0]); i++)
+    {
+        const CommandBounds& bounds = commandBounds[i];
+        if(bounds.command != pb.getCommand()) continue;
+
+        if(!bounds.hasArgument) return RESULT_OK;
+        if(!pb.hasArgument(bounds.min, bounds.max)) return RESULT_BAD_ARGUMENT;
+
+        /* Any further arguments share the same bounds */
+        for(uint8_t arg = 1; arg < pb.getArgumentCount(); arg++)
+        {
+            if(!pb.hasArgument(bounds.min, bounds.max, arg)) return RESULT_BAD_ARGUMENT;
+        }
+        return RESULT_OK;
+    }
+    return RESULT_UNKNOWN;
+}
+
+void DoorTask::startPlan(RequestPlan& plan)
+{
+    plan.upper         = m_door.getLightUpperThreshold();
+    plan.lower         = m_door.getLightLowerThreshold();
+    plan.lastThreshold = -1;
+    plan.moving        = m_door.getMotionState() != MOTION_IDLE;
+    plan.restart       = false;
+}
+
+/* Result code for a command after those before it in the request,
+   its arguments already checked by checkCommand(). What would fail
+   once run fails here instead, before anything has been applied. */
+uint8_t DoorTask::planCommand(CommandParser& pb, uint8_t index, RequestPlan& plan)
+{
+    if(plan.restart) return RESULT_AFTER_RESTART;
+
+    switch(pb.getCommand())
+    {
+        case '2': // May start the door moving
+            plan.moving = true;
+            break;
+        case '4':
+            if(!DoorHandler::validTopPosition(pb.getArgument())) return RESULT_BAD_ARGUMENT;
+            break;
+        case '5': // Checked as a pair with '6' once the request ends
+            plan.lower         = pb.getArgument();
+            plan.lastThreshold = index;
+            break;
+        case '6':
+            plan.upper         = pb.getArgument();
+            plan.lastThreshold = index;
+            break;
+        case 'j':
+            if(!DoorHandler::validMotorProfile(pb.getArgument())) return RESULT_BAD_ARGUMENT;
+            break;
+        case 'f': // As flash() leaves them
+            plan.upper = D_LIGHT_THRESHOLD_TOP;
+            plan.lower = D_LIGHT_THRESHOLD_BOTTOM;
+            break;
+        case 'r': // The platform restarts once the reply is away
+            plan.restart = true;
+            break;
+        case 'z': // calibrate() refuses a door that is moving
+            if(plan.moving) return RESULT_FAILED;
+            plan.moving = true;
+            break;
+        default:
+            break;
+    }
+    return RESULT_OK;
+}
+
+/* A command of a request that planned out, the thresholds go in as
+   the pair the request ends on, as one alone may not be valid yet. */
+bool DoorTask::applyCommand(CommandParser& pb, const RequestPlan& plan)
+{
+    if(pb.getCommand() == '5' || pb.getCommand() == '6')
+    {
+        return m_door.setLightThresholds(plan.upper, plan.lower);
+    }
+    return interpretPacketCommand(pb);
+}
+
+bool DoorTask::interpretPacketCommand(CommandParser& pb)
+{
+    logRemote(MAIN, "interpretPacketCommand() Parsing command: %c, args: %d - %d", pb.getCommand(), pb.getArgumentCount(), pb.getArgument());
+
+    /* Arguments were range checked by checkCommand(), a setter
+       that still refuses one or changes it fails the command.  */
+    switch(pb.getCommand())
+    {
+        case '0': // disable/enable automation
+            m_door.setAutomated(pb.getArgument());
+            break;
+        case '1': // unused
+            break;
+        case '2': // move door
+             moveDoor(pb.getArgument());
+            break;
+        case '4': // set motor top position
+            return m_door.setTopPosition(pb.getArgument()) == pb.getArgument();
+        case '5': // set door lower light threshold
+            return m_door.setLightLowerThreshold(pb.getArgument()) == pb.getArgument();
+        case '6': // set door upper light threshold
+            return m_door.setLightUpperThreshold(pb.getArgument()) == pb.getArgument();
+        case '7': // set door ID
+            return m_door.setDoorId(pb.getArgument()) == pb.getArgument();
+        case '8': // add time to door closing time
+            m_door.setDoorCloseTime(pb.getArgument());
+            break;
+        case '9': // unused
+            break;
+        case 'a': // disable automation delay (Door will 'refresh')
+            m_automationDelay = false;
+            m_scheduler.disarm(m_automationJob);
+            break;
+        case 'm': // Do we save the motors position in EEPROM?
+            m_door.setMotorSaved(pb.getArgument());
+            break;
+        case 'n': // Motor travel time, closed to open in n*100ms
+            return m_door.setMotorMoveSpeed(pb.getArgument()) == pb.getArgument();
+        case 'u': // Motor ramp up time, n*100ms
+            return m_door.setMotorAccelTime(pb.getArgument()) == pb.getArgument();
+        case 'w': // Motor ramp down time, n*100ms
+            return m_door.setMotorDecelTime(pb.getArgument()) == pb.getArgument();
+        case 'j': // Motor profile, 0 = trapezoid, 1 = S-curve
+            return m_door.setMotorProfile(pb.getArgument()) == pb.getArgument();
+        case 'f': // Factory reset
+            m_door.factoryReset();
+        case 'h': // Help
+            update("interpretPacketCommand() Displaying help.");
+            for(uint8_t i = 0; i < sizeof(helpText)/sizeof(helpText[0]); i++) update(helpText[i]);
+            break;
+        case 'o': // Set door to open
+            logInfo(MAIN, "interpretPacketCommand() Forcing door to be open.");
+            m_door.forcedOpen();
+            delayAutomation();
+            break;
+        case 'c': // Set door to closed
+            logInfo(MAIN, "interpretPacketCommand() Forcing door to be closed.");
+            m_door.forcedClosed();
+            delayAutomation();
+            break;
+        case 'b': // Heartbeat format, 0 = text, 1 = binary frame, 2 = binary delta
+            m_heartbeatFormat = pb.getArgument();
+            m_heartbeatEncoder.requestKeyframe();
+            break;
+        case 'k': // Next delta heartbeat is a full keyframe
+            m_heartbeatEncoder.requestKeyframe();
+            break;
+        case 'p': // reserved
+            break;
+        case 'd': // reserved
+            break;
+        case 'l': // Light enable/disable
+             m_door.setLDREnabled(pb.getArgument());
+            break;
+        case 't': // Time enable/disable
+             m_door.setTimeEnabled(pb.getArgument());
+            break;
+        case 's': // No encoder edge for this many ms while moving stops the motor
+            return m_door.setStallTime(pb.getArgument()) == pb.getArgument();
+        case 'x': // Position loop gains, kp[,ki[,kd[,kff]]] in thousandths, missing ones are kept
+            setControlGains(pb);
+            break;
+        case 'z': // Home the door and learn its travel, refused whilst it is moving
+            return calibrateDoor();
+        case ILLEGAL_COMMAND:  // Unrecongised command
+            logDebug(MAIN, "interpretPacketCommand() Command received was invalid.");
+            return false;
+        default: // Restart, version and logging belong to the platform
+            if(m_link.command != NULL) return m_link.command(pb);
+            logDebug(MAIN, "interpretPacketCommand() Unrecognised command!");
+            return false;
+    }
+    return true;
+}
+
+/*
+-----------------------------------------------------------
+----------------- OUTBOUND    -----------------------------
+-----------------------------------------------------------
+*/
+
+/* Simple ack function */
+bool DoorTask::acknowledge()
+{
+    logDebug(MAIN, "acknowledge() Connected=%d", m_link.connected());
+    if(m_link.connected())
+    {
+        DoorHandler::Response response = m_door.getState();
+        if(m_heartbeatFormat != HEARTBEAT_TEXT)
+        {
+            /* No text is ever formatted on this path */
+            uint8_t frame[TELEMETRY_DELTA_MAX_LENGTH];
+            TelemetryStatus& status = response.getStatus();
+            status.sequence = m_heartbeatSequence++;
+            status.uptime   = m_scheduler.now()/1000;
+
+            uint8_t len = m_heartbeatFormat == HEARTBEAT_DELTA ? m_heartbeatEncoder.encode(status, frame)
+                                                               : telemetryEncode(status, frame);
+            return m_link.send(frame, len);
+        }
+        logRemote(MAIN, "acknowledge() Acknowledging host.");
+        return update(response.getResponse());
+    }
+    return false;
+}
+
+bool DoorTask::update(const char* text)
+{
+    char message[RESPONSE_LENGTH]; // Prepare to expand buffer to fit ID into
+    int  written = snprintf(message, RESPONSE_LENGTH, "(ID:%d)-%s", m_door.getID(), text);
+    return m_link.send((const uint8_t*)message, written < RESPONSE_LENGTH ? written : RESPONSE_LENGTH - 1);
+}
+
+/* Must reach the collector, e.g. door moved, see ReliableChannel */
+bool DoorTask::updateReliable(const char* text)
+{
+    uint16_t length = strlen(text);
+    return m_link.sendReliable(text, length < RELIABLE_PAYLOAD ? length : RELIABLE_PAYLOAD);
+}
@@ -0,0 +1,125 @@
+#ifndef DOOR_TASK
+#define DOOR_TASK 1
+
+#include <stdint.h> // Precise type allocation
+#include <DoorHandler.h>
+#include <Scheduler.h>
+#include <CommandParser.h>
+#include <Telemetry.h>
+#include <ReliableChannel.h>
+
+/* Loop constraints, all in milliseconds. Shared by src/main.cpp and
+   the host simulations in tools/, so they run to the same clock.   */
+#define POLLING_PERIOD      5000        // 5 seconds - frequency to check door
+#define OFFLINE_PERIOD      1000        // 1 second - light log, and LDR polling whilst disconnected
+#define NETWORK_PERIOD      100         // 100ms - worst case latency before a command is read
+#define MOTION_PERIOD       10          // 10ms - step rate of the door motion state machine
+#define HEARTBEAT_PERIOD    15000       // 15 seconds - frequency to check heartbeats
+#define RECONNECT_PERIOD    15000       // 15 seconds - frequency to retry WiFi when disconnected
+#define RETRANSMIT_PERIOD   100         // 100ms - resolution of reliable event retransmits
+#define AUTOMATION_DELAY_X  900000      // 900 seconds, aka 15m - default time to disable automation when door moves remotely
+
+#define COMMAND_LENGTH      128         // Longest datagram handed to the door task
+#define REQUEST_MAX_COMMANDS 16         // Commands per datagram, ';' separated
+#define MAX_CLOSE_OFFSET    720         // Minutes either side of sunset, command '8'
+
+/* Heartbeat formats, command 'b' */
+#define HEARTBEAT_TEXT      0           // "!ID=..." text
+#define HEARTBEAT_BINARY    1           // Full binary frame every heartbeat
+#define HEARTBEAT_DELTA     2           // Changed fields only, periodic keyframes
+
+/* Result codes, one per command in a request's reply */
+#define RESULT_OK           0
+#define RESULT_UNKNOWN      1   // Unrecognised command
+#define RESULT_MALFORMED    2   // Argument could not be parsed
+#define RESULT_BAD_ARGUMENT 3   // Argument missing or out of bounds
+#define RESULT_SKIPPED      4   // Valid, but another command in the request was not
+#define RESULT_FAILED       5   // Refused by the door, e.g. 'z' whilst it is moving
+#define RESULT_TOO_MANY     6   // More than REQUEST_MAX_COMMANDS in the request
+#define RESULT_AFTER_RESTART 7  // Follows 'r', a restart must be the request's last command
+
+/* Whatever carries the door's packets: WiFi and the network task on
+   the ESP32, a socket per door in tools/loadgen.                    */
+struct DoorLink{
+    bool (*connected)();
+    bool (*send)(const uint8_t* data, uint8_t length);          // To the collector, as is
+    bool (*sendReliable)(const char* payload, uint8_t length);  // Sequenced, see ReliableChannel
+    bool (*command)(CommandParser& pb);                         // Commands the platform owns, false if rejected
+};
+
+/* The door task's jobs and command handling, everything src/main.cpp
+   runs on DOOR_CORE bar the queues. Jobs take no arguments, so they
+   act on the DoorTask selected on the calling thread.               */
+class DoorTask{
+
+    public:
+
+        DoorTask(DoorHandler& door, Scheduler& scheduler, const DoorLink& link);
+
+        /* Registers the jobs, the first heartbeat 'heartbeatDelay' from now */
+        void     begin(uint32_t heartbeatDelay = HEARTBEAT_PERIOD);
+        void     select()               {s_active = this;}
+
+        /* A ';' separated request, applied whole or not at all. The
+           reply, "(ID:n)-R:<result per command>;<state>", is written
+           to 'reply' and its length returned. A restart it asks for
+           is the platform's to carry out once the reply is sent.  */
+        uint16_t execute(const char* packet, uint16_t length, char* reply, uint16_t size);
+        /* A request none of which is run, e.g. longer than COMMAND_LENGTH,
+           replied to as execute() would with the single 'result'.       */
+        uint16_t reject(uint8_t result, char* reply, uint16_t size);
+        uint8_t  checkCommand(CommandParser& pb);
+        bool     interpretPacketCommand(CommandParser& pb);
+
+        bool     pollDoor();
+        bool     moveDoor(bool direction);
+        bool     calibrateDoor();
+        void     delayAutomation();
+        bool     acknowledge();
+        bool     isMoving()             {return m_scheduler.isArmed(m_motionJob);}
+
+        /* Text to the collector, prefixed "(ID:n)-" */
+        bool     update(const char* text);
+        bool     updateReliable(const char* text);
+
+    private:
+
+        /* What a request leaves behind, worked out before any of it
+           runs. The thresholds are checked as a pair once it ends. */
+        struct RequestPlan{
+            uint8_t upper;              // Light thresholds
+            uint8_t lower;
+            int8_t  lastThreshold;      // Index of the last '5' or '6', -1 if none
+            bool    moving;             // Door moving, or a '2' before this may have started it
+            bool    restart;            // An 'r', nothing may follow it
+        };
+
+        DoorHandler&          m_door;
+        Scheduler&            m_scheduler;
+        DoorLink              m_link;
+        bool                  m_automationDelay;
+        int8_t                m_automationJob;
+        int8_t                m_motionJob;
+        uint8_t               m_heartbeatFormat;    // Format the collector asked for
+        uint16_t              m_heartbeatSequence;
+        TelemetryDeltaEncoder m_heartbeatEncoder;
+
+        static thread_local DoorTask* s_active;
+
+        static void doorJob();
+        static void offlineJob();
+        static void doorMotionJob();
+        static void heartbeatJob();
+        static void automationExpiryJob();
+
+        void     doorMoveFinished();
+        void     setControlGains(CommandParser& pb);
+        void     startPlan(RequestPlan& plan);
+        uint8_t  planCommand(CommandParser& pb, uint8_t index, RequestPlan& plan);
+        bool     applyCommand(CommandParser& pb, const RequestPlan& plan);
+        uint16_t segmentEnd(const char* packet, uint16_t length, uint16_t start);
+        uint16_t formatReply(const uint8_t* results, uint8_t count, char* reply, uint16_t size);
+
+};
+
+#endif
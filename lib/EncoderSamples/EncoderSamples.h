@@ -0,0 +1,125 @@
+#ifndef ENCODER_SAMPLES
+#define ENCODER_SAMPLES 1
+
+#include <stdint.h> // Precise type allocation
+#include <atomic>   // Portable between the ESP32 and a host build
+
+#define ENCODER_SAMPLE_COUNT    8   // Power of two, rates are taken across the whole ring
+#define ENCODER_NO_EDGE         UINT32_MAX
+
+struct EncoderSample{
+    uint32_t time;      // micros()
+    int32_t  position;
+};
+
+/* The last few (time, position) pairs, written from the edge interrupt
+   and read from a task, possibly on the other core. A sequence count
+   around each write lets readers take a consistent copy without ever
+   holding the writer up. Everything a reader asks for is worked out
+   from a fixed number of samples, so it all costs the same each time. */
+class EncoderSamples{
+
+    static_assert((ENCODER_SAMPLE_COUNT & (ENCODER_SAMPLE_COUNT - 1)) == 0,
+                  "ENCODER_SAMPLE_COUNT must be a power of two");
+
+    public:
+
+        EncoderSamples() : m_sequence(0), m_count(0)
+        {
+            for(int i = 0; i < ENCODER_SAMPLE_COUNT; i++)
+            {
+                m_time[i].store(0, std::memory_order_relaxed);
+                m_position[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /* Edge interrupt only, there must be a single writer. Inlined
+           so it ends up wherever the handler is placed (IRAM).      */
+        inline __attribute__((always_inline)) void record(uint32_t time, int32_t position)
+        {
+            uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+            m_sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            uint32_t count = m_count.load(std::memory_order_relaxed);
+            uint32_t slot  = count & (ENCODER_SAMPLE_COUNT - 1);
+            m_time[slot].store(time, std::memory_order_relaxed);
+            m_position[slot].store(position, std::memory_order_relaxed);
+            m_count.store(count + 1, std::memory_order_relaxed);
+
+            m_sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        /* Oldest first, returns how many are valid */
+        uint8_t snapshot(EncoderSample samples[ENCODER_SAMPLE_COUNT])
+        {
+            uint32_t before, after, count;
+            do
+            {
+                before = m_sequence.load(std::memory_order_acquire);
+                count  = m_count.load(std::memory_order_relaxed);
+                uint8_t valid = count < ENCODER_SAMPLE_COUNT ? count : ENCODER_SAMPLE_COUNT;
+                for(uint8_t i = 0; i < valid; i++)
+                {
+                    uint32_t slot = (count - valid + i) & (ENCODER_SAMPLE_COUNT - 1);
+                    samples[i].time     = m_time[slot].load(std::memory_order_relaxed);
+                    samples[i].position = m_position[slot].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = m_sequence.load(std::memory_order_relaxed);
+            }
+            while((before & 1) || before != after);
+
+            return count < ENCODER_SAMPLE_COUNT ? count : ENCODER_SAMPLE_COUNT;
+        }
+
+        /* Counts per second across the ring, 0 until two edges are in */
+        int32_t velocity()
+        {
+            EncoderSample s[ENCODER_SAMPLE_COUNT];
+            uint8_t n = snapshot(s);
+            if(n < 2) return 0;
+            return rate(s[0], s[n - 1]);
+        }
+
+        /* Counts per second per second, the rate over the newer half
+           of the ring against the older, 0 until three edges are in */
+        int32_t acceleration()
+        {
+            EncoderSample s[ENCODER_SAMPLE_COUNT];
+            uint8_t n = snapshot(s);
+            if(n < 3) return 0;
+
+            const EncoderSample& first  = s[0];
+            const EncoderSample& middle = s[(n - 1) / 2];
+            const EncoderSample& last   = s[n - 1];
+            int32_t  span = (int32_t)(last.time - first.time) / 2;
+            if(span <= 0) return 0;
+            return (int64_t)(rate(middle, last) - rate(first, middle)) * 1000000 / span;
+        }
+
+        /* Microseconds from the newest edge to 'now', ENCODER_NO_EDGE if none yet */
+        uint32_t sinceLastEdge(uint32_t now)
+        {
+            EncoderSample s[ENCODER_SAMPLE_COUNT];
+            uint8_t n = snapshot(s);
+            return n ? now - s[n - 1].time : ENCODER_NO_EDGE;
+        }
+
+    private:
+
+        std::atomic<uint32_t> m_sequence;   // Odd whilst a write is in progress
+        std::atomic<uint32_t> m_count;      // Edges ever recorded
+        std::atomic<uint32_t> m_time[ENCODER_SAMPLE_COUNT];
+        std::atomic<int32_t>  m_position[ENCODER_SAMPLE_COUNT];
+
+        static int32_t rate(const EncoderSample& from, const EncoderSample& to)
+        {
+            uint32_t elapsed = to.time - from.time;
+            if(elapsed == 0) return 0;
+            return (int64_t)(to.position - from.position) * 1000000 / elapsed;
+        }
+
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <Logger.h>
+#include <stdio.h>
+
+#if defined(ESP32)
+    #include <Arduino.h>
+    static portMUX_TYPE sharedLock = portMUX_INITIALIZER_UNLOCKED;
+    #define LOG_SHARED_LOCK()   portENTER_CRITICAL(&sharedLock)
+    #define LOG_SHARED_UNLOCK() portEXIT_CRITICAL(&sharedLock)
+#else
+    #include <mutex>
+    static std::mutex sharedLock;
+    #define LOG_SHARED_LOCK()   sharedLock.lock()
+    #define LOG_SHARED_UNLOCK() sharedLock.unlock()
+#endif
+
+Logger logger;
+thread_local int8_t Logger::s_ring = -1;
+
+Logger::Logger()
+: m_clock(0),
+  m_sink(0),
+  m_flush(0),
+  m_dropped(0)
+{
+}
+
+void Logger::begin(Clock clock, Sink sink, Flush flush)
+{
+    m_clock = clock;
+    m_sink  = sink;
+    m_flush = flush;
+}
+
+void Logger::attach(uint8_t ring)
+{
+    if(ring < LOG_SHARED_RING) s_ring = ring;
+}
+
+/* An attached task is its ring's only writer, the rest take turns */
+void Logger::push(LogRecord& record)
+{
+    record.timestamp = m_clock ? m_clock() : 0;
+
+    bool pushed;
+    if(s_ring >= 0) pushed = m_rings[s_ring].push(record);
+    else
+    {
+        LOG_SHARED_LOCK();
+        pushed = m_rings[LOG_SHARED_RING].push(record);
+        LOG_SHARED_UNLOCK();
+    }
+    if(!pushed) __atomic_fetch_add(&m_dropped, 1, __ATOMIC_RELAXED);
+}
+
+uint16_t Logger::drain(uint16_t max)
+{
+    if(m_sink == 0) return 0;
+
+    uint16_t  count = 0;
+    LogRecord record;
+    for(uint8_t ring = 0; ring < LOG_PRODUCERS; ring++)
+    {
+        while(count < max && m_rings[ring].pop(record))
+        {
+            m_sink(record);
+            count++;
+        }
+    }
+    if(count > 0 && m_flush) m_flush();
+    return count;
+}
+
+uint16_t Logger::format(const LogRecord& record, char* buffer, uint16_t size)
+{
+    /* Surplus arguments are evaluated and ignored by printf */
+    const int32_t* a = record.args;
+    int written = snprintf(buffer, size, record.format, a[0], a[1], a[2], a[3], a[4], a[5]);
+    if(written < 0) written = 0;
+    return written < size ? written : size - 1;
+}
+
+uint8_t Logger::encode(const LogRecord& record, uint8_t* buffer, uint16_t size)
+{
+    if(size < LOG_WIRE_RECORD_MAX || record.argCount > LOG_MAX_ARGS) return 0;
+
+    buffer[0] = record.id;
+    buffer[1] = record.id >> 8;
+    buffer[2] = record.timestamp;
+    buffer[3] = record.timestamp >> 8;
+    buffer[4] = record.timestamp >> 16;
+    buffer[5] = record.timestamp >> 24;
+    buffer[6] = (record.module & 0x03) << 6 | (record.level & 0x03) << 4 | record.argCount;
+
+    /* Zigzag keeps small negatives, e.g. -1, down to a single byte */
+    uint8_t pos = 7;
+    for(uint8_t i = 0; i < record.argCount; i++)
+    {
+        uint32_t value = ((uint32_t)record.args[i] << 1) ^ (uint32_t)(record.args[i] >> 31);
+        while(value >= 0x80)
+        {
+            buffer[pos++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        buffer[pos++] = value;
+    }
+    return pos;
+}
+
+uint8_t Logger::decode(const uint8_t* buffer, uint16_t len, LogRecord& record)
+{
+    if(len < 7) return 0;
+
+    record.format    = 0;
+    record.id        = buffer[0] | buffer[1] << 8;
+    record.timestamp = (uint32_t)buffer[2] | (uint32_t)buffer[3] << 8 | (uint32_t)buffer[4] << 16 | (uint32_t)buffer[5] << 24;
+    record.module    = buffer[6] >> 6;
+    record.level     = (buffer[6] >> 4) & 0x03;
+    record.argCount  = buffer[6] & 0x0F;
+    record.flags     = LOG_FLAG_REMOTE;
+    if(record.argCount > LOG_MAX_ARGS) return 0;
+
+    uint16_t pos = 7;
+    for(uint8_t i = 0; i < LOG_MAX_ARGS; i++)
+    {
+        uint32_t value = 0;
+        for(uint8_t shift = 0; i < record.argCount; shift += 7)
+        {
+            if(pos >= len || shift > 28) return 0;
+            value |= (uint32_t)(buffer[pos] & 0x7F) << shift;
+            if(!(buffer[pos++] & 0x80)) break;
+        }
+        record.args[i] = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    }
+    return pos;
+}
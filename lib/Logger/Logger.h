@@ -0,0 +1,183 @@
+#ifndef LOGGER
+#define LOGGER 1
+
+#include <stdint.h> // Precise type allocation
+#include <stddef.h>
+#include <type_traits>
+#include <SpscQueue.h>
+
+/* Levels, a record is kept when its level <= the module's level */
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_INFO      2
+#define LOG_LEVEL_DEBUG     3
+
+/* Modules, each has its own compile time LOG_LEVEL_<module> which may
+   be overridden with build flags, e.g. -DLOG_LEVEL_DOOR=LOG_LEVEL_NONE */
+#define LOG_MODULE_MAIN     0
+#define LOG_MODULE_DOOR     1
+#define LOG_MODULE_NETWORK  2
+
+#ifndef LOG_LEVEL_MAIN
+    #define LOG_LEVEL_MAIN      LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_LEVEL_DOOR
+    #define LOG_LEVEL_DOOR      LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_LEVEL_NETWORK
+    #define LOG_LEVEL_NETWORK   LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_MAX_ARGS        6
+#define LOG_RING_SIZE       64      // Records per ring, power of two
+#define LOG_PRODUCERS       4       // Rings, one per attached task plus the shared one
+#define LOG_SHARED_RING     (LOG_PRODUCERS - 1)
+#define LOG_LINE_LENGTH     160
+
+#define LOG_FLAG_REMOTE     0x01    // Also forwarded to the collector
+
+/* Interned formats, every format string is known by a 16 bit ID
+   folded at compile time. tools/log_dictionary.py hashes the same
+   literals out of the sources into a dictionary for the collector,
+   both sides must agree on this FNV-1a.                            */
+#define LOG_HASH_BASIS      2166136261u
+#define LOG_HASH_PRIME      16777619u
+
+constexpr uint32_t logHash(const char* s, uint32_t hash = LOG_HASH_BASIS)
+{
+    return *s ? logHash(s + 1, (hash ^ (uint8_t)*s) * LOG_HASH_PRIME) : hash;
+}
+
+constexpr uint16_t logId(const char* format)
+{
+    return (uint16_t)(logHash(format) ^ (logHash(format) >> 16));
+}
+
+/* integral_constant forces the hash to be evaluated by the compiler */
+#define LOG_ID(format)      (std::integral_constant<uint16_t, logId(format)>::value)
+
+/* Binary log datagram, remote records packed back to back.
+
+   Offset  Size  Field
+   0       1     LOG_WIRE_MAGIC
+   1       1     LOG_WIRE_VERSION
+   2       1     Door ID
+   3       1     Record count
+
+   Each record:
+   0       2     Format ID, little-endian
+   2       4     Timestamp in ms, little-endian
+   6       1     Module (bits 7-6), level (5-4), argument count (3-0)
+   7       ...   Arguments, zigzag varints of 1 to 5 bytes           */
+#define LOG_WIRE_MAGIC          0xD2
+#define LOG_WIRE_VERSION        1
+#define LOG_WIRE_HEADER_LENGTH  4
+#define LOG_WIRE_RECORD_MAX     (7 + LOG_MAX_ARGS * 5)
+
+/* Levels known at compile time fold the whole call, arguments
+   included, away. Arguments must be integers, formats literals. */
+#define LOG(module, level, flags, format, ...)                                      \
+    do{                                                                             \
+        if((level) <= LOG_LEVEL_##module)                                           \
+            logger.write(LOG_MODULE_##module, level, flags,                         \
+                         LOG_ID(format), format, ##__VA_ARGS__);                    \
+    }while(0)
+
+#define logError(module, ...)   LOG(module, LOG_LEVEL_ERROR, 0, __VA_ARGS__)
+#define logInfo(module, ...)    LOG(module, LOG_LEVEL_INFO,  0, __VA_ARGS__)
+#define logDebug(module, ...)   LOG(module, LOG_LEVEL_DEBUG, 0, __VA_ARGS__)
+#define logRemote(module, ...)  LOG(module, LOG_LEVEL_DEBUG, LOG_FLAG_REMOTE, __VA_ARGS__)
+
+/* Binary record, the format string is only referenced, never copied */
+struct LogRecord{
+    const char* format;     // Null once decoded, looked up by id instead
+    uint16_t    id;
+    uint32_t    timestamp;
+    int32_t     args[LOG_MAX_ARGS];
+    uint8_t     module;
+    uint8_t     level;
+    uint8_t     flags;
+    uint8_t     argCount;
+};
+
+/* Hot path writes a fixed size record into a lock-free ring, a low
+   priority task later drains the rings in batches through the sink.
+   A ring has a single writer: each task that logs often attach()es to
+   a ring of its own. Every other task, setup() included, shares
+   LOG_SHARED_RING, and its pushes are serialised by a lock. Tasks on
+   one core preempt each other, so a ring per core is not enough.   */
+class Logger{
+
+    public:
+
+        typedef unsigned long (*Clock)();
+        typedef void          (*Sink)(const LogRecord& record);
+        typedef void          (*Flush)();
+
+        Logger();
+
+        void     begin(Clock clock, Sink sink, Flush flush);
+
+        /* The calling task becomes the only writer of 'ring', which
+           must be below LOG_SHARED_RING and used by no other task.
+           Never from an ISR, nothing may log from one.             */
+        void     attach(uint8_t ring);
+
+        template <typename... Args>
+        void     write(uint8_t module, uint8_t level, uint8_t flags, uint16_t id, const char* format, Args... args)
+        {
+            static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+
+            /* Leading 0 keeps the array legal when there are no arguments */
+            const int32_t values[] = {0, toArgument(args)...};
+
+            LogRecord record;
+            record.format   = format;
+            record.id       = id;
+            record.module   = module;
+            record.level    = level;
+            record.flags    = flags;
+            record.argCount = sizeof...(Args);
+            for(uint8_t i = 0; i < LOG_MAX_ARGS; i++)
+                record.args[i] = i < record.argCount ? values[i + 1] : 0;
+            push(record);
+        }
+
+        /* Consumer side, one task only, returns the number of records handled */
+        uint16_t drain(uint16_t max);
+        uint32_t dropped()      {return __atomic_load_n(&m_dropped, __ATOMIC_RELAXED);}
+
+        /* Renders a record as text, returns the length written */
+        static uint16_t format(const LogRecord& record, char* buffer, uint16_t size);
+
+        /* Wire form of a single record, see LOG_WIRE_MAGIC. Both return
+           the bytes used, 0 if the record doesn't fit or is malformed. */
+        static uint8_t  encode(const LogRecord& record, uint8_t* buffer, uint16_t size);
+        static uint8_t  decode(const uint8_t* buffer, uint16_t len, LogRecord& record);
+
+    private:
+
+        SpscQueue<LogRecord, LOG_RING_SIZE> m_rings[LOG_PRODUCERS];
+        Clock    m_clock;
+        Sink     m_sink;
+        Flush    m_flush;
+        uint32_t m_dropped;     // Any producer, updated atomically
+
+        static thread_local int8_t s_ring;  // The calling task's ring, -1 shared
+
+        void     push(LogRecord& record);
+
+        /* Integers only, a pointer would be meaningless once deferred */
+        template <typename T>
+        static int32_t toArgument(T value)
+        {
+            static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                          "Log arguments must be integers");
+            return (int32_t)value;
+        }
+
+};
+
+extern Logger logger;
+
+#endif
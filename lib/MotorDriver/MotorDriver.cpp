@@ -0,0 +1,46 @@
+#include <MotorDriver.h>
+
+/* Nothing touches the LEDC until the first drive(), the door is
+   usually a global and constructed before the core is up.      */
+MotorDriver::MotorDriver(uint8_t pin1, uint8_t pin2, uint8_t channel)
+: m_pin1(pin1),
+  m_pin2(pin2),
+  m_channel(channel),
+  m_duty(0),
+  m_started(false)
+{
+}
+
+void MotorDriver::start()
+{
+    ledcSetup(m_channel,     MOTOR_PWM_FREQUENCY, MOTOR_PWM_BITS);
+    ledcSetup(m_channel + 1, MOTOR_PWM_FREQUENCY, MOTOR_PWM_BITS);
+    ledcWrite(m_channel,     0);
+    ledcWrite(m_channel + 1, 0);
+    ledcAttachPin(m_pin1, m_channel);
+    ledcAttachPin(m_pin2, m_channel + 1);
+    m_started = true;
+}
+
+void MotorDriver::drive(int16_t duty)
+{
+    if(duty >  MOTOR_DUTY_MAX) duty =  MOTOR_DUTY_MAX;
+    if(duty < -MOTOR_DUTY_MAX) duty = -MOTOR_DUTY_MAX;
+
+    if(!m_started) start();
+    if(duty == m_duty) return;
+
+    /* Release the side that's going off first, so a reversal never
+       has both halves of the bridge driven at once.               */
+    if(duty > 0)
+    {
+        ledcWrite(m_channel + 1, 0);
+        ledcWrite(m_channel,     duty);
+    }
+    else
+    {
+        ledcWrite(m_channel,     0);
+        ledcWrite(m_channel + 1, -duty);
+    }
+    m_duty = duty;
+}
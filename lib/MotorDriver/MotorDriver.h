@@ -0,0 +1,38 @@
+#ifndef MOTOR_DRIVER
+#define MOTOR_DRIVER 1
+
+#include <Arduino.h>
+
+#define MOTOR_PWM_FREQUENCY 20000   // Hz, above hearing so the motor doesn't whine
+#define MOTOR_PWM_BITS      10
+#define MOTOR_DUTY_MAX      ((1 << MOTOR_PWM_BITS) - 1)
+#define MOTOR_PWM_CHANNEL   0       // First of the two LEDC channels used
+
+/* H-bridge on two pins, each on its own LEDC channel. One side is
+   driven with the duty and the other held low, so positive duty
+   turns the way digitalWrite(pin1, HIGH) did (opening the door).
+   Zero on both is what stopMotor() always did.                   */
+class MotorDriver{
+
+    public:
+
+        MotorDriver(uint8_t pin1, uint8_t pin2, uint8_t channel = MOTOR_PWM_CHANNEL);
+
+        /* -MOTOR_DUTY_MAX to MOTOR_DUTY_MAX, clamped */
+        void    drive(int16_t duty);
+        void    stop()          {drive(0);}
+        int16_t duty() const    {return m_duty;}
+
+    private:
+
+        uint8_t m_pin1;
+        uint8_t m_pin2;
+        uint8_t m_channel;
+        int16_t m_duty;
+        bool    m_started;
+
+        void    start();
+
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <MotorProfile.h>
+
+MotorProfile::MotorProfile()
+: m_sign(1),
+  m_distance(0),
+  m_speed(0),
+  m_accelTime(0),
+  m_cruiseTime(0),
+  m_decelTime(0),
+  m_shape(PROFILE_TRAPEZOID)
+{
+}
+
+uint32_t MotorProfile::plan(int32_t distance, uint32_t travelTime, uint32_t accelTime, uint32_t decelTime,
+                            float maxSpeed, uint8_t shape)
+{
+    m_sign     = distance < 0 ? -1 : 1;
+    m_distance = distance < 0 ? -(float)distance : (float)distance;
+    m_shape    = shape;
+
+    if(m_distance == 0 || travelTime == 0 || maxSpeed <= 0)
+    {
+        m_speed = 0;
+        m_accelTime = m_cruiseTime = m_decelTime = 0;
+        return 0;
+    }
+
+    /* Ramps longer than the move become a triangle, same proportions */
+    if(accelTime + decelTime > travelTime)
+    {
+        uint32_t ramps = accelTime + decelTime;
+        accelTime = (uint64_t)travelTime * accelTime / ramps;
+        decelTime = travelTime - accelTime;
+    }
+
+    /* Both ramp shapes cover half the distance a cruise of the same
+       length would, whatever is left is covered at cruise speed.   */
+    float cruising = (travelTime - (accelTime + decelTime) / 2.0f) / 1000.0f;
+    m_speed = m_distance / cruising;
+
+    if(m_speed > maxSpeed)
+    {
+        m_speed    = maxSpeed;
+        travelTime = (uint32_t)(m_distance / m_speed * 1000.0f + (accelTime + decelTime) / 2.0f + 0.5f);
+    }
+
+    m_accelTime  = accelTime;
+    m_decelTime  = decelTime;
+    m_cruiseTime = travelTime - accelTime - decelTime;
+    return duration();
+}
+
+ProfilePoint MotorProfile::at(uint32_t elapsed) const
+{
+    ProfilePoint point;
+    uint32_t     decelStart = m_accelTime + m_cruiseTime;
+
+    if(elapsed < m_accelTime)
+    {
+        float x = (float)elapsed / m_accelTime;
+        point.velocity = m_speed * rampSpeed(x);
+        point.position = m_speed * m_accelTime / 1000.0f * rampArea(x);
+    }
+    else if(elapsed < decelStart)
+    {
+        point.velocity = m_speed;
+        point.position = m_speed * (m_accelTime / 2.0f + (elapsed - m_accelTime)) / 1000.0f;
+    }
+    else if(elapsed < decelStart + m_decelTime)
+    {
+        /* The accelerating ramp run backwards from the far end */
+        float x = (float)(decelStart + m_decelTime - elapsed) / m_decelTime;
+        point.velocity = m_speed * rampSpeed(x);
+        point.position = m_distance - m_speed * m_decelTime / 1000.0f * rampArea(x);
+    }
+    else
+    {
+        point.velocity = 0;
+        point.position = m_distance;
+    }
+
+    point.velocity *= m_sign;
+    point.position *= m_sign;
+    return point;
+}
+
+float MotorProfile::rampSpeed(float x) const
+{
+    if(m_shape == PROFILE_SCURVE) return x * x * (3 - 2 * x);
+    return x;
+}
+
+float MotorProfile::rampArea(float x) const
+{
+    if(m_shape == PROFILE_SCURVE) return x * x * x * (1 - x / 2);
+    return x * x / 2;
+}
@@ -0,0 +1,57 @@
+#ifndef MOTOR_PROFILE
+#define MOTOR_PROFILE 1
+
+#include <stdint.h> // Precise type allocation
+
+/* Ramp shapes */
+#define PROFILE_TRAPEZOID   0   // Constant acceleration, a step in jerk at each corner
+#define PROFILE_SCURVE      1   // Smoothstep ramps, acceleration rises and falls gently
+
+/* Where the door should be, and how fast it should be going, at
+   some time into a move. Encoder counts and counts per second.  */
+struct ProfilePoint{
+    float position;     // From the start of the move
+    float velocity;
+};
+
+/* Speed profile for one move: ramp up, cruise, ramp down. Planned
+   once from the distance and the time the move should take, then
+   sampled as the move goes. No hardware, so it runs as is on the
+   host against the motor model in tools/host.                    */
+class MotorProfile{
+
+    public:
+
+        MotorProfile();
+
+        /* Plans 'distance' counts (signed) in 'travelTime' ms, ramps
+           shortened in proportion if they don't fit and the cruise
+           stretched if it would need more than 'maxSpeed'. Returns
+           the planned duration in ms.                              */
+        uint32_t plan(int32_t distance, uint32_t travelTime, uint32_t accelTime, uint32_t decelTime,
+                      float maxSpeed, uint8_t shape);
+
+        /* Setpoint 'elapsed' ms into the move, held at the end */
+        ProfilePoint at(uint32_t elapsed) const;
+
+        uint32_t duration() const       {return m_accelTime + m_cruiseTime + m_decelTime;}
+        float    cruiseSpeed() const    {return m_sign * m_speed;}
+
+    private:
+
+        float    m_sign;
+        float    m_distance;    // Counts, always positive
+        float    m_speed;       // Cruise, counts per second
+        uint32_t m_accelTime;   // ms
+        uint32_t m_cruiseTime;
+        uint32_t m_decelTime;
+        uint8_t  m_shape;
+
+        /* Fraction of cruise speed x of the way up a ramp, and the
+           distance covered by then in units of cruise speed * ramp */
+        float    rampSpeed(float x) const;
+        float    rampArea(float x) const;
+
+};
+
+#endif
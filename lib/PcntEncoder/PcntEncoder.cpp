@@ -0,0 +1,135 @@
+#include "PcntEncoder.h"
+#include <esp_intr_alloc.h>
+#include <soc/pcnt_struct.h>
+
+/* ISR service is shared by all units, installed once */
+static bool serviceInstalled = false;
+
+/* Holds limitReached() off whilst the count and overflow are paired */
+static portMUX_TYPE limitLock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Configuration is deferred to the first read()/write(), DoorHandler is
+   a global so this constructor runs before the IDF drivers are up.  */
+PcntEncoder::PcntEncoder(uint8_t pin1, uint8_t pin2, pcnt_unit_t unit)
+: m_unit(unit),
+  m_pin1(pin1),
+  m_pin2(pin2),
+  m_overflow(0),
+  m_started(false),
+  m_lastPosition(0)
+{
+}
+
+void PcntEncoder::start()
+{
+    pcnt_config_t config;
+
+    /* Channel 0 counts pin1 edges, pin2 gives the direction */
+    config.pulse_gpio_num = m_pin1;
+    config.ctrl_gpio_num  = m_pin2;
+    config.channel        = PCNT_CHANNEL_0;
+    config.unit           = m_unit;
+    config.pos_mode       = PCNT_COUNT_INC;
+    config.neg_mode       = PCNT_COUNT_DEC;
+    config.lctrl_mode     = PCNT_MODE_REVERSE;
+    config.hctrl_mode     = PCNT_MODE_KEEP;
+    config.counter_h_lim  = PCNT_ENCODER_LIMIT;
+    config.counter_l_lim  = -PCNT_ENCODER_LIMIT;
+    pcnt_unit_config(&config);
+
+    /* Channel 1 the other way round, so all four edges count */
+    config.pulse_gpio_num = m_pin2;
+    config.ctrl_gpio_num  = m_pin1;
+    config.channel        = PCNT_CHANNEL_1;
+    config.pos_mode       = PCNT_COUNT_DEC;
+    config.neg_mode       = PCNT_COUNT_INC;
+    pcnt_unit_config(&config);
+
+    pcnt_set_filter_value(m_unit, PCNT_ENCODER_FILTER);
+    pcnt_filter_enable(m_unit);
+
+    pcnt_event_enable(m_unit, PCNT_EVT_H_LIM);
+    pcnt_event_enable(m_unit, PCNT_EVT_L_LIM);
+
+    if(!serviceInstalled)
+    {
+        pcnt_isr_service_install(ESP_INTR_FLAG_IRAM);
+        serviceInstalled = true;
+    }
+    pcnt_isr_handler_add(m_unit, limitReached, this);
+    m_started = true;
+}
+
+/* The counter resets to 0 in hardware as it hits a limit, this only
+   has to carry the limit over. Installed with ESP_INTR_FLAG_IRAM so it
+   still runs whilst an EEPROM commit has the flash cache off, which is
+   why it reads the latched events from the register, not the driver. */
+void IRAM_ATTR PcntEncoder::limitReached(void* arg)
+{
+    PcntEncoder* encoder = static_cast<PcntEncoder*>(arg);
+
+    uint32_t status = PCNT.status_unit[encoder->m_unit].val;
+    portENTER_CRITICAL_ISR(&limitLock);
+    if(status & PCNT_EVT_H_LIM) encoder->m_overflow += PCNT_ENCODER_LIMIT;
+    if(status & PCNT_EVT_L_LIM) encoder->m_overflow -= PCNT_ENCODER_LIMIT;
+    portEXIT_CRITICAL_ISR(&limitLock);
+}
+
+/* Inside limitLock only. A limit the counter has already reset at
+   whose interrupt is still held off, as the counts it will carry.  */
+int32_t PcntEncoder::carryPending()
+{
+    if(!(PCNT.int_raw.val & (1UL << m_unit))) return 0;
+
+    uint32_t status = PCNT.status_unit[m_unit].val;
+    if(status & PCNT_EVT_H_LIM) return PCNT_ENCODER_LIMIT;
+    if(status & PCNT_EVT_L_LIM) return -PCNT_ENCODER_LIMIT;
+    return 0;
+}
+
+int32_t PcntEncoder::read()
+{
+    if(!m_started) write(0);
+
+    /* limitReached() can't run on this core inside the section, so a
+       reset not yet carried shows as a raised interrupt. The counter
+       keeps counting meanwhile, the count is only taken between two
+       looks at the interrupt that agree.                           */
+    int32_t carry;
+    int16_t count;
+    portENTER_CRITICAL(&limitLock);
+    do
+    {
+        carry = carryPending();
+        pcnt_get_counter_value(m_unit, &count);
+    }
+    while(carry != carryPending());
+    int32_t position = m_overflow + carry + count;
+    portEXIT_CRITICAL(&limitLock);
+    return position;
+}
+
+int32_t PcntEncoder::sample()
+{
+    int32_t position = read();
+    if(position != m_lastPosition)
+    {
+        m_samples.record(micros(), position);
+        m_lastPosition = position;
+    }
+    return position;
+}
+
+void PcntEncoder::write(int32_t position)
+{
+    if(!m_started) start();
+
+    /* A carry still pending lands after this, so it is taken off now */
+    portENTER_CRITICAL(&limitLock);
+    pcnt_counter_pause(m_unit);
+    pcnt_counter_clear(m_unit);
+    m_overflow     = position - carryPending();
+    m_lastPosition = position;
+    pcnt_counter_resume(m_unit);
+    portEXIT_CRITICAL(&limitLock);
+}
@@ -0,0 +1,53 @@
+#ifndef PCNT_ENCODER
+#define PCNT_ENCODER 1
+
+#include <Arduino.h>
+#include <driver/pcnt.h>
+#include <EncoderSamples.h>
+
+#define PCNT_ENCODER_LIMIT  16384   // Counter is 16-bit, folded into m_overflow at +/- this
+#define PCNT_ENCODER_FILTER 250     // APB cycles at 80MHz, pulses under ~3us are glitches
+
+/* Quadrature decoding on the ESP32 pulse counter, a drop in for
+   Encoder (lib/Encoder) without an interrupt per edge. Both channels
+   of one unit count, so it is 4x decoding with the same sign as the
+   Encoder library. The hardware counter is 16-bit, an interrupt at
+   each limit extends it to 32. The interrupt is installed by the
+   first read()/write() and must be on the core that reads.          */
+class PcntEncoder{
+
+    public:
+
+        PcntEncoder(uint8_t pin1, uint8_t pin2, pcnt_unit_t unit = PCNT_UNIT_0);
+
+        /* read() from any task on the interrupt's core. sample() is
+           read() that also records the count when it has moved, the
+           samples have a single writer so one task only samples.   */
+        int32_t  read();
+        int32_t  sample();
+        void     write(int32_t position);
+
+        /* As Encoder's, but there is no interrupt per edge so samples
+           are taken by sample() whenever the count has moved. Stall
+           detection is only as fine as samples are frequent.        */
+        int32_t  velocity()      {return m_samples.velocity();}
+        int32_t  acceleration()  {return m_samples.acceleration();}
+        uint32_t sinceLastEdge() {return m_samples.sinceLastEdge(micros());}
+
+    private:
+
+        pcnt_unit_t      m_unit;
+        uint8_t          m_pin1;
+        uint8_t          m_pin2;
+        volatile int32_t m_overflow;    // Counts folded in from the hardware counter
+        bool             m_started;
+        int32_t          m_lastPosition;  // Last sampled, sample() and write() only
+        EncoderSamples   m_samples;
+
+        void    start();
+        int32_t carryPending();
+        static void IRAM_ATTR limitReached(void* arg);
+
+};
+
+#endif
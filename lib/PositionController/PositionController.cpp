@@ -0,0 +1,29 @@
+#include <PositionController.h>
+
+PositionController::PositionController(float period, float limit)
+: m_period(period),
+  m_limit(limit),
+  m_integral(0),
+  m_feedforward(1)
+{
+    m_gains.kp  = 0;
+    m_gains.ki  = 0;
+    m_gains.kd  = 0;
+    m_gains.kff = 0;
+}
+
+float PositionController::step(float setpoint, float velocity, float position, float measured)
+{
+    float error  = setpoint - position;
+    float output = m_gains.kff * m_feedforward * velocity + m_gains.kp * error + m_gains.kd * (velocity - measured);
+
+    /* Only integrate if it doesn't push further into the limit */
+    float integral = m_integral + error * m_period;
+    float total    = output + m_gains.ki * integral;
+    if((total < m_limit || error < 0) && (total > -m_limit || error > 0)) m_integral = integral;
+
+    total = output + m_gains.ki * m_integral;
+    if(total >  m_limit) return  m_limit;
+    if(total < -m_limit) return -m_limit;
+    return total;
+}
@@ -0,0 +1,48 @@
+#ifndef POSITION_CONTROLLER
+#define POSITION_CONTROLLER 1
+
+#include <stdint.h> // Precise type allocation
+
+/* Output is in motor duty, encoder counts in and counts per second */
+struct PositionGains{
+    float kp;   // Duty per count behind the setpoint
+    float ki;   // Duty per count second of error built up
+    float kd;   // Duty per count/s slower than the setpoint
+    float kff;  // Duty per count/s of planned speed
+};
+
+/* PID on encoder counts with velocity feedforward, stepped at a fixed
+   period. The derivative is taken on the velocity error rather than
+   differencing positions: the planned speed is known exactly and the
+   encoder's own estimate is far less noisy than counts per step.
+   The integral stops growing whilst the output is pinned at the
+   limit, so a door held back doesn't wind it up.                   */
+class PositionController{
+
+    public:
+
+        PositionController(float period, float limit);
+
+        void  setGains(const PositionGains& gains)  {m_gains = gains;}
+        const PositionGains& gains() const          {return m_gains;}
+
+        void  reset()                               {m_integral = 0;}
+
+        /* Feedforward for a motor slower (above 1) or faster than the
+           one kff was tuned on, without touching the gains themselves */
+        void  setFeedforwardScale(float scale)      {m_feedforward = scale;}
+
+        /* Duty for one period, clamped to +/- limit */
+        float step(float setpoint, float velocity, float position, float measured);
+
+    private:
+
+        PositionGains m_gains;
+        float         m_period;     // Seconds
+        float         m_limit;
+        float         m_integral;   // Count seconds
+        float         m_feedforward;
+
+};
+
+#endif
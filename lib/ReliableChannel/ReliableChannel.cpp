@@ -0,0 +1,128 @@
+#include <ReliableChannel.h>
+#include <string.h>
+
+/* Wrap safe, millis() overflows every ~49 days */
+static bool isDue(uint32_t deadline, uint32_t now)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+ReliableSender::ReliableSender(Transmit transmit)
+: m_transmit(transmit),
+  m_head(0),
+  m_count(0),
+  m_sequence(0),
+  m_epoch(0)
+{
+}
+
+void ReliableSender::begin(uint16_t epoch)
+{
+    m_epoch = epoch ? epoch : 1;
+}
+
+uint16_t ReliableSender::send(const char* payload, uint8_t length, uint32_t now)
+{
+    if(m_count == RELIABLE_WINDOW) dropOldest();
+
+    Slot& slot = m_slots[(m_head + m_count) & (RELIABLE_WINDOW - 1)];
+    m_count++;
+
+    slot.sequence = m_sequence++;
+    slot.length   = length < RELIABLE_PAYLOAD ? length : RELIABLE_PAYLOAD;
+    slot.attempts = 1;
+    slot.timeout  = RELIABLE_BASE_TIMEOUT;
+    slot.deadline = now + slot.timeout;
+    memcpy(slot.payload, payload, slot.length);
+
+    m_transmit(m_epoch, slot.sequence, slot.payload, slot.length);
+    return slot.sequence;
+}
+
+void ReliableSender::acknowledge(uint16_t sequence, uint16_t epoch)
+{
+    /* A late ACK for the last boot's event of the same number */
+    if(epoch != m_epoch) return;
+    acknowledge(sequence);
+}
+
+void ReliableSender::acknowledge(uint16_t sequence)
+{
+    for(uint8_t i = 0; i < m_count; i++)
+    {
+        Slot& slot = m_slots[(m_head + i) & (RELIABLE_WINDOW - 1)];
+        if(slot.sequence == sequence) slot.attempts = 0; // Marks it done
+    }
+
+    /* Release everything acknowledged at the front of the window */
+    while(m_count > 0 && m_slots[m_head].attempts == 0) dropOldest();
+}
+
+void ReliableSender::poll(uint32_t now)
+{
+    for(uint8_t i = 0; i < m_count; i++)
+    {
+        Slot& slot = m_slots[(m_head + i) & (RELIABLE_WINDOW - 1)];
+        if(slot.attempts == 0 || !isDue(slot.deadline, now)) continue;
+
+        if(slot.attempts >= RELIABLE_MAX_ATTEMPTS)
+        {
+            /* Collector is gone, the next heartbeat carries the state anyway */
+            slot.attempts = 0;
+            continue;
+        }
+
+        slot.attempts++;
+        slot.timeout  = slot.timeout * 2 < RELIABLE_MAX_TIMEOUT ? slot.timeout * 2 : RELIABLE_MAX_TIMEOUT;
+        slot.deadline = now + slot.timeout;
+        m_transmit(m_epoch, slot.sequence, slot.payload, slot.length);
+    }
+
+    while(m_count > 0 && m_slots[m_head].attempts == 0) dropOldest();
+}
+
+void ReliableSender::dropOldest()
+{
+    m_head = (m_head + 1) & (RELIABLE_WINDOW - 1);
+    m_count--;
+}
+
+bool ReliableReceiver::accept(uint16_t sequence, uint16_t epoch)
+{
+    /* First event, or the first since the door restarted */
+    if(!m_started || epoch != m_epoch)
+    {
+        m_started = true;
+        m_epoch   = epoch;
+        m_highest = sequence;
+        m_seen    = 1;
+        return true;
+    }
+
+    int16_t ahead = (int16_t)(sequence - m_highest);
+    if(ahead > 0)
+    {
+        /* New highest, slide the window along */
+        m_seen    = ahead >= 32 ? 0 : m_seen << ahead;
+        m_seen   |= 1;
+        m_highest = sequence;
+        return true;
+    }
+
+    /* The sender never has more than RELIABLE_WINDOW outstanding, so
+       anything this far back is a restarted door counting from 0 again,
+       or with an epoch a stale retransmit that was accepted long ago  */
+    uint16_t behind = -ahead;
+    if(behind >= 32)
+    {
+        if(epoch) return false;
+        m_highest = sequence;
+        m_seen    = 1;
+        return true;
+    }
+
+    uint32_t bit = (uint32_t)1 << behind;
+    if(m_seen & bit) return false;
+    m_seen |= bit;
+    return true;
+}
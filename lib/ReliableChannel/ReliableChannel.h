@@ -0,0 +1,94 @@
+#ifndef RELIABLE_CHANNEL
+#define RELIABLE_CHANNEL 1
+
+#include <stdint.h> // Precise type allocation
+
+/* Small reliability layer for events that must not be lost over UDP,
+   e.g. "DM:1". Every event carries a 16-bit sequence number and is
+   retransmitted with exponential backoff until the collector ACKs it.
+
+   Sequence numbers start from 0 every boot, so each event also
+   carries the boot's epoch, a random non-zero number picked at
+   start up. A receiver seeing a new epoch knows the door restarted.
+
+   Wire format, device -> collector: "(ID:n)-E<seq>,<epoch>:<payload>"
+                collector -> device: "A<seq>,<epoch>"
+   Epoch 0 is a door from before epochs, "E<seq>:" and "A<seq>".     */
+
+#define RELIABLE_WINDOW         8       // Unacknowledged events held, power of two
+#define RELIABLE_PAYLOAD        64
+#define RELIABLE_BASE_TIMEOUT   500     // ms before the first retransmit
+#define RELIABLE_MAX_TIMEOUT    16000   // ms, backoff stops doubling here
+#define RELIABLE_MAX_ATTEMPTS   10      // Gives up on an event after this many sends
+
+/* Device side. Time is passed in so it runs against any clock. */
+class ReliableSender{
+
+    public:
+
+        typedef bool (*Transmit)(uint16_t epoch, uint16_t sequence, const char* payload, uint8_t length);
+
+        ReliableSender(Transmit transmit);
+
+        /* This boot's epoch, before the first send. 0 is taken as 1. */
+        void     begin(uint16_t epoch);
+        uint16_t epoch()            {return m_epoch;}
+
+        /* Sends straight away and holds the event for retransmit. When the
+           window is full the oldest unacknowledged event is dropped.     */
+        uint16_t send(const char* payload, uint8_t length, uint32_t now);
+        /* ACKs for another boot's epoch are ignored, one without an
+           epoch is from a collector that predates them            */
+        void     acknowledge(uint16_t sequence, uint16_t epoch);
+        void     acknowledge(uint16_t sequence);
+
+        /* Retransmits anything overdue */
+        void     poll(uint32_t now);
+        uint8_t  pending()          {return m_count;}
+
+    private:
+
+        struct Slot{
+            uint16_t sequence;
+            uint8_t  length;
+            uint8_t  attempts;
+            uint32_t timeout;
+            uint32_t deadline;
+            char     payload[RELIABLE_PAYLOAD];
+        };
+
+        Transmit m_transmit;
+        Slot     m_slots[RELIABLE_WINDOW];
+        uint8_t  m_head;        // Oldest unacknowledged
+        uint8_t  m_count;
+        uint16_t m_sequence;    // Next to be assigned
+        uint16_t m_epoch;
+
+        void     dropOldest();
+
+};
+
+/* Collector side duplicate suppression, remembers the 32 sequence
+   numbers up to the highest seen in the door's current epoch. A new
+   epoch means the door restarted, and the window starts again from
+   there. Without an epoch, anything 32 or more behind is taken as a
+   restart instead.                                                */
+class ReliableReceiver{
+
+    public:
+
+        ReliableReceiver() : m_highest(0), m_seen(0), m_epoch(0), m_started(false) {}
+
+        /* True the first time a sequence is seen, false for duplicates */
+        bool accept(uint16_t sequence, uint16_t epoch = 0);
+
+    private:
+
+        uint16_t m_highest;
+        uint32_t m_seen;        // Bit n set = m_highest - n already accepted
+        uint16_t m_epoch;
+        bool     m_started;
+
+};
+
+#endif
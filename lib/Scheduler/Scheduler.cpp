@@ -0,0 +1,92 @@
+#include <Scheduler.h>
+
+/* Upper bound on a single sleep, keeps the loop responsive
+   if every job happens to be disarmed.                     */
+#define MAX_IDLE_SLEEP  1000
+
+Scheduler::Scheduler(Clock clock)
+: m_clock(clock),
+  m_count(0)
+{
+}
+
+int8_t Scheduler::add(Job job, uint32_t period, uint32_t firstDelay, bool armed)
+{
+    if(m_count >= SCHEDULER_MAX_JOBS || job == 0) return SCHEDULER_NO_JOB;
+
+    Entry& e   = m_jobs[m_count];
+    e.job      = job;
+    e.period   = period;
+    e.deadline = m_clock() + firstDelay;
+    e.armed    = armed;
+
+    return m_count++;
+}
+
+void Scheduler::arm(int8_t id, uint32_t delay)
+{
+    if(!validId(id)) return;
+    m_jobs[id].deadline = m_clock() + delay;
+    m_jobs[id].armed    = true;
+}
+
+void Scheduler::disarm(int8_t id)
+{
+    if(validId(id)) m_jobs[id].armed = false;
+}
+
+bool Scheduler::isArmed(int8_t id)
+{
+    return validId(id) && m_jobs[id].armed;
+}
+
+uint32_t Scheduler::run()
+{
+    for(uint8_t i = 0; i < m_count; i++)
+    {
+        Entry& e = m_jobs[i];
+        if(!e.armed || !isDue(e.deadline, m_clock())) continue;
+
+        if(e.period == 0)
+        {
+            /* One-shot, disarm before running so the job may re-arm itself */
+            e.armed = false;
+        }
+        else
+        {
+            /* Advance on the absolute grid so jitter never accumulates,
+               unless we've fallen a whole period behind - then resync. */
+            e.deadline += e.period;
+            if(isDue(e.deadline, m_clock())) e.deadline = m_clock() + e.period;
+        }
+        e.job();
+    }
+    return timeUntilNext();
+}
+
+uint32_t Scheduler::timeUntil(int8_t id)
+{
+    if(!isArmed(id)) return 0;
+
+    uint32_t time = m_clock();
+    if(isDue(m_jobs[id].deadline, time)) return 0;
+    return m_jobs[id].deadline - time;
+}
+
+uint32_t Scheduler::timeUntilNext()
+{
+    uint32_t next = MAX_IDLE_SLEEP;
+    for(uint8_t i = 0; i < m_count; i++)
+    {
+        if(!m_jobs[i].armed) continue;
+        uint32_t remaining = timeUntil(i);
+        if(remaining < next) next = remaining;
+    }
+    return next;
+}
+
+/* Wrap safe comparison, millis() overflows every ~49 days */
+bool Scheduler::isDue(uint32_t deadline, uint32_t time)
+{
+    return (int32_t)(time - deadline) >= 0;
+}
@@ -0,0 +1,53 @@
+#ifndef SCHEDULER
+#define SCHEDULER 1
+
+#include <stdint.h> // Precise type allocation
+
+#define SCHEDULER_MAX_JOBS  8
+#define SCHEDULER_NO_JOB    -1
+
+/* Deadline driven job table. Each job owns an absolute deadline
+   on the supplied clock, the caller sleeps until the earliest one. */
+class Scheduler{
+
+    public:
+
+        typedef void          (*Job)();
+        typedef unsigned long (*Clock)();
+
+        Scheduler(Clock clock);
+
+        /* Registers a job, period of 0 makes it a one-shot that is
+           disarmed after running. Returns the job id or SCHEDULER_NO_JOB */
+        int8_t   add(Job job, uint32_t period, uint32_t firstDelay, bool armed = true);
+
+        /* Arms (or re-arms) a job to fire 'delay' ms from now */
+        void     arm(int8_t id, uint32_t delay);
+        void     disarm(int8_t id);
+        bool     isArmed(int8_t id);
+
+        /* Runs every job that is due, returns ms until the next deadline */
+        uint32_t run();
+        uint32_t timeUntil(int8_t id);
+        uint32_t timeUntilNext();
+        uint32_t now()                  {return m_clock();}
+
+    private:
+
+        struct Entry{
+            Job      job;
+            uint32_t period;
+            uint32_t deadline;
+            bool     armed;
+        };
+
+        Clock   m_clock;
+        Entry   m_jobs[SCHEDULER_MAX_JOBS];
+        uint8_t m_count;
+
+        bool    isDue(uint32_t deadline, uint32_t time);
+        bool    validId(int8_t id) {return id >= 0 && id < m_count;}
+
+};
+
+#endif
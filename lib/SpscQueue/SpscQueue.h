@@ -0,0 +1,65 @@
+#ifndef SPSC_QUEUE
+#define SPSC_QUEUE 1
+
+#include <stdint.h> // Precise type allocation
+#include <atomic>   // Portable between the ESP32 and a host build
+
+/* Lock-free single producer, single consumer ring used to hand work
+   between tasks on different cores. Exactly one task may push and
+   exactly one task may pop. CAPACITY must be a power of two, one slot
+   is always left empty to tell a full ring from an empty one.        */
+template <typename T, uint16_t CAPACITY>
+class SpscQueue{
+
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+
+    public:
+
+        SpscQueue() : m_head(0), m_tail(0) {}
+
+        /* Producer side, false if the ring is full */
+        bool push(const T& item)
+        {
+            uint16_t head = m_head.load(std::memory_order_relaxed);
+            uint16_t next = (head + 1) & (CAPACITY - 1);
+
+            if(next == m_tail.load(std::memory_order_acquire)) return false;
+
+            m_items[head] = item;
+            m_head.store(next, std::memory_order_release);
+            return true;
+        }
+
+        /* Consumer side, false if the ring is empty */
+        bool pop(T& item)
+        {
+            uint16_t tail = m_tail.load(std::memory_order_relaxed);
+
+            if(tail == m_head.load(std::memory_order_acquire)) return false;
+
+            item = m_items[tail];
+            m_tail.store((tail + 1) & (CAPACITY - 1), std::memory_order_release);
+            return true;
+        }
+
+        bool empty()
+        {
+            return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+        }
+
+        bool full()
+        {
+            uint16_t next = (m_head.load(std::memory_order_acquire) + 1) & (CAPACITY - 1);
+            return next == m_tail.load(std::memory_order_acquire);
+        }
+
+    private:
+
+        T                     m_items[CAPACITY];
+        std::atomic<uint16_t> m_head;   // Only written by the producer
+        std::atomic<uint16_t> m_tail;   // Only written by the consumer
+
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include <Telemetry.h>
+#include <string.h>
+
+/* Explicit byte order, never memcpy a struct onto the wire */
+static void putU16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t v)
+{
+    putU16(p, v & 0xFFFF);
+    putU16(p + 2, v >> 16);
+}
+
+static uint16_t getU16(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t* p)
+{
+    return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+}
+
+size_t telemetryEncode(const TelemetryStatus& status, uint8_t* frame)
+{
+    frame[0]  = TELEMETRY_MAGIC;
+    frame[1]  = TELEMETRY_VERSION;
+    putU16(frame + 2, status.sequence);
+    frame[4]  = status.id;
+    frame[5]  = status.state;
+    frame[6]  = status.motionState;
+    frame[7]  = status.flags;
+    putU32(frame + 8,  (uint32_t)status.motorPosition);
+    putU32(frame + 12, (uint32_t)status.motorTopPosition);
+    frame[16] = status.lightUpperThreshold;
+    frame[17] = status.lightLowerThreshold;
+    frame[18] = status.currentLight;
+    frame[19] = status.motorMoveTime;
+    putU16(frame + 20, status.closingMinute);
+    putU16(frame + 22, status.openingMinute);
+    putU16(frame + 24, (uint16_t)status.minuteOffset);
+    putU32(frame + 26, status.uptime);
+    return TELEMETRY_FRAME_LENGTH;
+}
+
+bool telemetryDecode(const uint8_t* frame, size_t length, TelemetryStatus& status)
+{
+    if(length < TELEMETRY_FRAME_LENGTH)   return false;
+    if(frame[0] != TELEMETRY_MAGIC)       return false;
+    if(frame[1] != TELEMETRY_VERSION)     return false;
+
+    status.sequence            = getU16(frame + 2);
+    status.id                  = frame[4];
+    status.state               = frame[5];
+    status.motionState         = frame[6];
+    status.flags               = frame[7];
+    status.motorPosition       = (int32_t)getU32(frame + 8);
+    status.motorTopPosition    = (int32_t)getU32(frame + 12);
+    status.lightUpperThreshold = frame[16];
+    status.lightLowerThreshold = frame[17];
+    status.currentLight        = frame[18];
+    status.motorMoveTime       = frame[19];
+    status.closingMinute       = getU16(frame + 20);
+    status.openingMinute       = getU16(frame + 22);
+    status.minuteOffset        = (int16_t)getU16(frame + 24);
+    status.uptime              = getU32(frame + 26);
+    return true;
+}
+
+/* Where each TELEMETRY_FIELD_* lives in TelemetryStatus */
+struct TelemetryField{
+    uint8_t offset;
+    uint8_t size;
+};
+
+static const TelemetryField telemetryFields[TELEMETRY_FIELD_COUNT] = {
+    {offsetof(TelemetryStatus, id),                  1},
+    {offsetof(TelemetryStatus, state),               1},
+    {offsetof(TelemetryStatus, motionState),         1},
+    {offsetof(TelemetryStatus, flags),               1},
+    {offsetof(TelemetryStatus, motorPosition),       4},
+    {offsetof(TelemetryStatus, motorTopPosition),    4},
+    {offsetof(TelemetryStatus, lightUpperThreshold), 1},
+    {offsetof(TelemetryStatus, lightLowerThreshold), 1},
+    {offsetof(TelemetryStatus, currentLight),        1},
+    {offsetof(TelemetryStatus, motorMoveTime),       1},
+    {offsetof(TelemetryStatus, closingMinute),       2},
+    {offsetof(TelemetryStatus, openingMinute),       2},
+    {offsetof(TelemetryStatus, minuteOffset),        2},
+    {offsetof(TelemetryStatus, uptime),              4},
+};
+
+static uint32_t readField(const TelemetryStatus& status, uint8_t field)
+{
+    const uint8_t* p = (const uint8_t*)&status + telemetryFields[field].offset;
+    switch(telemetryFields[field].size)
+    {
+        case 1:  return *p;
+        case 2:  {uint16_t v; memcpy(&v, p, 2); return v;}
+        default: {uint32_t v; memcpy(&v, p, 4); return v;}
+    }
+}
+
+static void writeField(TelemetryStatus& status, uint8_t field, uint32_t value)
+{
+    uint8_t* p = (uint8_t*)&status + telemetryFields[field].offset;
+    switch(telemetryFields[field].size)
+    {
+        case 1:  *p = value; break;
+        case 2:  {uint16_t v = value; memcpy(p, &v, 2); break;}
+        default: memcpy(p, &value, 4); break;
+    }
+}
+
+TelemetryDeltaEncoder::TelemetryDeltaEncoder(uint8_t keyframeInterval)
+: m_interval(keyframeInterval),
+  m_sinceKeyframe(0),
+  m_keyframeDue(true)
+{
+}
+
+size_t TelemetryDeltaEncoder::encode(const TelemetryStatus& status, uint8_t* frame)
+{
+    if(m_keyframeDue || ++m_sinceKeyframe >= m_interval)
+    {
+        m_keyframe      = status;
+        m_keyframeDue   = false;
+        m_sinceKeyframe = 0;
+        return telemetryEncode(status, frame);
+    }
+
+    frame[0] = TELEMETRY_DELTA_MAGIC;
+    frame[1] = TELEMETRY_VERSION;
+    putU16(frame + 2, status.sequence);
+    putU16(frame + 4, m_keyframe.sequence);
+
+    uint16_t mask   = 0;
+    size_t   length = TELEMETRY_DELTA_HEADER;
+    for(uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        uint32_t value = readField(status, i);
+        if(value == readField(m_keyframe, i)) continue;
+
+        mask |= 1 << i;
+        for(uint8_t b = 0; b < telemetryFields[i].size; b++)
+            frame[length++] = value >> (8 * b);
+    }
+    putU16(frame + 6, mask);
+    return length;
+}
+
+bool TelemetryReconstructor::apply(const uint8_t* frame, size_t length)
+{
+    if(length >= 1 && frame[0] == TELEMETRY_MAGIC)
+    {
+        if(!telemetryDecode(frame, length, m_keyframe)) return false;
+        m_status       = m_keyframe;
+        m_haveKeyframe = true;
+        return true;
+    }
+
+    if(length < TELEMETRY_DELTA_HEADER)           return false;
+    if(frame[0] != TELEMETRY_DELTA_MAGIC)         return false;
+    if(frame[1] != TELEMETRY_VERSION)             return false;
+
+    /* Relative to a keyframe we never saw */
+    if(!m_haveKeyframe || getU16(frame + 4) != m_keyframe.sequence) return false;
+
+    TelemetryStatus status = m_keyframe;
+    uint16_t mask   = getU16(frame + 6);
+    size_t   offset = TELEMETRY_DELTA_HEADER;
+    for(uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        if(!(mask & (1 << i))) continue;
+        if(offset + telemetryFields[i].size > length) return false;
+
+        uint32_t value = 0;
+        for(uint8_t b = 0; b < telemetryFields[i].size; b++)
+            value |= (uint32_t)frame[offset++] << (8 * b);
+        writeField(status, i, value);
+    }
+
+    status.sequence = getU16(frame + 2);
+    m_status = status;
+    return true;
+}
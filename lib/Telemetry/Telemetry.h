@@ -0,0 +1,142 @@
+#ifndef TELEMETRY
+#define TELEMETRY 1
+
+#include <stdint.h> // Precise type allocation
+#include <stddef.h>
+
+/* Fixed layout, little-endian binary status frame. Carries the same
+   fields as the text "!ID=..." heartbeat in TELEMETRY_FRAME_LENGTH
+   bytes. Shared by the firmware (encode) and collectors (decode), so
+   it must only depend on the C standard headers.
+
+   Offset  Size  Field
+   0       1     TELEMETRY_MAGIC
+   1       1     TELEMETRY_VERSION
+   2       2     Sequence number, wraps
+   4       1     Door ID
+   5       1     Door state (0 closed, 1 open, 2 moving, 3 unknown, 4 blocked)
+   6       1     Motion state
+   7       1     Flags, see TELEMETRY_FLAG_*
+   8       4     Motor position, encoder counts, signed
+   12      4     Motor top position, encoder counts, signed
+   16      1     Upper light threshold
+   17      1     Lower light threshold
+   18      1     Current light level
+   19      1     Motor move time
+   20      2     Closing minute (includes offset)
+   22      2     Opening minute
+   24      2     Close offset in minutes, signed
+   26      4     Uptime in seconds
+
+   Version 1 had one byte positions in steps of 3000 counts at 8-9. */
+
+#define TELEMETRY_MAGIC         0xD0
+#define TELEMETRY_VERSION       2
+#define TELEMETRY_FRAME_LENGTH  30
+
+#define TELEMETRY_FLAG_AUTOMATED    0x01
+#define TELEMETRY_FLAG_LDR          0x02
+#define TELEMETRY_FLAG_TIME         0x04
+#define TELEMETRY_FLAG_MOTOR_SAVED  0x08
+
+struct TelemetryStatus{
+    uint16_t sequence;
+    uint8_t  id;
+    uint8_t  state;
+    uint8_t  motionState;
+    uint8_t  flags;
+    int32_t  motorPosition;
+    int32_t  motorTopPosition;
+    uint8_t  lightUpperThreshold;
+    uint8_t  lightLowerThreshold;
+    uint8_t  currentLight;
+    uint8_t  motorMoveTime;
+    uint16_t closingMinute;
+    uint16_t openingMinute;
+    int16_t  minuteOffset;
+    uint32_t uptime;
+};
+
+/* Delta frame, only the fields that differ from the last keyframe.
+   A keyframe is an ordinary full frame, so deltas stay decodable
+   however many of them are lost in between.
+
+   Offset  Size  Field
+   0       1     TELEMETRY_DELTA_MAGIC
+   1       1     TELEMETRY_VERSION
+   2       2     Sequence number
+   4       2     Sequence number of the keyframe this is relative to
+   6       2     Field mask, bit n set = field n follows (TELEMETRY_FIELD_*)
+   8       ...   Changed fields in bit order, little-endian            */
+
+#define TELEMETRY_DELTA_MAGIC       0xD1
+#define TELEMETRY_DELTA_HEADER      8
+#define TELEMETRY_DELTA_MAX_LENGTH  (TELEMETRY_DELTA_HEADER + TELEMETRY_FRAME_LENGTH - 4)
+#define TELEMETRY_KEYFRAME_INTERVAL 20  // Heartbeats between keyframes
+
+#define TELEMETRY_FIELD_ID              0
+#define TELEMETRY_FIELD_STATE           1
+#define TELEMETRY_FIELD_MOTION          2
+#define TELEMETRY_FIELD_FLAGS           3
+#define TELEMETRY_FIELD_MOTOR_POSITION  4
+#define TELEMETRY_FIELD_TOP_POSITION    5
+#define TELEMETRY_FIELD_UPPER_LIGHT     6
+#define TELEMETRY_FIELD_LOWER_LIGHT     7
+#define TELEMETRY_FIELD_LIGHT           8
+#define TELEMETRY_FIELD_MOVE_TIME       9
+#define TELEMETRY_FIELD_CLOSING         10
+#define TELEMETRY_FIELD_OPENING         11
+#define TELEMETRY_FIELD_OFFSET          12
+#define TELEMETRY_FIELD_UPTIME          13
+#define TELEMETRY_FIELD_COUNT           14
+
+/* Writes exactly TELEMETRY_FRAME_LENGTH bytes, returns the length written */
+size_t telemetryEncode(const TelemetryStatus& status, uint8_t* frame);
+
+/* False if the frame is short, or has the wrong magic or version */
+bool   telemetryDecode(const uint8_t* frame, size_t length, TelemetryStatus& status);
+
+/* Device side, decides between keyframes and deltas */
+class TelemetryDeltaEncoder{
+
+    public:
+
+        TelemetryDeltaEncoder(uint8_t keyframeInterval = TELEMETRY_KEYFRAME_INTERVAL);
+
+        /* Frame buffer must hold TELEMETRY_DELTA_MAX_LENGTH bytes */
+        size_t encode(const TelemetryStatus& status, uint8_t* frame);
+
+        /* Next encode() sends a full frame, e.g. the collector lost track */
+        void   requestKeyframe()    {m_keyframeDue = true;}
+
+    private:
+
+        TelemetryStatus m_keyframe;
+        uint8_t         m_interval;
+        uint8_t         m_sinceKeyframe;
+        bool            m_keyframeDue;
+
+};
+
+/* Collector side, rebuilds the full status from keyframes and deltas */
+class TelemetryReconstructor{
+
+    public:
+
+        TelemetryReconstructor() : m_haveKeyframe(false) {}
+
+        /* False if the frame is malformed or its keyframe is unknown,
+           in which case a keyframe should be requested ('k')        */
+        bool             apply(const uint8_t* frame, size_t length);
+        bool             hasKeyframe()  {return m_haveKeyframe;}
+        TelemetryStatus& getStatus()    {return m_status;}
+
+    private:
+
+        TelemetryStatus m_keyframe;
+        TelemetryStatus m_status;
+        bool            m_haveKeyframe;
+
+};
+
+#endif
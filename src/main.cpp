@@ -2,6 +2,12 @@
 #include <WiFi.h>
 #include <WiFiUdp.h>
 #include <DoorHandler.h>
+#include <DoorTask.h>
+#include <Scheduler.h>
+#include <SpscQueue.h>
+#include <CommandParser.h>
+#include <ReliableChannel.h>
+#include <Logger.h>
 #include "EEPROM.h"
 
 #define VERSION "1.1"
@@ -12,132 +18,151 @@
 #define TARGET              "192.168.1.20"
 #define UDP_PORT            3333
 #define ONBOARDLED          2
-/* Loop constraints */
-#define POLLING_DELAY       1000        // Constant derived to a second
-#define POLLING_PERIOD      5           // 5 seconds - frequency to check door
-#define HEARTBEAT_PERIOD    15          // 15 seconds - frequency to check heartbeats
-#define AUTOMATION_DELAY_X  900         // 900 seconds, aka 15m - default time to disable automation when door moves remotely
-#define MAX_16BIT           65535
+/* Loop periods are shared with the host tools, see DoorTask.h */
 #define MAX_TIMEOUT_BEFORE_RESTART 5    // Attempts 5 times to connect to WiFi before soft resetting ESP32
-
-/* ------------------------------------------ */
-#define DEBUG 1
-// end definitions
-#ifdef DEBUG
-    #define debug(x)   Serial.print (x)
-    #define debugln(x) Serial.println (x)
-    #define debugUpdate(x) update(x)
-#else
-    #define debugUpdate(x)
-    #define debug(x)
-    #define debugln(x)
-#endif
-/* ------------------------------------------ */
+/* Task layout, WiFi lives on core 0 so the door owns core 1 */
+#define NETWORK_CORE        0
+#define DOOR_CORE           1
+#define TASK_STACK          8192
+#define TASK_PRIORITY       2
+#define CONTROL_PRIORITY    (TASK_PRIORITY + 1) // Preempts the door task, see DoorHandler::control()
+#define CONTROL_STACK       4096
+#define CONTROL_TIMER       0           // Hardware timer ticking DOOR_CONTROL_PERIOD
+#define COMMAND_QUEUE_SIZE  16          // Network -> door, must be a power of two
+#define EVENT_QUEUE_SIZE    8           // Door -> network, must be a power of two
+
+/* Logging, see Logger.h for per-module levels */
+#define LOGGER_CORE         0
+#define LOGGER_PRIORITY     1           // Below the door and network tasks
+#define LOGGER_STACK        4096
+#define LOG_DRAIN_PERIOD    50          // ms between batches
+#define LOG_BATCH           32          // Records per batch
+#define LOG_DATAGRAM_LENGTH 512         // Remote records are packed into one datagram
+#define LOG_SERIAL          1           // Echo every record as text over Serial
+#define LOG_RING_DOOR       0           // Logger rings of the tasks that log, see Logger::attach()
+#define LOG_RING_CONTROL    1
+#define LOG_RING_NETWORK    2
+/* Remote log formats, command 'g' */
+#define LOG_REMOTE_TEXT     0           // "(ID:n)-..." lines, formatted here
+#define LOG_REMOTE_BINARY   1           // Format ID + raw arguments, formatted by the collector
 
 static bool eepromFailure   = false;
-static bool automationDelay = true;
-static uint16_t counter = 1; // Will count to 65,500.
-
-static WiFiUDP     udp;//33,26,18,17
-static DoorHandler door(25,32,34,36,35);
-
-#define ILLEGAL_COMMAND '`' // Utilised in ParameterBuffer
+static bool restartPending  = false; // Command 'r', carried out once its reply is posted
+static volatile uint8_t logFormat = LOG_REMOTE_TEXT; // Read by the logger task
+
+/* Command received by the network task, executed by the door task */
+struct Command{
+    char      packet[COMMAND_LENGTH];
+    uint8_t   length;
+    IPAddress address;  // Sender, replies go straight back
+    uint16_t  port;
+    bool      oversized;    // Longer than COMMAND_LENGTH, drained unread
+};
 
-/* Protective wrapper class that aims to abstract and handle
-   complex parameter passing from the UDPSocket.            */
-class ParameterBuffer
-{
+/* Outbound packet produced by the door task, sent by the network task */
+struct Event{
+    char      message[RESPONSE_LENGTH];
+    uint8_t   length;
+    IPAddress address;  // Only used when port is set,
+    uint16_t  port;     // otherwise sent to TARGET
+    bool      reliable; // Sequenced and retransmitted until ACKed
+};
 
-    public:
-        ParameterBuffer(char* buf, int len)
-        {
-            m_command = len > 0 ? buf[0] : ILLEGAL_COMMAND;
-            /* If this command has no parameters */
-            if(len <= 1)
-            {
-                m_valid = false;
-                m_argument = 0;
-                m_length = 0;
-            }
-            /* Command has parameters            */
-            else
-            {
-                /* Pre-emptive setup for parsing */
-                m_valid = true;
-                /* If value exceeds 255 (3 char) then max length at 3*/
-                m_length = len-1 > 3 ? 3 : len-1;
-
-                /* Find values, fill buffer and parse */
-                char tmpBuf[m_length];
-                for( uint8_t i = 1 ; i < len; i++)
-                    tmpBuf[i-1] = buf[i];
-                /* Parse the buffer into a uint8_t    */
-                m_argument = atoi(tmpBuf);
-            }
-        }
+bool transmitReliable(uint16_t, uint16_t, const char*, uint8_t);
 
-        uint8_t getArgument() {return m_argument;                  }
-        uint8_t getLength()   {return m_length;                    }
-        char    getCommand()  {return m_command;                   }
-        char*   getBuffer()   {return m_buf;                       }
-        bool    hasParameter(){return m_valid;                     }
-        bool    hasCommand()  {return m_command != ILLEGAL_COMMAND;}
+/* Owned by the network task */
+static WiFiUDP     udp;//33,26,18,17
+static Scheduler   networkScheduler(millis);
+static TaskHandle_t networkTaskHandle = NULL;
+static ReliableSender eventSender(transmitReliable);
 
-    private:
-        uint8_t m_argument;
-        uint8_t m_length;
-        char    m_command;
-        char    m_buf[5];
-        bool    m_valid;
+/* Owned by the door task, its jobs and commands live in DoorTask */
+bool connected();
+bool updateRaw(const uint8_t*, uint8_t);
+bool updateReliable(const char*, uint8_t);
+bool platformCommand(CommandParser&);
+static const DoorLink doorLink = {connected, updateRaw, updateReliable, platformCommand};
 
-};
+static DoorHandler door(25,32,34,36,35);
+static Scheduler   doorScheduler(millis);
+static DoorTask    doorTask(door, doorScheduler, doorLink);
+static TaskHandle_t doorTaskHandle = NULL;
+static TaskHandle_t controlTaskHandle = NULL;
+static hw_timer_t* controlTimer = NULL;
+
+/* Owned by the logger task, send only */
+static WiFiUDP     logUdp;
+static uint8_t     logDatagram[LOG_DATAGRAM_LENGTH];
+static uint16_t    logDatagramLength = 0;
+static uint8_t     logDatagramFormat = LOG_REMOTE_TEXT;
+
+/* Handoff between the two cores */
+static SpscQueue<Command, COMMAND_QUEUE_SIZE> commandQueue;
+static SpscQueue<Event,   EVENT_QUEUE_SIZE>   eventQueue;
 
 /* Forward Declaration */
-bool acknowledge();
 void update(const char*);
-bool update(const char*, uint8_t);
-bool interpretPacketCommand(ParameterBuffer);
+bool dispatchEvent(Event&);
+void retransmitJob();
+bool postEvent(Event&);
+void executeRequest(Command&);
 void morseFlash(const char*);
 void connectToNetwork();
+void networkJob();
+void reconnectJob();
+void doorTaskBody(void*);
+void controlTask(void*);
+void IRAM_ATTR controlTick();
+void networkTask(void*);
+void drainCommands();
+void drainEvents();
+void wakeTask(TaskHandle_t);
+void loggerTask(void*);
+void logSink(const LogRecord&);
+void logFlush();
+bool sendPacket(Event&);
 
 void setup()
 {
 
-    #ifdef DEBUG
-        Serial.begin(115200);
-        Serial.print("Setup: Starting... ");
-        Serial.print(__TIME__);
-        Serial.print(" ");
-        Serial.print(__DATE__);
-        Serial.println();
-    #endif
+    Serial.begin(115200);
+    Serial.print("Setup: Starting... ");
+    Serial.print(__TIME__);
+    Serial.print(" ");
+    Serial.print(__DATE__);
+    Serial.println();
+
+    /* Logging first, everything after this only touches the ring */
+    logger.begin(millis, logSink, logFlush);
+    xTaskCreatePinnedToCore(loggerTask, "logger", LOGGER_STACK, NULL, LOGGER_PRIORITY, NULL, LOGGER_CORE);
 
-    debug("Setup() Version ");
-    debugln(VERSION);
+    logInfo(MAIN, "Setup() Version " VERSION);
 
     pinMode(ONBOARDLED, OUTPUT);
 
-    debugln("Setup() Attempting to connect to network.");
+    logInfo(MAIN, "Setup() Attempting to connect to network.");
     // delete old config
     WiFi.disconnect(true);
 
     delay(1000);
     connectToNetwork();
 
+    /* Event sequence numbers restart every boot, the epoch tells the
+       collector they have. The radio is up so esp_random() is random. */
+    eventSender.begin(esp_random());
+
     if (!EEPROM.begin(64))
     {
-      debugln("Setup() failed to initialise EEPROM"); 
+      logError(MAIN, "Setup() failed to initialise EEPROM");
       eepromFailure = true;
       return;
     }
 
     door.loadSettings();
-    DoorHandler::Response r = door.getState();
 
-    debugln(r.getResponse());
-    debugln("Setup() EEPROM setup");
+    logInfo(MAIN, "Setup() EEPROM setup, ID=%d closed=%d top=%d", door.getID(), door.isClosed(), door.getTopPosition());
     
-    update("Setup() Initialised - Door Controller starting.");
+    doorTask.updateReliable("Setup() Initialised - Door Controller starting.");
 
     // LDR
     pinMode(4, INPUT);  
@@ -145,269 +170,386 @@ void setup()
     // Once connected configure NTP
     door.configureNTP();
 
+    doorTask.begin();
+
+    networkScheduler.add(networkJob,   NETWORK_PERIOD,   NETWORK_PERIOD);
+    networkScheduler.add(reconnectJob, RECONNECT_PERIOD, RECONNECT_PERIOD);
+    networkScheduler.add(retransmitJob, RETRANSMIT_PERIOD, RETRANSMIT_PERIOD);
+
+    /* Network first, so the door task always has somewhere to send events */
+    xTaskCreatePinnedToCore(networkTask, "network", TASK_STACK, NULL, TASK_PRIORITY, &networkTaskHandle, NETWORK_CORE);
+    xTaskCreatePinnedToCore(doorTaskBody, "door",    TASK_STACK, NULL, TASK_PRIORITY, &doorTaskHandle,    DOOR_CORE);
+
+    /* Position loop, 1us timer ticks off the 80MHz APB clock */
+    xTaskCreatePinnedToCore(controlTask, "control", CONTROL_STACK, NULL, CONTROL_PRIORITY, &controlTaskHandle, DOOR_CORE);
+    controlTimer = timerBegin(CONTROL_TIMER, 80, true);
+    timerAttachInterrupt(controlTimer, controlTick, true);
+    timerAlarmWrite(controlTimer, DOOR_CONTROL_PERIOD, true);
+    timerAlarmEnable(controlTimer);
+
 }
 
-bool pollDoor()
-{
-    debugln("pollDoor()");
-    /* If the automation is disabled then return */
-    if( (counter % AUTOMATION_DELAY_X != 0) && automationDelay)
+/* Drains every pending datagram into the command queue, the
+   door task then executes them together as a single batch.  */
+bool pollNetwork()
+{ 
+    uint8_t received = 0;
+
+    /* Leave anything we can't queue in the socket for the next poll */
+    while(!commandQueue.full())
     {
-        debug("pollDoor(), automationDelay=1, time until automation enabled=");
-        debugln(AUTOMATION_DELAY_X-(counter%AUTOMATION_DELAY_X));
-        char tmp[200];
-        sprintf(tmp, "pollDoor() automationDelay=1, time until automation enabled=%d", AUTOMATION_DELAY_X-(counter%AUTOMATION_DELAY_X));
-        debugUpdate(tmp);
-        return false;
-    }
-    else if (automationDelay) automationDelay = false;
+        int packetLength = udp.parsePacket();
+        if(packetLength <= 0) break;
 
-    bool doorMoved = door.poll();
+        logDebug(NETWORK, "pollNetwork() Message received, length=%d", packetLength);
 
-    debugUpdate(doorMoved ? "pollDoor() Door has moved" : "pollDoor() Door has not moved");
-    debug("pollDoor() Door moved = ");
-    debugln(doorMoved ? "true":"false");
+        /* Retrieve packet and hand it to the door task to parse */
+        Command command;
+        command.address   = udp.remoteIP();
+        command.port      = udp.remotePort();
+        command.oversized = packetLength > COMMAND_LENGTH;
 
-    if(doorMoved)
-    {
-        debugUpdate(door.isClosed() ? "pollDoor() Door has closed just now." : "pollDoor() Door has opened just now.");
-        debugln    (door.isClosed() ? "pollDoor() Door has closed just now." : "pollDoor() Door has opened just now.");
-        if(door.isClosed()) update("pollDoor() DM:0");
-        if(door.isOpen())   update("pollDoor() DM:1");
+        /* Any prefix of it could be a different request, so none of
+           it is run; the rest is flushed or the next parse sees it */
+        if(command.oversized)
+        {
+            logError(NETWORK, "pollNetwork() Datagram too long, length=%d", packetLength);
+            udp.flush();
+            command.length = 0;
+        }
+        else command.length = udp.read(command.packet, packetLength);
 
-        // Light may cause problems, we don't want the door flinging open and closed every 30 seconds
-        if(door.ldrEnabled() && !door.timeEnabled())
+        /* Event ACKs belong to this task, the door never sees them */
+        if(command.length > 0 && command.packet[0] == 'A')
         {
-          counter = 1;
-          automationDelay = true;
+            CommandParser ack(command.packet, command.length);
+            if(ack.hasArgument(0, 65535, 1))   eventSender.acknowledge(ack.getArgument(), ack.getArgument(1));
+            else if(ack.hasArgument(0, 65535)) eventSender.acknowledge(ack.getArgument());
+            continue;
         }
+
+        commandQueue.push(command);
+        received++;
     }
 
-    return doorMoved;
+    if(received > 0)
+    {
+        logRemote(NETWORK, "pollNetwork() Messages received: %d", received);
+        wakeTask(doorTaskHandle);
+    }
+    return received > 0;
 }
 
-bool pollNetwork()
-{ 
-    debug("pollNetwork() DeviceIP: ");
-    debugln(WiFi.localIP());
-    int packetLength = udp.parsePacket();
-
-    /* Have we received messages */
-    if(packetLength > 0)
+/* Main body of code, called continiously */
+void loop()
+{
+    if(eepromFailure)
     {
+        logRemote(MAIN, "loop() EEPROM has failed.");
+        morseFlash(".---.---");
+        return;  
+    }
+
+    /* All work happens on the door and network tasks */
+    vTaskDelete(NULL);
+}
+
+/*
+-----------------------------------------------------------
+----------------- TASKS       -----------------------------
+-----------------------------------------------------------
+*/
 
-        debug("pollNetwork() Message received, length=");
-        debugln(packetLength);
-        debugUpdate("pollNetwork() Message received.");
-        /* Retrieve packet, flush the socket and parse */
-        char incomingPacket[packetLength];
-        udp.read(incomingPacket, packetLength);
+/* Owns DoorHandler, runs on DOOR_CORE */
+void doorTaskBody(void* parameters)
+{
+    logger.attach(LOG_RING_DOOR);
+    doorTask.select();
+    for(;;)
+    {
+        drainCommands();
 
-        interpretPacketCommand(ParameterBuffer(incomingPacket, packetLength));
+        /* Sleep until the next deadline or the network task hands over work */
+        uint32_t sleep = doorScheduler.run();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep));
     }
-    else
+}
+
+/* Steps the door's position loop, woken by controlTick() */
+void controlTask(void* parameters)
+{
+    logger.attach(LOG_RING_CONTROL);
+    for(;;)
     {
-        debugln("pollNetwork() No new messages.");
-        debugUpdate("pollNetwork() No new messages.");
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        door.control();
     }
-    udp.flush();
-    return packetLength > 0;
 }
 
-void moveDoor(bool direction)
+/* Timer interrupt, floats and LEDC writes don't belong in an ISR
+   so all it does is wake controlTask()                            */
+void IRAM_ATTR controlTick()
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(controlTaskHandle, &woken);
+    if(woken) portYIELD_FROM_ISR();
+}
+
+/* Owns WiFiUDP, runs on NETWORK_CORE */
+void networkTask(void* parameters)
 {
-    /* Regardless of direction, did the door move? */
-    debug("moveDoor() - ");
-    debug(direction ? "Opening":"Closing");
-    bool result = door.moveDoor(direction);
-    debug("moveDoor() Door moved: ");
-    debugln(result ? "true":"false");
-    if(result)
+    logger.attach(LOG_RING_NETWORK);
+    for(;;)
     {
-        /* Manual moved, as such delay automation from
-           forcing the door back in a previous state  */
-        counter = 1;
-        automationDelay = true;
+        drainEvents();
+
+        /* Sleep until the next deadline or the door task hands over events */
+        uint32_t sleep = networkScheduler.run();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep));
     }
 }
 
-/* Main body of code, called continiously */
-void loop()
+/* Everything queued is run as one batch, settings changes
+   within it share a single EEPROM commit.                  */
+void drainCommands()
 {
-    debug("loop() ");
-    debug(counter);
+    if(commandQueue.empty()) return;
 
-    if(eepromFailure)
+    Command command;
+    door.beginBatch();
+    while(commandQueue.pop(command))
     {
-        debugln("loop() eeprom has failed.");
-        debugUpdate("EEPROM has failed.");
-        morseFlash(".---.---");
-        return;  
+        executeRequest(command);
     }
-    
-    if(door.ldrEnabled())
+    door.endBatch();
+}
+
+void drainEvents()
+{
+    Event event;
+    while(eventQueue.pop(event))
     {
-      debug(" - Light: ");
-      debugln(door.getLightLevel());  
+        dispatchEvent(event);
     }
-    else  debugln("");  
-    
-    if(WiFi.status() == WL_CONNECTED)
+}
+
+void wakeTask(TaskHandle_t task)
+{
+    if(task != NULL) xTaskNotifyGive(task);
+}
+
+/* Formats and ships everything the other tasks logged, lowest
+   priority so a slow Serial or socket never holds up the door.  */
+void loggerTask(void* parameters)
+{
+    for(;;)
     {
-        if( counter % POLLING_PERIOD   == 0 ) pollDoor();
+        logger.drain(LOG_BATCH);
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_PERIOD));
+    }
+}
 
-        if( counter % POLLING_PERIOD   == 0 ) pollNetwork();
+/* Called by Logger::drain() for each record */
+void logSink(const LogRecord& record)
+{
+    char line[LOG_LINE_LENGTH];
+    uint16_t len = 0;
 
-        if( counter % HEARTBEAT_PERIOD == 0 ) acknowledge();
+    #if LOG_SERIAL
+        len = Logger::format(record, line, sizeof(line));
+        Serial.write((const uint8_t*)line, len);
+        Serial.write('\n');
+    #endif
 
-    }
-    else
+    if(!(record.flags & LOG_FLAG_REMOTE)) return;
+
+    /* One format per datagram */
+    uint8_t format = logFormat;
+    if(format != logDatagramFormat) logFlush();
+    logDatagramFormat = format;
+
+    if(format == LOG_REMOTE_BINARY)
     {
-        // Attempt reconnect if not connected
-        if( counter % HEARTBEAT_PERIOD == 0 )
-        {
-          debugln("loop() Currently disconnected. Attempting a reconnect");
-          connectToNetwork();
-        }
-        if(door.ldrEnabled())
+        /* No formatting, the collector looks the ID up in its dictionary */
+        if(logDatagramLength + LOG_WIRE_RECORD_MAX > LOG_DATAGRAM_LENGTH || logDatagram[3] == 255) logFlush();
+        if(logDatagramLength == 0)
         {
-            pollDoor();
+            logDatagram[0] = LOG_WIRE_MAGIC;
+            logDatagram[1] = LOG_WIRE_VERSION;
+            logDatagram[2] = door.getID();
+            logDatagram[3] = 0;
+            logDatagramLength = LOG_WIRE_HEADER_LENGTH;
         }
+        logDatagramLength += Logger::encode(record, logDatagram + logDatagramLength, LOG_DATAGRAM_LENGTH - logDatagramLength);
+        logDatagram[3]++;
+        return;
     }
-    /* Don't spam the server */
-    delay(POLLING_DELAY);
 
-    /* Wrap the counter between 0 - MAX_16BIT */
-    counter++;
-    if(counter >= MAX_16BIT) counter=1;
+    #if !LOG_SERIAL
+        len = Logger::format(record, line, sizeof(line));
+    #endif
+
+    /* Pack into the pending datagram, flushing early if it won't fit */
+    if(logDatagramLength + len + 12 > LOG_DATAGRAM_LENGTH) logFlush();
+    int room    = LOG_DATAGRAM_LENGTH - logDatagramLength;
+    int written = snprintf((char*)logDatagram + logDatagramLength, room, "(ID:%d)-%s\n", door.getID(), line);
+    if(written > 0) logDatagramLength += written < room ? written : room - 1;
 }
 
-bool interpretPacketCommand(ParameterBuffer pb)
+/* Called by Logger::drain() once per batch */
+void logFlush()
+{
+    if(logDatagramLength == 0) return;
+
+    if(WiFi.status() == WL_CONNECTED)
+    {
+        logUdp.beginPacket(TARGET, UDP_PORT);
+        logUdp.write(logDatagram, logDatagramLength);
+        logUdp.endPacket();
+    }
+    logDatagramLength = 0;
+}
+
+/*
+-----------------------------------------------------------
+----------------- SCHEDULED JOBS  -------------------------
+-----------------------------------------------------------
+*/
+void networkJob()
+{
+    if(WiFi.status() == WL_CONNECTED) pollNetwork();
+}
+
+void retransmitJob()
+{
+    if(WiFi.status() == WL_CONNECTED) eventSender.poll(millis());
+}
+
+void reconnectJob()
+{
+    // Attempt reconnect if not connected
+    if(WiFi.status() != WL_CONNECTED)
+    {
+        logInfo(NETWORK, "reconnectJob() Currently disconnected. Attempting a reconnect");
+        connectToNetwork();
+    }
+}
+
+/* Runs a request on the door task, the reply goes straight back to whoever asked */
+void executeRequest(Command& command)
+{
+    Event event;
+    event.length   = command.oversized ? doorTask.reject(RESULT_MALFORMED, event.message, RESPONSE_LENGTH)
+                                       : doorTask.execute(command.packet, command.length, event.message, RESPONSE_LENGTH);
+    event.address  = command.address;
+    event.port     = command.port;
+    event.reliable = false;
+    postEvent(event);
+
+    /* Only now, so whoever asked still hears back */
+    if(restartPending)
+    {
+        logInfo(MAIN, "executeRequest() Restarting.");
+        door.endBatch(); // Don't lose settings from earlier in the batch
+        delay(1000);     // The network task sends the reply meanwhile
+        ESP.restart();
+    }
+}
+
+/* Commands DoorTask leaves to the firmware */
+bool platformCommand(CommandParser& pb)
 {
-    debug("interpretPacketCommand(");
-    debug("cmd=");
-    debug(pb.getCommand());
-    debug(", hasParam=");
-    debug(pb.hasParameter());
-    debug(", arg=");
-    debug(pb.getArgument());
-    debugln(")");
-
-    char tmp[100];
-    sprintf(tmp, "interpretPacketCommand() Parsing command: %u, hasParam: %d - %d", pb.getCommand(), pb.hasParameter(), pb.getArgument());
-    debugUpdate(tmp);
-    
     switch(pb.getCommand())
     {
-        case '0': // disable/enable automation
-            if(pb.hasParameter()) door.setAutomated(pb.getArgument());
-            break;
-        case '1': // unused
-            break;
-        case '2': // move door
-             if(pb.hasParameter()) moveDoor(pb.getArgument());
-            break;
-        case '4': // set motor top position
-            if(pb.hasParameter()) door.setTopPosition(pb.getArgument());
-            break;
-        case '5': // set door lower light threshold
-            if(pb.hasParameter()) door.setLightLowerThreshold(pb.getArgument());
-            break;
-        case '6': // set door upper light threshold
-            if(pb.hasParameter()) door.setLightUpperThreshold(pb.getArgument());
+        case 'g': // Remote log format, 0 = text, 1 = binary, needs the log dictionary
+            logFormat = pb.getArgument();
             break;
-        case '7': // set door ID
-            if(pb.hasParameter()) door.setDoorId(pb.getArgument());
-            break;
-        case '8': // add time to door closing time
-            if(pb.hasParameter()) door.setDoorCloseTime(pb.getArgument());
-            break;
-        case '9': // unused
-            break;
-        case 'a': // disable automation delay (Door will 'refresh')
-            automationDelay = 0;
-            break;
-        case 'm': // Do we save the motors position in EEPROM?
-            if(pb.hasParameter()) door.setMotorSaved(pb.getArgument());
-            break;
-        case 'n': // Motor move speed - not currently used
-            if(pb.hasParameter()) door.setMotorMoveSpeed(pb.getArgument());
-            break;
-        case 'f': // Factory reset
-            door.factoryReset();
-        case 'h': // Help
-            debugUpdate("interpretPacketCommand() Displaying help. \n1 [1:0]=LDR on\n2 [1:0]=MV Door\n4 [0-255]=MTR Top\n5 [0-255]=LWR Light\n6 [0-255]=UPR Light\n7 [0-255]=ID\n8 [0-255]=Open Time\n9 [0-255]=Close Time\na=Disable Automation delay\nm [1:0]=SaveMTRPos\nf=Reset\no=Open\nc=Close\n");
-            break;
-        case 'o': // Set door to open
-            debugln("interpretPacketCommand() Forcing door to be open.");
-            door.forcedOpen();
-            counter = 1;
-            automationDelay = true;
-            break;
-        case 'c': // Set door to closed
-            debugln("interpretPacketCommand() Forcing door to be closed.");
-            door.forcedClosed();
-            counter = 1;
-            automationDelay = true;
-            break;
-        case 'p': // reserved
-            break;
-        case 'd': // reserved
-            break;
-        case 'l': // Light enable/disable
-             if(pb.hasParameter()) door.setLDREnabled(pb.getArgument());
-            break;
-        case 't': // Time enable/disable
-             if(pb.hasParameter()) door.setTimeEnabled(pb.getArgument());
-            break;
-        case 'r': // Restart ESP32
-             debugln("interpretPacketCommand() restart issued.");
-             delay(1000);
-             ESP.restart();
+        case 'r': // Restart ESP32, the last command of its request, see executeRequest()
+             logInfo(MAIN, "interpretPacketCommand() restart issued.");
+             restartPending = true;
              break;
-        case 'v': // Time enable/disable
-             debugUpdate("interpretPacketCommand() Version=" VERSION);
+        case 'v': // Version
+             update("interpretPacketCommand() Version=" VERSION);
             break;
-        case ILLEGAL_COMMAND:  // Unrecongised command
-            debugln("interpretPacketCommand() Command received was invalid.");
-            return false;
         default: // Failure case
-            debugln("interpretPacketCommand() Unrecognised command!");
+            logDebug(MAIN, "interpretPacketCommand() Unrecognised command!");
             return false;
     }
     return true;
 }
 
-/* Simple ack function */
-bool acknowledge()
-{   
-    debugln(WiFi.status() == WL_CONNECTED ? "acknowledge() We're connected." : "acknowledge() !We're disconnected!");
-    if(WiFi.status() == WL_CONNECTED)
-    {
-        debugUpdate("acknowledge() Acknowledging host.");
-        DoorHandler::Response response = door.getState();
-        debug("acknowledge() Response: ");
-        debugln(response.getResponse());
-        return update(response.getResponse(), response.getLength());
-    }
-    return false;
+bool connected()
+{
+    return WiFi.status() == WL_CONNECTED;
 }
 
 void update(const char* strBufffer)
 {
-    update(strBufffer, strlen(strBufffer));
+    doorTask.update(strBufffer);
+}
+
+/* Sends a binary payload as is, without the "(ID:n)-" prefix */
+bool updateRaw(const uint8_t* payload, uint8_t len)
+{
+    Event event;
+    event.length = len < RESPONSE_LENGTH ? len : RESPONSE_LENGTH;
+    memcpy(event.message, payload, event.length);
+    event.port     = 0;
+    event.reliable = false;
+    return postEvent(event);
+}
+
+/* Must reach the collector, e.g. door moved. Sent as "(ID:n)-E<seq>,<epoch>:<text>" */
+bool updateReliable(const char* payload, uint8_t len)
+{
+    Event event;
+    event.length   = len < RELIABLE_PAYLOAD ? len : RELIABLE_PAYLOAD;
+    memcpy(event.message, payload, event.length);
+    event.port     = 0;
+    event.reliable = true;
+    return postEvent(event);
+}
+
+/* Called by eventSender on the network task, for sends and retransmits */
+bool transmitReliable(uint16_t epoch, uint16_t sequence, const char* payload, uint8_t len)
+{
+    Event event;
+    int written = snprintf(event.message, RESPONSE_LENGTH, "(ID:%d)-E%u,%u:%.*s", door.getID(), sequence, epoch, len, payload);
+    event.length   = written < RESPONSE_LENGTH ? written : RESPONSE_LENGTH - 1;
+    event.port     = 0;
+    event.reliable = false;
+    return sendPacket(event);
+}
+
+bool postEvent(Event& event)
+{
+    /* Before the tasks exist, or on the network task itself, send directly */
+    if(networkTaskHandle == NULL || xTaskGetCurrentTaskHandle() == networkTaskHandle)
+    {
+        return dispatchEvent(event);
+    }
+
+    if(!eventQueue.push(event)) return false;
+    wakeTask(networkTaskHandle);
+    return WiFi.status() == WL_CONNECTED;
 }
 
-bool update(const char* strBufffer, uint8_t len)
+/* Only ever called from the task that owns the socket */
+bool dispatchEvent(Event& event)
 {
-    uint8_t id = door.getID();
-    char tmp[len+10]; // Prepare to expand buffer to fit ID into
-    sprintf(tmp, "(ID:%d)-%s", id, strBufffer);
+    if(!event.reliable) return sendPacket(event);
 
+    eventSender.send(event.message, event.length, millis());
+    return WiFi.status() == WL_CONNECTED;
+}
+
+bool sendPacket(Event& event)
+{
     if(WiFi.status() == WL_CONNECTED)
     {
-        udp.beginPacket(TARGET, UDP_PORT);
-        udp.printf(tmp);
+        if(event.port != 0) udp.beginPacket(event.address, event.port);
+        else                udp.beginPacket(TARGET, UDP_PORT);
+        udp.write((const uint8_t*)event.message, event.length);
         udp.endPacket();
     }
     return WiFi.status() == WL_CONNECTED;
@@ -443,10 +585,6 @@ void connectToNetwork()
     // If after so many attempts we can't connect to the defacto WiFi then try Farm WiFi
     static uint8_t alternativeWiFi = 1;
     
-    debug("connectToNetwork() alternativeWiFiCounter=");
-    debug(alternativeWiFi);
-    debug(" Awaiting to connect to - ");
-    
     digitalWrite(ONBOARDLED, HIGH);
     // delete old config
     WiFi.disconnect();
@@ -458,7 +596,7 @@ void connectToNetwork()
     if(alternativeWiFi >= MAX_TIMEOUT_BEFORE_RESTART)
     {
       // This will perform a soft restart, will not restart hardware peripherals or I/O though.
-      debugln("connectToNetwork() giving up, performing soft reset.");
+      logError(NETWORK, "connectToNetwork() giving up, performing soft reset.");
       delay(2500);
       ESP.restart();
     }
@@ -466,15 +604,13 @@ void connectToNetwork()
     {
       // If after 3 attempts of connecting to the defacto wifi, then try an alternative one
       WiFi.begin(BACK_UP_WIFI, SSID_KEY);
-      debug(" (BACK_UP) ");
-      debug(BACK_UP_WIFI);
+      logInfo(NETWORK, "connectToNetwork() attempt=%d, awaiting to connect to - (BACK_UP) " BACK_UP_WIFI, alternativeWiFi);
     }
     else
     {
       WiFi.begin(NETWORK_SSID, SSID_KEY);
-      debug(NETWORK_SSID);
+      logInfo(NETWORK, "connectToNetwork() attempt=%d, awaiting to connect to - " NETWORK_SSID, alternativeWiFi);
     }
-    debug(" ");
 
     delay(2500);
 
@@ -483,15 +619,13 @@ void connectToNetwork()
     {
       delay(500);
       digitalWrite(ONBOARDLED, HIGH);
-      debug(".");
       delay(500);   
       digitalWrite(ONBOARDLED, LOW);
     }
-    debugln("");
     if(WiFi.status() == WL_CONNECTED)
     { 
-      debug("connectToNetwork() Connected, IP address: ");
-      debugln(WiFi.localIP());
+      IPAddress ip = WiFi.localIP();
+      logInfo(NETWORK, "connectToNetwork() Connected, IP address: %d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
       udp.begin(WiFi.localIP(),UDP_PORT);
       digitalWrite(ONBOARDLED, HIGH);
       update("connectToNetwork() Connected.");
@@ -500,7 +634,7 @@ void connectToNetwork()
     else    
     {
       digitalWrite(ONBOARDLED, LOW);
-      debugln("connectToNetwork() Couldn't connect to WiFi.");
+      logError(NETWORK, "connectToNetwork() Couldn't connect to WiFi.");
       alternativeWiFi++;
     }
 }
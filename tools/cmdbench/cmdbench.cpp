@@ -0,0 +1,145 @@
+/* cmdbench - commands per second through the door task's command path,
+   the real DoorTask and DoorHandler on a VirtualBoard.
+
+   Usage: cmdbench [batches]
+   Runs each of, in turn:
+     one by one  the controller's setup commands, '4', '5', '6', '7',
+                 'l' and 't', one datagram each, each committed on its
+                 own as a datagram per poll was
+     burst       the same datagrams drained as one batch, the way
+                 drainCommands() does, and its EEPROM commits
+     request     the same six as a single ';' separated request
+     interpret   interpretPacketCommand() alone on parsed commands,
+                 no checks and no reply
+
+   Every reply must be all RESULT_OK and the settings must have landed.
+   Exits non-zero otherwise.                                          */
+#include <Arduino.h>
+#include <DoorHandler.h>
+#include <DoorTask.h>
+#include <VirtualBoard.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define TOP_POSITION    12000
+
+static const char* burst[] = {"4 12000", "5 20", "6 40", "7 3", "l 1", "t 1"};
+static const uint8_t BURST_COUNT = sizeof(burst)/sizeof(burst[0]);
+static const char*   request   = "4 12000;5 20;6 40;7 3;l 1;t 1";
+
+/* Nothing goes anywhere, replies are checked from execute() */
+static bool connected()                         {return true;}
+static bool send(const uint8_t*, uint8_t)       {return true;}
+static bool sendReliable(const char*, uint8_t)  {return true;}
+static bool command(CommandParser&)             {return false;}
+static const DoorLink link = {connected, send, sendReliable, command};
+
+static unsigned long boardClock()
+{
+    return VirtualBoard::current().now();
+}
+
+/* "(ID:n)-R:0,0,...;" with 'count' zeros */
+static bool allOk(const char* reply, uint8_t count)
+{
+    const char* results = strstr(reply, "-R:");
+    if(!results) return false;
+    results += 3;
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if(results[0] != '0' || results[1] != (i + 1 < count ? ',' : ';')) return false;
+        results += 2;
+    }
+    return true;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t batches = argc > 1 ? strtoul(argv[1], nullptr, 0) : 100000;
+
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+    Scheduler scheduler(boardClock);
+    DoorTask  task(door, scheduler, link);
+    task.select();
+    task.begin();
+
+    char     reply[RESPONSE_LENGTH];
+    bool     ok = true;
+
+    /* One datagram per command, committed on its own as each poll used to */
+    uint32_t commits = board.commits();
+    auto     start   = std::chrono::steady_clock::now();
+    for(uint32_t b = 0; b < batches; b++)
+        for(uint8_t i = 0; i < BURST_COUNT; i++)
+        {
+            task.execute(burst[i], strlen(burst[i]), reply, sizeof(reply));
+            ok = ok && allOk(reply, 1);
+        }
+    double   singleSeconds = seconds(start);
+    double   singleCommits = (double)(board.commits() - commits) / batches;
+
+    /* drainCommands(), the same datagrams as one batch */
+    commits = board.commits();
+    start   = std::chrono::steady_clock::now();
+    for(uint32_t b = 0; b < batches; b++)
+    {
+        door.beginBatch();
+        for(uint8_t i = 0; i < BURST_COUNT; i++)
+        {
+            task.execute(burst[i], strlen(burst[i]), reply, sizeof(reply));
+            ok = ok && allOk(reply, 1);
+        }
+        door.endBatch();
+    }
+    double   burstSeconds = seconds(start);
+    double   burstCommits = (double)(board.commits() - commits) / batches;
+
+    /* All six in one request */
+    commits = board.commits();
+    start   = std::chrono::steady_clock::now();
+    for(uint32_t b = 0; b < batches; b++)
+    {
+        door.beginBatch();
+        task.execute(request, strlen(request), reply, sizeof(reply));
+        door.endBatch();
+        ok = ok && allOk(reply, BURST_COUNT);
+    }
+    double   requestSeconds = seconds(start);
+    double   requestCommits = (double)(board.commits() - commits) / batches;
+
+    /* interpretPacketCommand() alone, parsed once up front */
+    CommandParser* parsed[BURST_COUNT];
+    for(uint8_t i = 0; i < BURST_COUNT; i++) parsed[i] = new CommandParser(burst[i], strlen(burst[i]));
+    door.beginBatch();
+    start = std::chrono::steady_clock::now();
+    for(uint32_t b = 0; b < batches; b++)
+        for(uint8_t i = 0; i < BURST_COUNT; i++) ok = task.interpretPacketCommand(*parsed[i]) && ok;
+    double   interpretSeconds = seconds(start);
+    door.endBatch();
+    for(uint8_t i = 0; i < BURST_COUNT; i++) delete parsed[i];
+
+    if(!ok || door.getTopPosition() != TOP_POSITION || door.getLightLowerThreshold() != 20 ||
+       door.getLightUpperThreshold() != 40 || door.getID() != 3 || !door.ldrEnabled() || !door.timeEnabled())
+    {
+        fprintf(stderr, "cmdbench: a command failed or its setting didn't land, reply %s\n", reply);
+        return 1;
+    }
+
+    uint64_t commands = (uint64_t)batches * BURST_COUNT;
+    printf("commands        %llu, %u batches of %d\n", (unsigned long long)commands, batches, BURST_COUNT);
+    printf("one by one      %9.0f commands/s  %5.2f EEPROM commits per batch\n", commands / singleSeconds, singleCommits);
+    printf("burst           %9.0f commands/s  %5.2f EEPROM commits per batch\n", commands / burstSeconds, burstCommits);
+    printf("request         %9.0f commands/s  %5.2f EEPROM commits per batch\n", commands / requestSeconds, requestCommits);
+    printf("interpret       %9.0f commands/s\n", commands / interpretSeconds);
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include "Collector.h"
+#include "DoorView.h"
+#include "../logdecode/LogDictionary.h"
+#include <Logger.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+Collector::Collector(const LogDictionary* dictionary, FILE* logOut, DoorView* view, uint8_t shard)
+: m_dictionary(dictionary),
+  m_logOut(logOut),
+  m_view(view),
+  m_shard(shard),
+  m_touched(-1)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool Collector::ingest(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now, Reply& reply)
+{
+    m_touched   = -1;
+    bool result = dispatch(data, len, from, now, reply);
+    if(m_view && m_touched >= 0) m_view->publish(m_shard, m_touched, m_doors.get(m_touched));
+    return result;
+}
+
+bool Collector::dispatch(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now, Reply& reply)
+{
+    m_stats.packets++;
+    m_stats.bytes += len;
+
+    if(len == 0)
+    {
+        m_stats.malformed++;
+        return false;
+    }
+
+    switch(data[0])
+    {
+        case TELEMETRY_MAGIC:
+        case TELEMETRY_DELTA_MAGIC:
+            return ingestFrame(data, len, from, now, reply);
+        case LOG_WIRE_MAGIC:
+            ingestLog(data, len, from, now);
+            return false;
+    }
+
+    /* Everything else is text, prefixed "(ID:n)-" by update() */
+    const char* text = (const char*)data;
+    if(len < 7 || memcmp(text, "(ID:", 4) != 0)
+    {
+        m_stats.malformed++;
+        return false;
+    }
+
+    unsigned id  = 0;
+    size_t   pos = 4;
+    while(pos < len && text[pos] >= '0' && text[pos] <= '9' && id < DOOR_COUNT) id = id * 10 + (text[pos++] - '0');
+    if(pos == 4 || id >= DOOR_COUNT || pos + 1 >= len || text[pos] != ')' || text[pos + 1] != '-')
+    {
+        m_stats.malformed++;
+        return false;
+    }
+    pos += 2;
+    return ingestText(id, text + pos, len - pos, from, now, reply);
+}
+
+DoorState& Collector::seen(uint8_t id, const Endpoint& from, uint64_t now)
+{
+    DoorState& door = m_doors.get(id);
+    door.known    = true;
+    door.endpoint = from;
+    door.lastSeen = now;
+    m_endpoints[key(from)] = id;
+    m_touched = id;
+    return door;
+}
+
+bool Collector::ingestText(uint8_t id, const char* text, size_t len, const Endpoint& from, uint64_t now, Reply& reply)
+{
+    DoorState& door = seen(id, from, now);
+
+    if(len >= 4 && memcmp(text, "!ID=", 4) == 0)
+    {
+        if(!parseHeartbeat(text, len, door.status))
+        {
+            m_stats.malformed++;
+            return false;
+        }
+        door.haveStatus = true;
+        door.heartbeats++;
+        m_stats.heartbeats++;
+        return false;
+    }
+
+    /* "E<seq>,<epoch>:<payload>", or "E<seq>:" from a door without epochs.
+       Always ACKed, even duplicates as our ACK may have been lost.      */
+    if(len >= 3 && text[0] == 'E' && text[1] >= '0' && text[1] <= '9')
+    {
+        unsigned sequence = 0, epoch = 0;
+        size_t   pos      = 1;
+        while(pos < len && text[pos] >= '0' && text[pos] <= '9' && sequence <= 0xFFFF) sequence = sequence * 10 + (text[pos++] - '0');
+        if(pos < len && text[pos] == ',')
+        {
+            size_t start = ++pos;
+            while(pos < len && text[pos] >= '0' && text[pos] <= '9' && epoch <= 0xFFFF) epoch = epoch * 10 + (text[pos++] - '0');
+            if(pos == start) epoch = 0x10000; // Malformed
+        }
+        if(pos >= len || text[pos] != ':' || sequence > 0xFFFF || epoch > 0xFFFF)
+        {
+            m_stats.malformed++;
+            return false;
+        }
+        if(epoch) makeReply(reply, from, "A%u,%u", sequence, epoch);
+        else      makeReply(reply, from, "A%u", sequence);
+
+        /* A new epoch is the door restarted, its events count from 0 again */
+        if(epoch && door.epoch && epoch != door.epoch)
+        {
+            door.restarts++;
+            m_stats.restarts++;
+        }
+        if(epoch) door.epoch = epoch;
+
+        if(!door.eventWindow.accept(sequence, epoch))
+        {
+            m_stats.duplicates++;
+            return true;
+        }
+        door.events++;
+        m_stats.events++;
+
+        /* e.g. "pollDoor() DM:1", 0 closed, 1 open, 4 blocked as getDoorState() */
+        for(size_t i = pos + 1; i + 3 < len; i++)
+        {
+            if(text[i] == 'D' && text[i + 1] == 'M' && text[i + 2] == ':' &&
+               (text[i + 3] == '0' || text[i + 3] == '1' || text[i + 3] == '4'))
+            {
+                door.doorMoved = text[i + 3] - '0';
+                break;
+            }
+        }
+        if(m_logOut) fprintf(m_logOut, "(ID:%d)-%.*s\n", id, (int)(len - pos - 1), text + pos + 1);
+        return true;
+    }
+
+    if(len >= 2 && text[0] == 'R' && text[1] == ':')
+    {
+        m_stats.replies++;
+        return false;
+    }
+
+    door.logs++;
+    m_stats.logs++;
+    if(m_logOut) fprintf(m_logOut, "(ID:%d)-%.*s%s", id, (int)len, text, len && text[len - 1] == '\n' ? "" : "\n");
+    return false;
+}
+
+bool Collector::ingestFrame(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now, Reply& reply)
+{
+    uint8_t id;
+    if(data[0] == TELEMETRY_MAGIC)
+    {
+        TelemetryStatus status;
+        if(!telemetryDecode(data, len, status))
+        {
+            m_stats.malformed++;
+            return false;
+        }
+        id = status.id;
+    }
+    else
+    {
+        auto it = m_endpoints.find(key(from));
+        if(it == m_endpoints.end())
+        {
+            /* Don't know who this is yet, a keyframe will tell us */
+            makeReply(reply, from, "k", 0);
+            return true;
+        }
+        id = it->second;
+    }
+
+    DoorState& door = seen(id, from, now);
+    if(!door.telemetry.apply(data, len))
+    {
+        makeReply(reply, from, "k", 0);
+        return true;
+    }
+    door.status     = door.telemetry.getStatus();
+    door.haveStatus = true;
+    door.heartbeats++;
+    m_stats.heartbeats++;
+    return false;
+}
+
+void Collector::ingestLog(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now)
+{
+    if(len < LOG_WIRE_HEADER_LENGTH || data[1] != LOG_WIRE_VERSION)
+    {
+        m_stats.malformed++;
+        return;
+    }
+
+    DoorState& door = seen(data[2], from, now);
+    door.logs   += data[3];
+    m_stats.logs += data[3];
+
+    if(m_logOut && m_dictionary)
+    {
+        std::string text;
+        m_dictionary->decode(data, len, text);
+        fputs(text.c_str(), m_logOut);
+    }
+}
+
+/* "!ID=%d,STATE=%d,...", see DoorHandler::Response::format() */
+bool Collector::parseHeartbeat(const char* text, size_t len, TelemetryStatus& status)
+{
+    TelemetryStatus parsed = status;
+    uint16_t        fields = 0;
+    size_t          pos    = 1;
+    while(pos < len)
+    {
+        size_t keyStart = pos;
+        while(pos < len && text[pos] != '=') pos++;
+        if(pos >= len) return false;
+        size_t keyLength = pos - keyStart;
+
+        /* Values are all integers, strtol stops at the ',' */
+        char  number[12];
+        size_t valueLength = 0;
+        for(pos++; pos < len && text[pos] != ',' && valueLength < sizeof(number) - 1; pos++) number[valueLength++] = text[pos];
+        number[valueLength] = 0;
+        if(valueLength == 0) return false;
+        long value = strtol(number, nullptr, 10);
+        pos++;
+
+        const char* key = text + keyStart;
+        #define HEARTBEAT_KEY(name) (keyLength == sizeof(name) - 1 && memcmp(key, name, keyLength) == 0)
+        if     (HEARTBEAT_KEY("ID"))      parsed.id                  = value;
+        else if(HEARTBEAT_KEY("STATE"))   parsed.state               = value;
+        else if(HEARTBEAT_KEY("MTR_POS")) parsed.motorPosition       = value;
+        else if(HEARTBEAT_KEY("TOPPOS"))  parsed.motorTopPosition    = value;
+        else if(HEARTBEAT_KEY("UL"))      parsed.lightUpperThreshold = value;
+        else if(HEARTBEAT_KEY("LL"))      parsed.lightLowerThreshold = value;
+        else if(HEARTBEAT_KEY("LIT"))     parsed.currentLight        = value;
+        else if(HEARTBEAT_KEY("MTRTIME")) parsed.motorMoveTime       = value;
+        else if(HEARTBEAT_KEY("OPEN"))    parsed.openingMinute       = value;
+        else if(HEARTBEAT_KEY("C+OFF"))   parsed.closingMinute       = value;
+        else if(HEARTBEAT_KEY("MOFF"))    parsed.minuteOffset        = value;
+        else if(HEARTBEAT_KEY("MOTION"))  parsed.motionState         = value;
+        else if(HEARTBEAT_KEY("AUTO"))    parsed.flags = value ? parsed.flags | TELEMETRY_FLAG_AUTOMATED   : parsed.flags & ~TELEMETRY_FLAG_AUTOMATED;
+        else if(HEARTBEAT_KEY("LDR"))     parsed.flags = value ? parsed.flags | TELEMETRY_FLAG_LDR         : parsed.flags & ~TELEMETRY_FLAG_LDR;
+        else if(HEARTBEAT_KEY("TIME"))    parsed.flags = value ? parsed.flags | TELEMETRY_FLAG_TIME        : parsed.flags & ~TELEMETRY_FLAG_TIME;
+        else if(HEARTBEAT_KEY("MTRSAVE")) parsed.flags = value ? parsed.flags | TELEMETRY_FLAG_MOTOR_SAVED : parsed.flags & ~TELEMETRY_FLAG_MOTOR_SAVED;
+        else continue; // CLOSE is derived, newer firmware may add more
+        #undef HEARTBEAT_KEY
+        fields++;
+    }
+    if(fields == 0) return false;
+
+    status = parsed;
+    return true;
+}
+
+void Collector::makeReply(Reply& reply, const Endpoint& to, const char* format, unsigned value, unsigned value2)
+{
+    reply.to     = to;
+    reply.length = snprintf(reply.data, REPLY_LENGTH, format, value, value2);
+}
@@ -0,0 +1,83 @@
+#ifndef COLLECTOR
+#define COLLECTOR 1
+
+#include "DoorTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+class LogDictionary;
+class DoorView;
+
+#define REPLY_LENGTH    16
+
+/* Something to send back to a door, an event ACK or a keyframe request */
+struct Reply{
+    Endpoint to;
+    char     data[REPLY_LENGTH];
+    uint8_t  length;
+};
+
+struct CollectorStats{
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t heartbeats;    // Text, full and delta
+    uint64_t events;        // First delivery of a reliable event
+    uint64_t duplicates;    // Retransmits of events already seen
+    uint64_t restarts;      // Events from a door under a new epoch
+    uint64_t replies;       // "R:" answers to commands
+    uint64_t logs;
+    uint64_t malformed;
+};
+
+/* Everything a door sends to TARGET:UDP_PORT, independent of how the
+   datagrams arrive so a capture can be replayed through it as is.
+
+   "(ID:n)-!ID=...,STATE=..."       text heartbeat
+   "(ID:n)-E<seq>,<epoch>:...DM:x"  reliable event, ACKed with
+                                    "A<seq>,<epoch>", see ReliableChannel
+   "(ID:n)-R:..."                   reply to a command
+   "(ID:n)-..."                     text log, possibly several lines
+   TELEMETRY_MAGIC                  full binary heartbeat
+   TELEMETRY_DELTA_MAGIC            delta heartbeat, answered with 'k' if
+                                    the collector has no keyframe for it
+   LOG_WIRE_MAGIC                   binary log                        */
+class Collector{
+
+    public:
+
+        /* With a view, every door touched is published to it as 'shard' */
+        Collector(const LogDictionary* dictionary = nullptr, FILE* logOut = nullptr,
+                  DoorView* view = nullptr, uint8_t shard = 0);
+
+        /* True if reply should be sent */
+        bool                  ingest(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now, Reply& reply);
+
+        const CollectorStats& stats() const     {return m_stats;}
+        DoorTable&            doors()           {return m_doors;}
+
+    private:
+
+        DoorTable      m_doors;
+        CollectorStats m_stats;
+        const LogDictionary* m_dictionary;
+        FILE*          m_logOut;
+        DoorView*      m_view;
+        uint8_t        m_shard;
+        int16_t        m_touched;   // Door the current datagram updated, -1 if none
+
+        /* Delta frames carry no ID, they are matched by sender */
+        std::unordered_map<uint64_t, uint8_t> m_endpoints;
+
+        bool           dispatch(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now, Reply& reply);
+        DoorState&     seen(uint8_t id, const Endpoint& from, uint64_t now);
+        bool           ingestText(uint8_t id, const char* text, size_t len, const Endpoint& from, uint64_t now, Reply& reply);
+        bool           ingestFrame(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now, Reply& reply);
+        void           ingestLog(const uint8_t* data, size_t len, const Endpoint& from, uint64_t now);
+        bool           parseHeartbeat(const char* text, size_t len, TelemetryStatus& status);
+        static void    makeReply(Reply& reply, const Endpoint& to, const char* format, unsigned value, unsigned value2 = 0);
+        static uint64_t key(const Endpoint& endpoint) {return (uint64_t)endpoint.address << 16 | endpoint.port;}
+
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "DoorTable.h"
+#include <cstring>
+
+DoorState::DoorState()
+: lastSeen(0),
+  heartbeats(0),
+  events(0),
+  logs(0),
+  restarts(0),
+  epoch(0),
+  doorMoved(DOOR_MOVED_NONE),
+  known(false),
+  haveStatus(false)
+{
+    memset(&status,   0, sizeof(status));
+    memset(&endpoint, 0, sizeof(endpoint));
+}
+
+uint16_t DoorTable::known() const
+{
+    uint16_t count = 0;
+    for(uint16_t id = 0; id < DOOR_COUNT; id++) count += m_doors[id].known;
+    return count;
+}
+
+void DoorTable::dump(FILE* out) const
+{
+    for(uint16_t id = 0; id < DOOR_COUNT; id++)
+    {
+        if(m_doors[id].known) print(out, id, m_doors[id]);
+    }
+}
+
+void DoorTable::print(FILE* out, uint8_t id, const DoorState& door)
+{
+    const TelemetryStatus& s = door.status;
+    fprintf(out, "door %3d %u.%u.%u.%u:%u seen=%llu hb=%u ev=%u log=%u rst=%u DM=%d",
+            id, door.endpoint.address >> 24, (door.endpoint.address >> 16) & 0xFF,
+            (door.endpoint.address >> 8) & 0xFF, door.endpoint.address & 0xFF, door.endpoint.port,
+            (unsigned long long)door.lastSeen, door.heartbeats, door.events, door.logs, door.restarts, door.doorMoved);
+    if(door.haveStatus)
+    {
+        fprintf(out, " STATE=%d MOTION=%d MTR_POS=%d TOPPOS=%d LIT=%d FLAGS=%02x CLOSE=%d OPEN=%d UP=%u",
+                s.state, s.motionState, s.motorPosition, s.motorTopPosition, s.currentLight,
+                s.flags, s.closingMinute, s.openingMinute, s.uptime);
+    }
+    fputc('\n', out);
+}
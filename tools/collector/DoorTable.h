@@ -0,0 +1,56 @@
+#ifndef DOOR_TABLE
+#define DOOR_TABLE 1
+
+#include <Telemetry.h>
+#include <ReliableChannel.h>
+#include <cstdint>
+#include <cstdio>
+
+#define DOOR_COUNT      256     // Door IDs are a single byte
+#define DOOR_MOVED_NONE -1
+
+/* Where a datagram came from, host byte order */
+struct Endpoint{
+    uint32_t address;
+    uint16_t port;
+};
+
+/* Latest known state of a single door */
+struct DoorState{
+    DoorState();
+
+    TelemetryStatus        status;
+    Endpoint               endpoint;    // Where replies, ACKs and 'k' go
+    uint64_t               lastSeen;    // ms, collector clock
+    uint32_t               heartbeats;
+    uint32_t               events;
+    uint32_t               logs;
+    uint32_t               restarts;    // New epochs seen after the first
+    uint16_t               epoch;       // Boot the door's events are from, 0 before epochs
+    int8_t                 doorMoved;   // Last "DM:x", DOOR_MOVED_NONE until one arrives
+    bool                   known;
+    bool                   haveStatus;
+    ReliableReceiver       eventWindow;
+    TelemetryReconstructor telemetry;
+};
+
+/* Flat table indexed by door ID, lookups never allocate */
+class DoorTable{
+
+    public:
+
+        DoorState&       get(uint8_t id)            {return m_doors[id];}
+        const DoorState& get(uint8_t id) const      {return m_doors[id];}
+        uint16_t         known() const;
+
+        /* One line per known door */
+        void             dump(FILE* out) const;
+        static void      print(FILE* out, uint8_t id, const DoorState& door);
+
+    private:
+
+        DoorState m_doors[DOOR_COUNT];
+
+};
+
+#endif
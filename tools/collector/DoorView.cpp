@@ -0,0 +1,79 @@
+#include "DoorView.h"
+#include <cstring>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<DoorState>::value, "DoorState is copied byte wise");
+
+DoorView::DoorView(uint8_t shards)
+: m_slots(new Slot[shards * DOOR_COUNT]),
+  m_shards(shards)
+{
+}
+
+void DoorView::publish(uint8_t shard, uint8_t id, const DoorState& door)
+{
+    Slot&    slot    = m_slots[shard * DOOR_COUNT + id];
+    uint32_t version = slot.version.load(std::memory_order_relaxed);
+
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy((void*)&slot.door, &door, sizeof(DoorState));
+    slot.version.store(version + 2, std::memory_order_release);
+}
+
+void DoorView::copy(const Slot& slot, DoorState& door) const
+{
+    for(;;)
+    {
+        uint32_t before = slot.version.load(std::memory_order_acquire);
+        if(before & 1) continue;
+
+        memcpy((void*)&door, (const void*)&slot.door, sizeof(DoorState));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.version.load(std::memory_order_relaxed) == before) return;
+    }
+}
+
+bool DoorView::read(uint8_t id, DoorState& door) const
+{
+    bool      found = false;
+    DoorState shard;
+    for(uint8_t i = 0; i < m_shards; i++)
+    {
+        copy(m_slots[i * DOOR_COUNT + id], shard);
+        if(!shard.known) continue;
+
+        if(!found)
+        {
+            door  = shard;
+            found = true;
+            continue;
+        }
+
+        uint32_t heartbeats = door.heartbeats + shard.heartbeats;
+        uint32_t events     = door.events + shard.events;
+        uint32_t logs       = door.logs + shard.logs;
+        if(shard.lastSeen > door.lastSeen) door = shard;
+        door.heartbeats = heartbeats;
+        door.events     = events;
+        door.logs       = logs;
+    }
+    return found;
+}
+
+uint16_t DoorView::known() const
+{
+    uint16_t  count = 0;
+    DoorState door;
+    for(uint16_t id = 0; id < DOOR_COUNT; id++) count += read(id, door);
+    return count;
+}
+
+void DoorView::dump(FILE* out) const
+{
+    DoorState door;
+    for(uint16_t id = 0; id < DOOR_COUNT; id++)
+    {
+        if(read(id, door)) DoorTable::print(out, id, door);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef DOOR_VIEW
+#define DOOR_VIEW 1
+
+#include "DoorTable.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+/* Read side of a sharded collector. Every ingest thread owns one shard
+   and publishes the doors it touches here; readers merge the shards
+   without ever blocking the writers. Each slot is a seqlock, a reader
+   that catches a slot mid-write simply copies it again.              */
+class DoorView{
+
+    public:
+
+        DoorView(uint8_t shards);
+
+        /* Only ever called by the thread owning the shard */
+        void     publish(uint8_t shard, uint8_t id, const DoorState& door);
+
+        /* Latest state across every shard, counters summed. A door
+           normally lives in one shard, it only moves if its address
+           changes. False if no shard has seen it.                   */
+        bool     read(uint8_t id, DoorState& door) const;
+        uint16_t known() const;
+        void     dump(FILE* out) const;
+
+    private:
+
+        struct Slot{
+            std::atomic<uint32_t> version;  // Odd whilst being written
+            DoorState             door;
+
+            Slot() : version(0) {}
+        };
+
+        std::unique_ptr<Slot[]> m_slots;    // shard * DOOR_COUNT + id
+        uint8_t                 m_shards;
+
+        void     copy(const Slot& slot, DoorState& door) const;
+
+};
+
+#endif
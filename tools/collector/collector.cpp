@@ -0,0 +1,588 @@
+/* collector - receives everything the doors send to TARGET:UDP_PORT.
+
+   Usage: collector [options]
+     --port N          listen on N (default 3333)
+     --batch N         datagrams per recvmmsg (default 64)
+     --dictionary F    decode binary logs with F, see tools/log_dictionary.py
+     --logs            print events and logs as they arrive
+     --table N         print the door table every N seconds
+     --capture F       append every received datagram to F
+     --replay F        ingest capture F offline, as fast as possible
+     --send F          send capture F to --to host:port instead
+     --to HOST:PORT    destination for --send (default 127.0.0.1:3333)
+     --loops N         passes over the capture for --replay and --send
+     --threads N       ingest threads, each with its own SO_REUSEPORT
+                       socket and shard of the door table (default 1)
+     --bench N         received pkt/s with 1, 2, 4 ... N ingest threads,
+                       loading --port from --send F on loopback
+     --senders N       load generating threads for --bench (default 4)
+     --seconds N       measuring time per --bench round (default 5)
+
+   Capture format, repeated: u32 address, u16 port, u16 length, data.
+   All little-endian, address and port as seen by the collector.      */
+#include "Collector.h"
+#include "DoorView.h"
+#include "../logdecode/LogDictionary.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_PORT    3333
+#define MAX_BATCH       1024
+#define MAX_DATAGRAM    1500
+#define STATS_PERIOD    1000    // ms between ingest rate reports
+#define BENCH_SOCKETS   16      // Source ports per --bench sender
+
+struct Options{
+    uint16_t    port        = DEFAULT_PORT;
+    unsigned    batch       = 64;
+    unsigned    table       = 0;
+    unsigned    loops       = 1;
+    unsigned    threads     = 1;
+    unsigned    bench       = 0;
+    unsigned    senders     = 4;
+    unsigned    seconds     = 5;
+    bool        logs        = false;
+    std::string dictionary;
+    std::string capture;
+    std::string replay;
+    std::string send;
+    std::string to          = "127.0.0.1:3333";
+};
+
+struct Datagram{
+    Endpoint             from;
+    std::vector<uint8_t> data;
+};
+
+static uint64_t nowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* Fills record with one capture entry, returns its length */
+static size_t captureRecord(uint8_t* record, const Endpoint& from, const uint8_t* data, uint16_t len)
+{
+    uint8_t header[8] = {(uint8_t)from.address, (uint8_t)(from.address >> 8), (uint8_t)(from.address >> 16), (uint8_t)(from.address >> 24),
+                         (uint8_t)from.port, (uint8_t)(from.port >> 8), (uint8_t)len, (uint8_t)(len >> 8)};
+    memcpy(record, header, sizeof(header));
+    memcpy(record + sizeof(header), data, len);
+    return sizeof(header) + len;
+}
+
+static bool readCapture(const std::string& path, std::vector<Datagram>& datagrams)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == nullptr) return false;
+
+    uint8_t header[8];
+    while(fread(header, 1, sizeof(header), file) == sizeof(header))
+    {
+        Datagram datagram;
+        datagram.from.address = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+        datagram.from.port    = header[4] | header[5] << 8;
+        datagram.data.resize(header[6] | header[7] << 8);
+        if(fread(datagram.data.data(), 1, datagram.data.size(), file) != datagram.data.size()) break;
+        datagrams.push_back(std::move(datagram));
+    }
+    fclose(file);
+    return true;
+}
+
+static void report(const CollectorStats& stats, const CollectorStats& last, uint64_t elapsed, uint16_t doors)
+{
+    double seconds = elapsed / 1000.0;
+    fprintf(stderr, "collector: %.0f pkt/s %.2f MB/s doors=%u hb=%llu ev=%llu dup=%llu rst=%llu log=%llu bad=%llu\n",
+            (stats.packets - last.packets) / seconds, (stats.bytes - last.bytes) / seconds / 1e6, doors,
+            (unsigned long long)stats.heartbeats, (unsigned long long)stats.events, (unsigned long long)stats.duplicates,
+            (unsigned long long)stats.restarts, (unsigned long long)stats.logs, (unsigned long long)stats.malformed);
+}
+
+/* Offline, measures the parser and table on their own */
+static int replay(const Options& options, Collector& collector)
+{
+    std::vector<Datagram> datagrams;
+    if(!readCapture(options.replay, datagrams) || datagrams.empty())
+    {
+        fprintf(stderr, "collector: can't read capture %s\n", options.replay.c_str());
+        return 1;
+    }
+
+    CollectorStats before = collector.stats();
+    uint64_t       replies = 0;
+    auto           start   = std::chrono::steady_clock::now();
+    for(unsigned loop = 0; loop < options.loops; loop++)
+    {
+        for(const Datagram& datagram : datagrams)
+        {
+            Reply reply;
+            replies += collector.ingest(datagram.data.data(), datagram.data.size(), datagram.from, nowMs(), reply);
+        }
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    report(collector.stats(), before, elapsed > 0 ? elapsed : 1, collector.doors().known());
+    fprintf(stderr, "collector: replayed %zu datagrams x %u in %.1f ms, %llu replies\n",
+            datagrams.size(), options.loops, elapsed, (unsigned long long)replies);
+    if(options.table) collector.doors().dump(stdout);
+    return 0;
+}
+
+static bool parseEndpoint(const std::string& text, sockaddr_in& address)
+{
+    size_t colon = text.rfind(':');
+    if(colon == std::string::npos) return false;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port   = htons(atoi(text.c_str() + colon + 1));
+    return inet_pton(AF_INET, text.substr(0, colon).c_str(), &address.sin_addr) == 1;
+}
+
+/* Plays a capture at a live collector, in sendmmsg batches */
+static int send(const Options& options)
+{
+    std::vector<Datagram> datagrams;
+    sockaddr_in           target;
+    if(!readCapture(options.send, datagrams) || datagrams.empty() || !parseEndpoint(options.to, target))
+    {
+        fprintf(stderr, "collector: can't send %s to %s\n", options.send.c_str(), options.to.c_str());
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0 || connect(sock, (sockaddr*)&target, sizeof(target)) < 0)
+    {
+        perror("collector: connect");
+        return 1;
+    }
+
+    std::vector<mmsghdr> messages(options.batch);
+    std::vector<iovec>   vectors(options.batch);
+    uint64_t             sent  = 0;
+    auto                 start = std::chrono::steady_clock::now();
+    for(unsigned loop = 0; loop < options.loops; loop++)
+    {
+        for(size_t first = 0; first < datagrams.size(); )
+        {
+            unsigned count = 0;
+            for(; count < options.batch && first + count < datagrams.size(); count++)
+            {
+                const Datagram& datagram = datagrams[first + count];
+                vectors[count].iov_base = (void*)datagram.data.data();
+                vectors[count].iov_len  = datagram.data.size();
+                memset(&messages[count], 0, sizeof(mmsghdr));
+                messages[count].msg_hdr.msg_iov    = &vectors[count];
+                messages[count].msg_hdr.msg_iovlen = 1;
+            }
+            int result = sendmmsg(sock, messages.data(), count, 0);
+            if(result < 0)
+            {
+                perror("collector: sendmmsg");
+                close(sock);
+                return 1;
+            }
+            first += result;
+            sent  += result;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "collector: sent %llu datagrams in %.2f s, %.0f pkt/s\n",
+            (unsigned long long)sent, elapsed, sent / (elapsed > 0 ? elapsed : 1));
+    close(sock);
+    return 0;
+}
+
+static int openSocket(uint16_t port, bool reusePort)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0)
+    {
+        perror("collector: socket");
+        return -1;
+    }
+
+    int enable = 1;
+    if(reusePort && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+    {
+        perror("collector: SO_REUSEPORT");
+        close(sock);
+        return -1;
+    }
+
+    int buffer = 8 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+
+    /* Wake up now and then so a stop request is noticed when it's quiet */
+    timeval timeout = {0, STATS_PERIOD * 1000 / 4};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port        = htons(port);
+    if(bind(sock, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+        perror("collector: bind");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/* One per ingest thread, owns its socket and its shard of the doors.
+   The kernel spreads SO_REUSEPORT traffic by sender address, so a
+   door keeps landing on the same worker and so in the same shard.  */
+struct Worker{
+    int                   sock;
+    unsigned              batch;
+    Collector*            collector;
+    FILE*                 capture;
+    std::atomic<bool>*    stop;
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> bytes;
+
+    Worker() : sock(-1), batch(0), collector(nullptr), capture(nullptr), stop(nullptr), packets(0), bytes(0) {}
+};
+
+static void pin(std::thread& thread, unsigned index)
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    if(cores == 0) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+}
+
+/* recvmmsg in batches, with the replies going back in one sendmmsg */
+static void receive(Worker& worker)
+{
+    unsigned                  batch = worker.batch;
+    std::vector<uint8_t>      buffers(batch * MAX_DATAGRAM);
+    std::vector<iovec>        vectors(batch);
+    std::vector<sockaddr_in>  sources(batch);
+    std::vector<mmsghdr>      messages(batch);
+    std::vector<Reply>        replies(batch);
+    std::vector<sockaddr_in>  destinations(batch);
+    std::vector<iovec>        replyVectors(batch);
+    std::vector<mmsghdr>      replyMessages(batch);
+    uint8_t                   record[8 + MAX_DATAGRAM];
+
+    while(!worker.stop->load(std::memory_order_relaxed))
+    {
+        for(unsigned i = 0; i < batch; i++)
+        {
+            vectors[i].iov_base = &buffers[i * MAX_DATAGRAM];
+            vectors[i].iov_len  = MAX_DATAGRAM;
+            memset(&messages[i], 0, sizeof(mmsghdr));
+            messages[i].msg_hdr.msg_iov     = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen  = 1;
+            messages[i].msg_hdr.msg_name    = &sources[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+
+        int received = recvmmsg(worker.sock, messages.data(), batch, MSG_WAITFORONE, nullptr);
+        if(received <= 0) continue;
+        uint64_t now   = nowMs();
+        uint64_t bytes = 0;
+
+        unsigned replyCount = 0;
+        for(int i = 0; i < received; i++)
+        {
+            Endpoint from = {ntohl(sources[i].sin_addr.s_addr), ntohs(sources[i].sin_port)};
+            const uint8_t* data = &buffers[i * MAX_DATAGRAM];
+            uint16_t       len  = messages[i].msg_len;
+            bytes += len;
+
+            /* A single fwrite, so records from different workers never interleave */
+            if(worker.capture) fwrite(record, 1, captureRecord(record, from, data, len), worker.capture);
+            if(!worker.collector->ingest(data, len, from, now, replies[replyCount])) continue;
+
+            Reply& reply = replies[replyCount];
+            memset(&destinations[replyCount], 0, sizeof(sockaddr_in));
+            destinations[replyCount].sin_family      = AF_INET;
+            destinations[replyCount].sin_addr.s_addr = htonl(reply.to.address);
+            destinations[replyCount].sin_port        = htons(reply.to.port);
+            replyVectors[replyCount].iov_base = reply.data;
+            replyVectors[replyCount].iov_len  = reply.length;
+            memset(&replyMessages[replyCount], 0, sizeof(mmsghdr));
+            replyMessages[replyCount].msg_hdr.msg_iov     = &replyVectors[replyCount];
+            replyMessages[replyCount].msg_hdr.msg_iovlen  = 1;
+            replyMessages[replyCount].msg_hdr.msg_name    = &destinations[replyCount];
+            replyMessages[replyCount].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            replyCount++;
+        }
+        if(replyCount > 0) sendmmsg(worker.sock, replyMessages.data(), replyCount, 0);
+
+        worker.packets.fetch_add(received, std::memory_order_relaxed);
+        worker.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+/* Starts 'threads' workers on the port, each with its own socket and shard */
+static bool startWorkers(const Options& options, unsigned threads, const LogDictionary* dictionary, DoorView& view,
+                         FILE* capture, std::atomic<bool>& stop, std::vector<std::unique_ptr<Worker>>& workers,
+                         std::vector<std::unique_ptr<Collector>>& collectors, std::vector<std::thread>& running)
+{
+    for(unsigned i = 0; i < threads; i++)
+    {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->sock = openSocket(options.port, threads > 1);
+        if(worker->sock < 0) return false;
+
+        collectors.emplace_back(new Collector(dictionary, options.logs ? stdout : nullptr, &view, i));
+        worker->batch     = options.batch;
+        worker->collector = collectors.back().get();
+        worker->capture   = capture;
+        worker->stop      = &stop;
+        workers.push_back(std::move(worker));
+    }
+
+    /* Only once every socket is bound, so the kernel spreads from the first datagram */
+    for(unsigned i = 0; i < threads; i++)
+    {
+        running.emplace_back(receive, std::ref(*workers[i]));
+        pin(running.back(), i);
+    }
+    return true;
+}
+
+static void stopWorkers(std::atomic<bool>& stop, std::vector<std::unique_ptr<Worker>>& workers, std::vector<std::thread>& running)
+{
+    stop = true;
+    for(std::thread& thread : running) thread.join();
+    for(std::unique_ptr<Worker>& worker : workers) if(worker->sock >= 0) close(worker->sock);
+}
+
+static uint64_t totalPackets(const std::vector<std::unique_ptr<Worker>>& workers, uint64_t* bytes = nullptr)
+{
+    uint64_t packets = 0;
+    if(bytes) *bytes = 0;
+    for(const std::unique_ptr<Worker>& worker : workers)
+    {
+        packets += worker->packets.load(std::memory_order_relaxed);
+        if(bytes) *bytes += worker->bytes.load(std::memory_order_relaxed);
+    }
+    return packets;
+}
+
+static int listen(const Options& options, const LogDictionary* dictionary)
+{
+    FILE* capture = nullptr;
+    if(!options.capture.empty() && (capture = fopen(options.capture.c_str(), "ab")) == nullptr)
+    {
+        perror("collector: capture");
+        return 1;
+    }
+
+    DoorView                                view(options.threads);
+    std::atomic<bool>                       stop(false);
+    std::vector<std::unique_ptr<Worker>>    workers;
+    std::vector<std::unique_ptr<Collector>> collectors;
+    std::vector<std::thread>                running;
+    if(!startWorkers(options, options.threads, dictionary, view, capture, stop, workers, collectors, running))
+    {
+        stopWorkers(stop, workers, running);
+        return 1;
+    }
+
+    /* Reporting only ever reads, through the view and the worker counters */
+    uint64_t lastBytes   = 0;
+    uint64_t lastPackets = 0;
+    uint64_t lastReport  = nowMs();
+    uint64_t lastTable   = lastReport;
+    for(;;)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(STATS_PERIOD));
+
+        uint64_t now     = nowMs();
+        uint64_t bytes   = 0;
+        uint64_t packets = totalPackets(workers, &bytes);
+        double   seconds = (now - lastReport) / 1000.0;
+        fprintf(stderr, "collector: %.0f pkt/s %.2f MB/s doors=%u threads=%u\n",
+                (packets - lastPackets) / seconds, (bytes - lastBytes) / seconds / 1e6, view.known(), options.threads);
+        lastPackets = packets;
+        lastBytes   = bytes;
+        lastReport  = now;
+        if(capture) fflush(capture);
+
+        if(options.table && now - lastTable >= options.table * 1000ull)
+        {
+            view.dump(stdout);
+            fflush(stdout);
+            lastTable = now;
+        }
+    }
+}
+
+/* Each door keeps one source port, like a real door, so the kernel
+   always hands it to the same worker. perSocket[s] is every datagram
+   sent from socket s, in capture order.                             */
+static void blast(const std::vector<std::vector<const Datagram*>>& perSocket, const sockaddr_in& target, unsigned batch,
+                  std::atomic<bool>& stop, std::atomic<uint64_t>& sent)
+{
+    std::vector<int>     socks(perSocket.size());
+    std::vector<size_t>  next(perSocket.size(), 0);
+    std::vector<mmsghdr> messages(batch);
+    std::vector<iovec>   vectors(batch);
+    for(size_t s = 0; s < socks.size(); s++)
+    {
+        socks[s] = socket(AF_INET, SOCK_DGRAM, 0);
+        connect(socks[s], (const sockaddr*)&target, sizeof(target));
+    }
+
+    while(!stop.load(std::memory_order_relaxed))
+    {
+        for(size_t s = 0; s < socks.size(); s++)
+        {
+            const std::vector<const Datagram*>& datagrams = perSocket[s];
+            if(datagrams.empty()) continue;
+
+            for(unsigned i = 0; i < batch; i++, next[s] = (next[s] + 1) % datagrams.size())
+            {
+                const Datagram* datagram = datagrams[next[s]];
+                vectors[i].iov_base = (void*)datagram->data.data();
+                vectors[i].iov_len  = datagram->data.size();
+                memset(&messages[i], 0, sizeof(mmsghdr));
+                messages[i].msg_hdr.msg_iov    = &vectors[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int result = sendmmsg(socks[s], messages.data(), batch, 0);
+            if(result > 0) sent.fetch_add(result, std::memory_order_relaxed);
+        }
+    }
+    for(int sock : socks) close(sock);
+}
+
+/* Received pkt/s for 1, 2, 4 ... options.bench ingest threads */
+static int bench(const Options& options)
+{
+    std::vector<Datagram> datagrams;
+    if(!readCapture(options.send, datagrams) || datagrams.empty())
+    {
+        fprintf(stderr, "collector: --bench needs a capture, --send F\n");
+        return 1;
+    }
+
+    sockaddr_in target;
+    parseEndpoint("127.0.0.1:" + std::to_string(options.port), target);
+
+    double base = 0;
+    fprintf(stderr, "threads  received pkt/s  sent pkt/s  speedup  efficiency\n");
+    for(unsigned threads = 1; threads <= options.bench; threads *= 2)
+    {
+        /* Same senders for every round, only the ingest side changes */
+        std::vector<std::vector<std::vector<const Datagram*>>> shares(options.senders);
+        for(auto& share : shares) share.resize(BENCH_SOCKETS);
+        for(const Datagram& datagram : datagrams)
+        {
+            uint32_t door = datagram.from.address;
+            shares[door % options.senders][door / options.senders % BENCH_SOCKETS].push_back(&datagram);
+        }
+
+        DoorView                                view(threads);
+        std::atomic<bool>                       stop(false);
+        std::atomic<bool>                       stopSenders(false);
+        std::atomic<uint64_t>                   sent(0);
+        std::vector<std::unique_ptr<Worker>>    workers;
+        std::vector<std::unique_ptr<Collector>> collectors;
+        std::vector<std::thread>                running;
+        std::vector<std::thread>                senders;
+        if(!startWorkers(options, threads, nullptr, view, nullptr, stop, workers, collectors, running))
+        {
+            stopWorkers(stop, workers, running);
+            return 1;
+        }
+        for(unsigned i = 0; i < options.senders; i++)
+        {
+            senders.emplace_back(blast, std::cref(shares[i]), std::cref(target), options.batch, std::ref(stopSenders), std::ref(sent));
+        }
+
+        /* Skip the first second, sockets and caches are still warming up */
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t startReceived = totalPackets(workers);
+        uint64_t startSent     = sent.load();
+        auto     start         = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+        double   elapsed       = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double   received      = (totalPackets(workers) - startReceived) / elapsed;
+        double   offered       = (sent.load() - startSent) / elapsed;
+
+        stopSenders = true;
+        for(std::thread& thread : senders) thread.join();
+        stopWorkers(stop, workers, running);
+
+        if(threads == 1) base = received;
+        fprintf(stderr, "%7u  %14.0f  %10.0f  %7.2f  %9.0f%%\n", threads, received, offered,
+                received / base, 100.0 * received / base / threads);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg  = argv[i];
+        bool        more = i + 1 < argc;
+        if     (arg == "--port"       && more) options.port       = atoi(argv[++i]);
+        else if(arg == "--batch"      && more) options.batch      = atoi(argv[++i]);
+        else if(arg == "--table"      && more) options.table      = atoi(argv[++i]);
+        else if(arg == "--loops"      && more) options.loops      = atoi(argv[++i]);
+        else if(arg == "--threads"    && more) options.threads    = atoi(argv[++i]);
+        else if(arg == "--bench"      && more) options.bench      = atoi(argv[++i]);
+        else if(arg == "--senders"    && more) options.senders    = atoi(argv[++i]);
+        else if(arg == "--seconds"    && more) options.seconds    = atoi(argv[++i]);
+        else if(arg == "--dictionary" && more) options.dictionary = argv[++i];
+        else if(arg == "--capture"    && more) options.capture    = argv[++i];
+        else if(arg == "--replay"     && more) options.replay     = argv[++i];
+        else if(arg == "--send"       && more) options.send       = argv[++i];
+        else if(arg == "--to"         && more) options.to         = argv[++i];
+        else if(arg == "--logs")               options.logs       = true;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--port N] [--batch N] [--threads N] [--dictionary F] [--logs] [--table N]\n"
+                            "       [--capture F | --replay F | --send F [--to HOST:PORT]] [--loops N]\n"
+                            "       --bench N --send F [--senders N] [--seconds N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(options.batch == 0 || options.batch > MAX_BATCH) options.batch = 64;
+    if(options.loops == 0) options.loops = 1;
+    if(options.threads == 0 || options.threads > 255) options.threads = 1;
+    if(options.senders == 0) options.senders = 1;
+    if(options.seconds == 0) options.seconds = 1;
+
+    if(options.bench)         return bench(options);
+    if(!options.send.empty()) return send(options);
+
+    LogDictionary dictionary;
+    if(!options.dictionary.empty() && !dictionary.load(options.dictionary))
+    {
+        fprintf(stderr, "collector: can't load dictionary %s\n", options.dictionary.c_str());
+        return 1;
+    }
+    const LogDictionary* decoder = options.dictionary.empty() ? nullptr : &dictionary;
+
+    if(options.replay.empty()) return listen(options, decoder);
+
+/* Large, the door table holds a reconstructor per door */
+    static Collector collector(decoder, options.logs ? stdout : nullptr);
+    return replay(options, collector);
+}
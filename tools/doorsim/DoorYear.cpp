@@ -0,0 +1,137 @@
+#include "DoorYear.h"
+#include <cstring>
+
+DoorYear::DoorYear(const DoorSettings& settings, time_t start, uint32_t seed)
+: m_board(seed, start),
+  m_door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN),
+  m_settings(settings),
+  m_valid(false),
+  m_state(SIM_CLOSED),
+  m_accounted(0),
+  m_lastDecision(0),
+  m_lastOpen(false)
+{
+    /* Same bring up as setup(), on a blank EEPROM */
+    VirtualBoard::select(&m_board);
+    m_door.loadSettings();
+    m_door.configureNTP();
+
+    /* The setters refuse thresholds closer than MIN_DIFF_IN_LIGHT,
+       so the upper goes out of the way first for any lower to fit. */
+    m_door.beginBatch();
+    m_door.setLightUpperThreshold(254);
+    m_door.setLightLowerThreshold(settings.lower);
+    m_door.setLightUpperThreshold(settings.upper);
+    m_door.setDoorCloseTime(settings.offset);
+    m_door.setLDREnabled(settings.ldr);
+    m_door.setTimeEnabled(settings.time);
+    m_door.endBatch();
+
+    /* As the door took them, a setter may still have refused one */
+    m_settings.upper  = m_door.getLightUpperThreshold();
+    m_settings.lower  = m_door.getLightLowerThreshold();
+    m_settings.offset = m_door.getOpenTime();
+    m_settings.ldr    = m_door.ldrEnabled();
+    m_settings.time   = m_door.timeEnabled();
+    m_valid = m_settings.upper == settings.upper && m_settings.lower == settings.lower &&
+              m_settings.offset == settings.offset && m_settings.ldr == settings.ldr && m_settings.time == settings.time;
+
+    m_state = classify();
+    VirtualBoard::select(nullptr);
+}
+
+void DoorYear::run(uint32_t days, YearResult& result, bool keepDecisions)
+{
+    memset(result.stateMs, 0, sizeof(result.stateMs));
+    result.simulatedMs   = 0;
+    result.openDarkMs    = 0;
+    result.closedLightMs = 0;
+    result.opens         = 0;
+    result.closes        = 0;
+    result.flaps         = 0;
+    result.polls         = 0;
+    result.decisions.clear();
+
+    VirtualBoard::select(&m_board);
+    uint64_t start    = m_board.now();
+    uint64_t end      = start + days * 86400000ull;
+    uint64_t nextPoll = start;
+    m_accounted       = start;
+
+    while(nextPoll < end)
+    {
+        m_board.advanceTo(nextPoll);
+        account(result);
+
+        bool wasClosed = m_door.isClosed();
+        result.polls++;
+        if(m_door.poll())
+        {
+            decide(wasClosed, result, keepDecisions);
+
+            /* poll() does nothing until the motion has settled */
+            while(m_door.update())
+            {
+                account(result);
+                for(uint32_t ms = 0; ms < MOTION_PERIOD; ms += DOOR_CONTROL_PERIOD/1000)
+                {
+                    m_board.advance(DOOR_CONTROL_PERIOD/1000);
+                    m_door.control();
+                }
+            }
+        }
+        account(result);
+
+        /* Back onto the polling grid, skipping polls lost to the move */
+        nextPoll += POLLING_PERIOD;
+        if(nextPoll < m_board.now()) nextPoll += (m_board.now() - nextPoll + POLLING_PERIOD - 1) / POLLING_PERIOD * POLLING_PERIOD;
+    }
+    m_board.advanceTo(end);
+    account(result);
+
+    result.simulatedMs = m_board.now() - start;
+    VirtualBoard::select(nullptr);
+}
+
+uint8_t DoorYear::classify()
+{
+    uint8_t motion = m_door.getMotionState();
+    if(motion == MOTION_STARTING || motion == MOTION_TRAVELLING) return SIM_MOVING;
+    if(m_door.isClosed()) return SIM_CLOSED;
+    if(m_door.isOpen())   return SIM_OPEN;
+    return SIM_UNKNOWN;
+}
+
+/* Charges the time since the last call to the state the door was in */
+void DoorYear::account(YearResult& result)
+{
+    uint64_t now  = m_board.now();
+    uint64_t span = now - m_accounted;
+    if(span)
+    {
+        result.stateMs[m_state] += span;
+
+        if(m_state == SIM_OPEN || m_state == SIM_CLOSED)
+        {
+            double elevation = VirtualBoard::solarElevation(m_board.epoch());
+            if(m_state == SIM_OPEN   && elevation < SIM_DARK_ELEVATION)  result.openDarkMs    += span;
+            if(m_state == SIM_CLOSED && elevation > SIM_LIGHT_ELEVATION) result.closedLightMs += span;
+        }
+    }
+    m_accounted = now;
+    m_state     = classify();
+}
+
+void DoorYear::decide(bool open, YearResult& result, bool keep)
+{
+    time_t epoch = m_board.epoch();
+    if(result.opens + result.closes > 0 && m_lastOpen != open && epoch - m_lastDecision < SIM_FLAP_WINDOW) result.flaps++;
+    m_lastDecision = epoch;
+    m_lastOpen     = open;
+
+    if(open) result.opens++;
+    else     result.closes++;
+
+    if(keep) result.decisions.push_back({epoch, open, (uint8_t)(m_board.light() / 16),
+                                         (float)VirtualBoard::solarElevation(epoch)});
+}
@@ -0,0 +1,87 @@
+#ifndef DOOR_YEAR
+#define DOOR_YEAR 1
+
+#include <VirtualBoard.h>
+#include <DoorHandler.h>
+#include <DoorTask.h> // POLLING_PERIOD and MOTION_PERIOD, the firmware's own
+#include <stdint.h>
+#include <vector>
+
+#define SIM_DARK_ELEVATION  -6.0    // Degrees, civil dusk, predators about
+#define SIM_LIGHT_ELEVATION 6.0     // Degrees, hens want out
+#define SIM_FLAP_WINDOW     1800    // Seconds, a reversal sooner than this is a flap
+
+/* Door states the time is split between */
+#define SIM_CLOSED          0
+#define SIM_OPEN            1
+#define SIM_MOVING          2
+#define SIM_UNKNOWN         3
+#define SIM_STATES          4
+
+/* What is tuned, everything else stays at the flash() defaults */
+struct DoorSettings{
+    uint8_t upper;          // m_lightUpperThreshold
+    uint8_t lower;          // m_lightLowerThreshold
+    int16_t offset;         // m_minuteOffset
+    bool    ldr;
+    bool    time;
+};
+
+/* One open or close started by poll() */
+struct Decision{
+    time_t  epoch;          // UTC
+    bool    open;
+    uint8_t light;          // As poll() sees it, 0-255
+    float   elevation;      // Sun, degrees
+};
+
+struct YearResult{
+    uint64_t simulatedMs;
+    uint64_t stateMs[SIM_STATES];
+    uint64_t openDarkMs;    // Open with the sun below SIM_DARK_ELEVATION
+    uint64_t closedLightMs; // Closed with the sun above SIM_LIGHT_ELEVATION
+    uint32_t opens;
+    uint32_t closes;
+    uint32_t flaps;
+    uint64_t polls;
+    std::vector<Decision> decisions;
+};
+
+/* A single DoorHandler on a VirtualBoard, run poll by poll with the
+   clock jumping straight to the next deadline. Motion is stepped at
+   MOTION_PERIOD like the door task does, and the position loop every
+   DOOR_CONTROL_PERIOD like its timer, so a move takes as long as it
+   does on the real door.                                        */
+class DoorYear{
+
+    public:
+
+        DoorYear(const DoorSettings& settings, time_t start, uint32_t seed);
+
+        void setLight(VirtualBoard::LightModel model, void* context) {m_board.setLight(model, context);}
+
+        /* The settings the door took, false from valid() if not all asked for */
+        const DoorSettings& settings() const {return m_settings;}
+        bool                valid() const    {return m_valid;}
+
+        /* Decisions are only kept when asked for, sweeps don't need them */
+        void run(uint32_t days, YearResult& result, bool keepDecisions = false);
+
+    private:
+
+        VirtualBoard m_board;
+        DoorHandler  m_door;
+        DoorSettings m_settings;
+        bool         m_valid;
+        uint8_t      m_state;
+        uint64_t     m_accounted;
+        time_t       m_lastDecision;    // For spotting flaps
+        bool         m_lastOpen;
+
+        uint8_t      classify();
+        void         account(YearResult& result);
+        void         decide(bool open, YearResult& result, bool keep);
+
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "LightTrace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool LightTrace::load(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if(file == nullptr) return false;
+
+    m_samples.clear();
+    char line[128];
+    while(fgets(line, sizeof(line), file))
+    {
+        char* hash = strchr(line, '#');
+        if(hash) *hash = '\0';
+        for(char* c = line; *c; c++) if(*c == ',') *c = ' ';
+
+        long long time;
+        int       value;
+        if(sscanf(line, "%lld %d", &time, &value) != 2) continue;
+        if(value < 0) value = 0;
+        if(value > BOARD_ADC_MAX) value = BOARD_ADC_MAX;
+        m_samples.push_back({(time_t)time, (uint16_t)value});
+    }
+    fclose(file);
+
+    std::stable_sort(m_samples.begin(), m_samples.end(),
+                     [](const Sample& a, const Sample& b){return a.time < b.time;});
+    return !m_samples.empty();
+}
+
+uint16_t LightTrace::at(time_t utc) const
+{
+    if(m_samples.empty())            return 0;
+    if(utc <= m_samples.front().time) return m_samples.front().value;
+    if(utc >= m_samples.back().time)  return m_samples.back().value;
+
+    auto after = std::upper_bound(m_samples.begin(), m_samples.end(), utc,
+                                  [](time_t t, const Sample& s){return t < s.time;});
+    const Sample& a = after[-1];
+    const Sample& b = after[0];
+    return a.value + (int32_t)(b.value - a.value) * (utc - a.time) / (b.time - a.time);
+}
+
+uint16_t LightTrace::model(VirtualBoard& board, void* context)
+{
+    return static_cast<const LightTrace*>(context)->at(board.epoch());
+}
+
+uint16_t Overcast::model(VirtualBoard& board, void* context)
+{
+    const Overcast* sky = static_cast<const Overcast*>(context);
+
+    /* Same cloud all day, hashed from the day so every board agrees */
+    uint32_t day = (uint32_t)(board.epoch() / 86400) * 2654435761u ^ sky->seed;
+    day ^= day >> 15;
+    day *= 2246822519u;
+    day ^= day >> 13;
+    double cloud = (day & 0xFFFF) / 65536.0;
+
+    return VirtualBoard::daylight(board, nullptr) * (1.0 - sky->depth * cloud * cloud);
+}
@@ -0,0 +1,47 @@
+#ifndef LIGHT_TRACE
+#define LIGHT_TRACE 1
+
+#include <VirtualBoard.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+/* Recorded light on the LDR, one "unix_time adc" pair per line
+   (comma or space separated, '#' comments). Readings in between
+   are interpolated, outside the recording the ends are held.    */
+class LightTrace{
+
+    public:
+
+        bool     load(const char* path);
+
+        time_t   start() const  {return m_samples.empty() ? 0 : m_samples.front().time;}
+        time_t   end() const    {return m_samples.empty() ? 0 : m_samples.back().time;}
+        size_t   size() const   {return m_samples.size();}
+
+        uint16_t at(time_t utc) const;
+
+        /* VirtualBoard::LightModel, context is the LightTrace */
+        static uint16_t model(VirtualBoard& board, void* context);
+
+    private:
+
+        struct Sample{
+            time_t   time;
+            uint16_t value;
+        };
+        std::vector<Sample> m_samples;
+
+};
+
+/* The default daylight dimmed by a random overcast, changing daily.
+   Depth 0 is a clear sky every day, 1 can be all but dark at noon. */
+struct Overcast{
+    uint32_t seed;
+    double   depth;
+
+    /* VirtualBoard::LightModel, context is the Overcast */
+    static uint16_t model(VirtualBoard& board, void* context);
+};
+
+#endif
@@ -0,0 +1,129 @@
+/* doorsim - a year of the door in a few seconds.
+
+   Usage: doorsim [options]
+     --days N          simulated days (default 365)
+     --start DATE      first day, YYYY-MM-DD (default 2024-03-20, or the trace start)
+     --upper N         m_lightUpperThreshold (default 37)
+     --lower N         m_lightLowerThreshold (default 25)
+     --offset N        m_minuteOffset, minutes after sunset (default 0)
+     --mode M          time, ldr or both (default time)
+     --overcast D      daily random cloud, 0 clear to 1 dark (default 0)
+     --trace FILE      recorded "unix_time adc" light instead of the model
+     --seed N          sensor noise and cloud (default 1)
+     --events          print every open and close
+
+   The real DoorHandler::poll() runs every 5 s of simulated time on a
+   VirtualBoard (tools/host), the LDR seeing the modelled or recorded
+   light and getLocalTime() the simulated clock.                     */
+#include "DoorYear.h"
+#include "LightTrace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static bool parseDate(const char* text, time_t& epoch)
+{
+    struct tm date;
+    memset(&date, 0, sizeof(date));
+    if(strptime(text, "%Y-%m-%d", &date) == nullptr) return false;
+    epoch = timegm(&date);
+    return true;
+}
+
+static double hours(uint64_t ms)
+{
+    return ms / 3600000.0;
+}
+
+static void printDecision(const Decision& decision)
+{
+    struct tm utc;
+    gmtime_r(&decision.epoch, &utc);
+    printf("%04d-%02d-%02d %02d:%02d UTC  %-5s  light %3d  sun %6.1f\n", utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+           utc.tm_hour, utc.tm_min, decision.open ? "open" : "close", decision.light, decision.elevation);
+}
+
+int main(int argc, char** argv)
+{
+    DoorSettings settings = {37, 25, 0, false, true};
+    uint32_t     days     = 365;
+    time_t       start    = 0;
+    uint32_t     seed     = 1;
+    double       overcast = 0;
+    const char*  trace    = nullptr;
+    bool         events   = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg  = argv[i];
+        bool        more = i + 1 < argc;
+        if     (arg == "--days"     && more) days            = atoi(argv[++i]);
+        else if(arg == "--upper"    && more) settings.upper  = atoi(argv[++i]);
+        else if(arg == "--lower"    && more) settings.lower  = atoi(argv[++i]);
+        else if(arg == "--offset"   && more) settings.offset = atoi(argv[++i]);
+        else if(arg == "--overcast" && more) overcast        = atof(argv[++i]);
+        else if(arg == "--trace"    && more) trace           = argv[++i];
+        else if(arg == "--seed"     && more) seed            = strtoul(argv[++i], nullptr, 0);
+        else if(arg == "--events")           events          = true;
+        else if(arg == "--start"    && more && parseDate(argv[i + 1], start)) i++;
+        else if(arg == "--mode"     && more)
+        {
+            std::string mode = argv[++i];
+            settings.ldr  = mode == "ldr"  || mode == "both";
+            settings.time = mode == "time" || mode == "both";
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--days N] [--start YYYY-MM-DD] [--upper N] [--lower N] [--offset N]\n"
+                            "       [--mode time|ldr|both] [--overcast D] [--trace FILE] [--seed N] [--events]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(!settings.ldr && !settings.time)
+    {
+        fprintf(stderr, "doorsim: mode must be time, ldr or both\n");
+        return 2;
+    }
+
+    LightTrace recorded;
+    Overcast   sky = {seed, overcast};
+    if(trace && !recorded.load(trace))
+    {
+        fprintf(stderr, "doorsim: no samples in %s\n", trace);
+        return 1;
+    }
+    if(start == 0) start = trace ? recorded.start() / 86400 * 86400 : BOARD_EPOCH;
+
+    DoorYear year(settings, start, seed);
+    if(!year.valid())
+    {
+        const DoorSettings& took = year.settings();
+        fprintf(stderr, "doorsim: the door took upper %d lower %d offset %d, not upper %d lower %d offset %d\n",
+                took.upper, took.lower, took.offset, settings.upper, settings.lower, settings.offset);
+        return 1;
+    }
+    if(trace)         year.setLight(LightTrace::model, &recorded);
+    else if(overcast) year.setLight(Overcast::model, &sky);
+
+    YearResult result;
+    auto wallStart = std::chrono::steady_clock::now();
+    year.run(days, result, events);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    if(events) for(const Decision& decision : result.decisions) printDecision(decision);
+
+    double total = result.simulatedMs ? (double)result.simulatedMs : 1;
+    printf("settings        upper %d lower %d offset %d ldr %d time %d\n", settings.upper, settings.lower,
+           settings.offset, settings.ldr, settings.time);
+    printf("closed          %8.1f h  %5.1f%%\n", hours(result.stateMs[SIM_CLOSED]), 100 * result.stateMs[SIM_CLOSED] / total);
+    printf("open            %8.1f h  %5.1f%%\n", hours(result.stateMs[SIM_OPEN]),   100 * result.stateMs[SIM_OPEN]   / total);
+    printf("moving          %8.1f h  %5.1f%%\n", hours(result.stateMs[SIM_MOVING]), 100 * result.stateMs[SIM_MOVING] / total);
+    printf("opens/closes    %u / %u, %u flaps\n", result.opens, result.closes, result.flaps);
+    printf("open after dark %.0f min\n", result.openDarkMs / 60000.0);
+    printf("shut in daylight %.0f min\n", result.closedLightMs / 60000.0);
+    printf("speed           %u days in %.2f s, %.0f simulated days/s, %.0f ns/poll\n", days, wall, days / wall,
+           wall * 1e9 / (result.polls ? result.polls : 1));
+    return 0;
+}
@@ -0,0 +1,73 @@
+/* eepromconv - upgrades an EEPROM image to the current layout.
+
+   Usage: eepromconv IN [OUT]
+
+   IN is the raw EEPROM, byte 0 first, as read back from a door. It
+   is loaded into a VirtualBoard (tools/host) and the real
+   DoorHandler::loadSettings() migrates it exactly as the firmware
+   would on its first boot. The settings are printed and, given OUT,
+   the upgraded image is written there. A blank image is refused
+   rather than flashed with defaults and a new ID.                  */
+#include <Arduino.h>
+#include <DoorHandler.h>
+#include <VirtualBoard.h>
+#include <cstdio>
+#include <cstring>
+
+#define LAYOUT_ADDRESS  11      // EEPROM_LAYOUT in DoorHandler.cpp
+
+int main(int argc, char** argv)
+{
+    if(argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: %s IN [OUT]\n", argv[0]);
+        return 2;
+    }
+
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+
+    FILE* in = fopen(argv[1], "rb");
+    if(!in)
+    {
+        fprintf(stderr, "eepromconv: can't read %s\n", argv[1]);
+        return 1;
+    }
+    size_t length = fread(board.eeprom(), 1, BOARD_EEPROM_SIZE, in);
+    fclose(in);
+
+    if(length == 0 || board.eeprom()[0] == 255)
+    {
+        fprintf(stderr, "eepromconv: %s is blank, nothing to convert\n", argv[1]);
+        return 1;
+    }
+
+    uint8_t from = board.eeprom()[LAYOUT_ADDRESS];
+
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+
+    const PositionGains& gains = door.getGains();
+    printf("layout    %d -> %d\n", from, board.eeprom()[LAYOUT_ADDRESS]);
+    printf("id        %d\n", door.getID());
+    printf("position  %d counts, top %d counts\n", door.getPosition(), door.getTopPosition());
+    printf("light     upper %d lower %d, close offset %d min\n",
+           door.getLightUpperThreshold(), door.getLightLowerThreshold(), door.getOpenTime());
+    printf("motor     travel %d accel %d decel %d x100ms, profile %d\n",
+           door.getMotorMoveTime(), door.getMotorAccelTime(), door.getMotorDecelTime(), door.getMotorProfile());
+    printf("gains     kp %.3f ki %.3f kd %.3f kff %.3f\n", gains.kp, gains.ki, gains.kd, gains.kff);
+    printf("travel    up %dms %d counts/s, down %dms %d counts/s, 0 uncalibrated\n",
+           door.getTravelTime(true), door.getMotorSpeed(true), door.getTravelTime(false), door.getMotorSpeed(false));
+
+    if(argc < 3) return 0;
+
+    FILE* out = fopen(argv[2], "wb");
+    if(!out || fwrite(board.eeprom(), 1, BOARD_EEPROM_SIZE, out) != BOARD_EEPROM_SIZE)
+    {
+        fprintf(stderr, "eepromconv: can't write %s\n", argv[2]);
+        if(out) fclose(out);
+        return 1;
+    }
+    fclose(out);
+    return 0;
+}
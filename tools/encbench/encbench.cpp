@@ -0,0 +1,388 @@
+/* encbench - checks and times the encoder backends on the host.
+
+   Usage: encbench pcnt [steps]
+          encbench decode [edges]
+          encbench reads [edges]
+          encbench samples
+     pcnt      PcntEncoder against the modelled pulse counter (tools/host),
+               a random walk with glitches through several overflows,
+               read() checked after every step against the expected count,
+               a quarter of the steps with the limit interrupt held off
+               as a critical section or a slow ISR would
+     decode    Encoder::update()'s delta table against the switch it
+               replaced, every one of the 16 transitions then a random
+               run, and the edge rate of each
+     reads     one thread turning the encoder forwards through its
+               handler, another calling read(); every read must lie
+               between the counts published either side of it
+     samples   edge timestamps on the simulated clock: velocity at a
+               steady rate, acceleration as the rate doubles, and
+               sinceLastEdge once the encoder stops
+
+   Exits non-zero on the first mismatch.                             */
+#include <Encoder.h>
+#include <PcntEncoder.h>
+#include <PcntFake.h>
+#include <soc/pcnt_struct.h>
+#include <VirtualBoard.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define PIN1            34
+#define PIN2            36
+
+/* Encoder.h's forward direction, as (pin1, pin2) levels */
+static const uint8_t quadrature[4][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+
+static uint32_t seed = 1;
+static uint32_t next()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* Encoder::update() as it was, C switch for non-AVR */
+static void updateSwitch(Encoder_internal_state_t *arg)
+{
+    uint8_t p1val = DIRECT_PIN_READ(arg->pin1_register, arg->pin1_bitmask);
+    uint8_t p2val = DIRECT_PIN_READ(arg->pin2_register, arg->pin2_bitmask);
+    uint8_t state = arg->state & 3;
+    if (p1val) state |= 4;
+    if (p2val) state |= 8;
+    arg->state = (state >> 2);
+    switch (state) {
+        case 1: case 7: case 8: case 14:
+            arg->position++;
+            return;
+        case 2: case 4: case 11: case 13:
+            arg->position--;
+            return;
+        case 3: case 12:
+            arg->position += 2;
+            return;
+        case 6: case 9:
+            arg->position -= 2;
+            return;
+    }
+}
+
+static void setPins(uint8_t pins)
+{
+    hostGpioDrive(PIN1, pins & 1);
+    hostGpioDrive(PIN2, (pins >> 1) & 1);
+}
+
+static void decoderState(Encoder_internal_state_t& state)
+{
+    state.pin1_register = PIN_TO_BASEREG(PIN1);
+    state.pin1_bitmask  = PIN_TO_BITMASK(PIN1);
+    state.pin2_register = PIN_TO_BASEREG(PIN2);
+    state.pin2_bitmask  = PIN_TO_BITMASK(PIN2);
+    state.state         = 0;
+    state.position      = 0;
+}
+
+/* Edges per second through one decoder over a recorded pin sequence */
+static double edgeRate(void (*decode)(Encoder_internal_state_t*), const std::vector<uint8_t>& pins, int32_t& position)
+{
+    Encoder_internal_state_t state;
+    decoderState(state);
+    volatile uint32_t& bank = hostGpioIn[digitalPinToPort(PIN1)];
+    uint32_t mask1 = digitalPinToBitMask(PIN1), mask2 = digitalPinToBitMask(PIN2);
+    uint32_t others = bank & ~(mask1 | mask2);
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint8_t p : pins)
+    {
+        bank = others | (p & 1 ? mask1 : 0) | (p & 2 ? mask2 : 0);
+        decode(&state);
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    position = state.position;
+    return pins.size() / wall;
+}
+
+static int benchDecode(uint64_t edges)
+{
+    /* Every old state against every new pin pair */
+    for(uint8_t old = 0; old < 4; old++)
+        for(uint8_t pins = 0; pins < 4; pins++)
+        {
+            Encoder_internal_state_t table, reference;
+            decoderState(table);
+            decoderState(reference);
+            table.state = reference.state = old;
+            setPins(pins);
+            Encoder::update(&table);
+            updateSwitch(&reference);
+            if(table.position != reference.position || table.state != reference.state)
+            {
+                fprintf(stderr, "encbench: decode state %d gives %+d/%d, switch %+d/%d\n", old | pins << 2,
+                        table.position, table.state, reference.position, reference.state);
+                return 1;
+            }
+        }
+
+    /* Mostly legal steps, some skipped ones to exercise the +/-2 guesses */
+    std::vector<uint8_t> pins(edges);
+    uint8_t phase = 0;
+    for(uint64_t i = 0; i < edges; i++)
+    {
+        uint32_t r = next();
+        phase = (phase + (r % 16 == 0 ? 2 : (r & 16) ? 1 : 3)) & 3;
+        pins[i] = quadrature[phase][0] | quadrature[phase][1] << 1;
+    }
+
+    int32_t tablePosition, switchPosition;
+    double  switchRate = edgeRate(updateSwitch, pins, switchPosition);
+    double  tableRate  = edgeRate(Encoder::update, pins, tablePosition);
+    if(tablePosition != switchPosition)
+    {
+        fprintf(stderr, "encbench: decode ended at %d, switch at %d\n", tablePosition, switchPosition);
+        return 1;
+    }
+
+    /* The whole path, pin change to attached handler to update() */
+    Encoder encoder(PIN1, PIN2);
+    encoder.write(0);
+    auto start = std::chrono::steady_clock::now();
+    for(uint8_t p : pins) setPins(p);
+    double isrRate = pins.size() / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("decode          16/16 transitions match, %llu edges end at %d on both\n", (unsigned long long)edges, tablePosition);
+    printf("switch          %6.1f Medges/s  %5.2f ns/edge\n", switchRate / 1e6, 1e9 / switchRate);
+    printf("table           %6.1f Medges/s  %5.2f ns/edge\n", tableRate / 1e6, 1e9 / tableRate);
+    printf("isr path        %6.1f Medges/s  %5.2f ns/edge\n", isrRate / 1e6, 1e9 / isrRate);
+    return 0;
+}
+
+static int benchReads(uint64_t edges)
+{
+    /* Start just short of a carry out of the low half word, tearing
+       there would show up as a read 65536 out.                    */
+    const int32_t start = 0xFFF0;
+
+    setPins(0);
+    Encoder encoder(PIN1, PIN2);
+    encoder.write(start);
+
+    /* Uncontended cost first */
+    const uint64_t reads = 20000000;
+    volatile int32_t sink;
+    auto begin = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < reads; i++) sink = encoder.read();
+    (void)sink;
+    double idleNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / reads;
+
+    std::atomic<int32_t> published(start);
+    std::atomic<bool>    running(true);
+    uint64_t             checked = 0, changes = 0;
+    int32_t              failed  = 0, low = 0, high = 0;
+    double               busyNs  = 0;
+
+    std::thread reader([&]
+    {
+        int32_t last = start;
+        auto    from = std::chrono::steady_clock::now();
+        while(running.load(std::memory_order_relaxed))
+        {
+            int32_t before   = published.load(std::memory_order_acquire);
+            int32_t position = encoder.read();
+            int32_t after    = published.load(std::memory_order_acquire);
+
+            /* The writer may be one edge past what it has published */
+            if(position < before || position > after + 1 || position < last)
+            {
+                failed = position;
+                low    = before;
+                high   = after;
+                break;
+            }
+            if(position != last) changes++;
+            last = position;
+            checked++;
+        }
+        busyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - from).count() / checked;
+    });
+
+    /* Forwards only, one edge at a time, through the attached handler */
+    uint8_t phase = 0;
+    for(uint64_t i = 0; i < edges && !failed; i++)
+    {
+        phase = (phase + 1) & 3;
+        setPins(quadrature[phase][0] | quadrature[phase][1] << 1);
+        published.store(start + (int32_t)(i + 1), std::memory_order_release);
+    }
+    running = false;
+    reader.join();
+
+    if(failed)
+    {
+        fprintf(stderr, "encbench: reads saw %d between published %d and %d\n", failed, low, high);
+        return 1;
+    }
+
+    printf("reads           %llu checked, %llu saw a new count, final %d of %d, %llu 16-bit carries\n",
+           (unsigned long long)checked, (unsigned long long)changes, encoder.read(), start + (int32_t)edges,
+           (unsigned long long)((start + edges) >> 16));
+    printf("read()          %5.2f ns alone, %5.2f ns against the writer\n", idleNs, busyNs);
+    return 0;
+}
+
+static int benchSamples()
+{
+    setPins(0);
+    Encoder encoder(PIN1, PIN2);
+    encoder.write(0);
+
+    if(encoder.sinceLastEdge() != ENCODER_NO_EDGE || encoder.velocity() != 0)
+    {
+        fprintf(stderr, "encbench: samples before the first edge\n");
+        return 1;
+    }
+
+    /* An edge every 2ms is 500 counts/s, then every 1ms */
+    uint8_t phase = 0;
+    auto turn = [&](int edges, unsigned long ms)
+    {
+        for(int i = 0; i < edges; i++)
+        {
+            delay(ms);
+            phase = (phase + 1) & 3;
+            setPins(quadrature[phase][0] | quadrature[phase][1] << 1);
+        }
+    };
+
+    turn(20, 2);
+    int32_t steady = encoder.velocity(), still = encoder.acceleration();
+    turn(ENCODER_SAMPLE_COUNT / 2, 1);
+    int32_t speeding = encoder.acceleration();
+    turn(ENCODER_SAMPLE_COUNT, 1);
+    int32_t fast = encoder.velocity();
+    delay(100);
+    uint32_t since = encoder.sinceLastEdge();
+
+    if(steady != 500 || still != 0 || speeding <= 0 || fast != 1000 || since != 100000)
+    {
+        fprintf(stderr, "encbench: samples gave %d counts/s, %d and %d counts/s/s, %d counts/s, %uus since\n",
+                steady, still, speeding, fast, since);
+        return 1;
+    }
+
+    const uint64_t reads = 5000000;
+    volatile int32_t sink;
+    auto begin = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < reads; i++) sink = encoder.velocity();
+    (void)sink;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / reads;
+
+    printf("samples         %d then %d counts/s, %d counts/s/s between, %uus after the last edge\n",
+           steady, fast, speeding, since);
+    printf("velocity()      %5.2f ns\n", ns);
+    return 0;
+}
+
+static int benchPcnt(uint64_t steps)
+{
+    pcntFakeReset();
+    PcntEncoder encoder(PIN1, PIN2);
+    encoder.write(0);
+
+    uint64_t filterNs = (uint64_t)(PCNT_ENCODER_FILTER * PCNT_FAKE_APB_NS);
+    uint64_t now      = 1000;
+    uint8_t  phase    = 0;
+    int32_t  expected = 0;
+    uint64_t glitches = 0;
+    uint64_t pending  = 0;
+    int      bias     = 1;
+
+    pcntFakeDrive(PIN1, 0, now);
+    pcntFakeDrive(PIN2, 0, now);
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < steps; i++)
+    {
+        /* Long runs one way so the count crosses both limits */
+        if(i % 50000 == 0) bias = (next() & 1) ? 1 : -1;
+        int direction = (next() % 8) ? bias : -bias;
+
+        /* A spike on either pin shorter than the filter, it must not count */
+        if(next() % 16 == 0)
+        {
+            int     pin   = next() & 1 ? PIN1 : PIN2;
+            uint8_t level = quadrature[phase][pin == PIN1 ? 0 : 1];
+            pcntFakeDrive(pin, !level, now);
+            uint64_t width = 1 + next() % (filterNs - 1);
+            now += width;
+            pcntFakeSettle(now);
+            if(encoder.read() != expected)
+            {
+                fprintf(stderr, "encbench: pcnt step %llu counted a %llu ns glitch\n", (unsigned long long)i,
+                        (unsigned long long)width);
+                return 1;
+            }
+            pcntFakeDrive(pin, level, now);
+            now += 1;
+            glitches++;
+        }
+
+        /* The counter may reset at a limit with its carry still to come */
+        bool hold = next() % 4 == 0;
+        pcntFakeHoldInterrupts(hold);
+
+        uint8_t target = (phase + direction) & 3;
+        int     pin    = quadrature[phase][0] != quadrature[target][0] ? PIN1 : PIN2;
+        pcntFakeDrive(pin, quadrature[target][pin == PIN1 ? 0 : 1], now);
+        now += filterNs + next() % (4 * filterNs);
+        pcntFakeSettle(now);
+
+        phase     = target;
+        expected += direction;
+
+        int32_t position = encoder.read();
+        bool    carrying = hold && (PCNT.int_raw.val & 1);
+        if(carrying && next() % 2) encoder.write(expected);
+        pcntFakeHoldInterrupts(false);
+        if(position != expected || encoder.read() != expected)
+        {
+            fprintf(stderr, "encbench: pcnt step %llu read %d then %d, expected %d (counter %d%s)\n",
+                    (unsigned long long)i, position, encoder.read(), expected, pcntFakeCounter(PCNT_UNIT_0),
+                    carrying ? ", carry pending" : "");
+            return 1;
+        }
+        pending += carrying;
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("pcnt            %llu steps, %llu glitches filtered, %u limit interrupts, final %d, %.1f Msteps/s\n",
+           (unsigned long long)steps, (unsigned long long)glitches, pcntFakeInterrupts(PCNT_UNIT_0), expected,
+           steps / wall / 1e6);
+    printf("                %llu reads with the carry still pending\n", (unsigned long long)pending);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode  = argc > 1 ? argv[1] : "";
+    uint64_t    count = argc > 2 ? strtoull(argv[2], nullptr, 0) : 0;
+
+    /* micros() for the edge timestamps comes from the simulated clock */
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+
+    if(mode == "pcnt")   return benchPcnt(count ? count : 2000000);
+    if(mode == "decode") return benchDecode(count ? count : 50000000);
+    if(mode == "reads")  return benchReads(count ? count : 20000000);
+    if(mode == "samples") return benchSamples();
+
+    fprintf(stderr, "Usage: %s pcnt [steps] | decode [edges] | reads [edges] | samples\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,103 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "VirtualBoard.h"
+
+HostSerial  Serial;
+HostEsp     ESP;
+EEPROMClass EEPROM;
+
+/* 32-bit like the ESP32's, so long runs see millis() wrap at 49.7 days */
+unsigned long millis()
+{
+    return (uint32_t)VirtualBoard::current().now();
+}
+
+unsigned long micros()
+{
+    return (uint32_t)(VirtualBoard::current().now() * 1000);
+}
+
+/* Nothing waits, simulated time just moves on */
+void delay(unsigned long ms)
+{
+    VirtualBoard::current().advance(ms);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    VirtualBoard::current().write(pin, value);
+}
+
+int digitalRead(uint8_t pin)
+{
+    return VirtualBoard::current().read(pin);
+}
+
+uint16_t analogRead(uint8_t pin)
+{
+    return pin == BOARD_LDR_PIN ? VirtualBoard::current().light() : 0;
+}
+
+double ledcSetup(uint8_t channel, double frequency, uint8_t bits)
+{
+    VirtualBoard::current().setupPwm(channel, bits);
+    return frequency;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel)
+{
+    VirtualBoard::current().attachPwm(pin, channel);
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty)
+{
+    VirtualBoard::current().writePwm(channel, duty);
+}
+
+long random(long min, long max)
+{
+    if(max <= min) return min;
+    return min + (long)(VirtualBoard::current().random() % (unsigned long)(max - min));
+}
+
+void randomSeed(unsigned long seed)
+{
+    VirtualBoard::current().seed(seed);
+}
+
+bool getLocalTime(struct tm* info, uint32_t ms)
+{
+    return VirtualBoard::current().localTime(*info);
+}
+
+void configTime(long gmtOffset, int daylightOffset, const char* server1, const char* server2, const char* server3)
+{
+    VirtualBoard::current().configureTime(gmtOffset, daylightOffset);
+}
+
+void HostEsp::restart()
+{
+    fprintf(stderr, "VirtualBoard: ESP.restart() is not simulated\n");
+    abort();
+}
+
+bool EEPROMClass::begin(size_t size)
+{
+    return size <= BOARD_EEPROM_SIZE;
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+    return address >= 0 && address < BOARD_EEPROM_SIZE ? VirtualBoard::current().eeprom()[address] : 0;
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+    if(address >= 0 && address < BOARD_EEPROM_SIZE) VirtualBoard::current().eeprom()[address] = value;
+}
+
+bool EEPROMClass::commit()
+{
+    VirtualBoard::current().commit();
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef HOST_ARDUINO
+#define HOST_ARDUINO 1
+
+/* Just enough of the Arduino core for the door libraries to build on
+   Linux. Every call acts on the VirtualBoard selected on the calling
+   thread, so one process can run any number of simulated doors.     */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define CHANGE          3
+#define PI              3.1415926535897932384626433832795
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+/* FreeRTOS critical sections, the modelled peripherals run their
+   handlers in line so there is nothing to hold off               */
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)     ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)      ((void)(mux))
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+
+void          pinMode(uint8_t pin, uint8_t mode);
+void          digitalWrite(uint8_t pin, uint8_t value);
+int           digitalRead(uint8_t pin);
+uint16_t      analogRead(uint8_t pin);
+
+/* LEDC PWM, only the motor pins do anything with it */
+double        ledcSetup(uint8_t channel, double frequency, uint8_t bits);
+void          ledcAttachPin(uint8_t pin, uint8_t channel);
+void          ledcWrite(uint8_t channel, uint32_t duty);
+
+/* GPIO input registers, two 32-bit banks as on the ESP32, see Gpio.cpp.
+   hostGpioDrive() sets a pin and runs whatever is attached to it.   */
+extern volatile uint32_t hostGpioIn[2];
+#define digitalPinToPort(pin)       ((pin) > 31 ? 1 : 0)
+#define digitalPinToBitMask(pin)    (1UL << ((pin) > 31 ? (pin) - 32 : (pin)))
+#define portInputRegister(port)     (&hostGpioIn[port])
+#define digitalPinToInterrupt(pin)  (pin)
+
+void          attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void          detachInterrupt(uint8_t pin);
+void          noInterrupts();
+void          interrupts();
+void          hostGpioDrive(uint8_t pin, uint8_t level);
+
+long          random(long min, long max);
+void          randomSeed(unsigned long seed);
+
+bool          getLocalTime(struct tm* info, uint32_t ms = 5000);
+void          configTime(long gmtOffset, int daylightOffset, const char* server1,
+                         const char* server2 = nullptr, const char* server3 = nullptr);
+
+/* Output is discarded, simulated doors are silent */
+struct HostSerial{
+    void   begin(unsigned long) {}
+    template <typename T> size_t print(T)   {return 0;}
+    template <typename T> size_t println(T) {return 0;}
+    size_t println()                        {return 0;}
+    size_t write(uint8_t)                   {return 1;}
+    size_t write(const uint8_t*, size_t len){return len;}
+};
+extern HostSerial Serial;
+
+struct HostEsp{
+    void restart();
+};
+extern HostEsp ESP;
+
+#endif
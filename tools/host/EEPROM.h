@@ -0,0 +1,36 @@
+#ifndef HOST_EEPROM
+#define HOST_EEPROM 1
+
+#include <Arduino.h>
+
+/* Reads and writes the selected VirtualBoard's EEPROM image */
+class EEPROMClass{
+
+    public:
+
+        bool    begin(size_t size);
+        uint8_t read(int address);
+        void    write(int address, uint8_t value);
+        bool    commit();
+
+        template <typename T>
+        T&      get(int address, T& value)
+        {
+            uint8_t* bytes = (uint8_t*)&value;
+            for(size_t i = 0; i < sizeof(T); i++) bytes[i] = read(address + i);
+            return value;
+        }
+
+        template <typename T>
+        const T& put(int address, const T& value)
+        {
+            const uint8_t* bytes = (const uint8_t*)&value;
+            for(size_t i = 0; i < sizeof(T); i++) write(address + i, bytes[i]);
+            return value;
+        }
+
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
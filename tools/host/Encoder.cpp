@@ -0,0 +1,25 @@
+#include <Encoder.h>
+#include "VirtualBoard.h"
+
+/* Kept apart from Arduino.cpp so lib/Encoder itself can be linked
+   against the rest of the host core, see encbench.               */
+
+int32_t Encoder::read()
+{
+    return VirtualBoard::current().encoder();
+}
+
+void Encoder::write(int32_t position)
+{
+    VirtualBoard::current().setEncoder(position);
+}
+
+int32_t Encoder::velocity()
+{
+    return VirtualBoard::current().velocity();
+}
+
+uint32_t Encoder::sinceLastEdge()
+{
+    return VirtualBoard::current().sinceEncoderEdge() * 1000;
+}
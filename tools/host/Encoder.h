@@ -0,0 +1,25 @@
+#ifndef HOST_ENCODER
+#define HOST_ENCODER 1
+
+#include <Arduino.h>
+
+/* Stands in for lib/Encoder, the count comes from the selected
+   VirtualBoard's motor model rather than pin interrupts.       */
+class Encoder{
+
+    public:
+
+        Encoder(uint8_t pin1, uint8_t pin2) {}
+
+        int32_t  read();
+        int32_t  sample()       {return read();}
+        void     write(int32_t position);
+
+        /* From the motor model, which runs at a constant speed */
+        int32_t  velocity();
+        int32_t  acceleration() {return 0;}
+        uint32_t sinceLastEdge();
+
+};
+
+#endif
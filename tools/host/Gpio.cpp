@@ -0,0 +1,60 @@
+#include <Arduino.h>
+
+#define HOST_GPIOS  40
+
+volatile uint32_t hostGpioIn[2];
+
+static void (*handlers[HOST_GPIOS])(void);
+static bool     masked  = false;
+static uint64_t pending = 0;   // Edges that came in whilst masked
+
+/* Called from constructors before a board may be selected */
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void delayMicroseconds(unsigned int us)
+{
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+    if(pin < HOST_GPIOS) handlers[pin] = handler;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    if(pin < HOST_GPIOS) handlers[pin] = nullptr;
+}
+
+/* Only one thread drives pins, masking just holds the handlers back
+   until interrupts() like a pending interrupt on the chip.         */
+void noInterrupts()
+{
+    masked = true;
+}
+
+void interrupts()
+{
+    masked = false;
+    for(uint8_t pin = 0; pending; pin++)
+    {
+        if(!(pending & (1ull << pin))) continue;
+        pending &= ~(1ull << pin);
+        if(handlers[pin]) handlers[pin]();
+    }
+}
+
+void hostGpioDrive(uint8_t pin, uint8_t level)
+{
+    if(pin >= HOST_GPIOS) return;
+
+    uint32_t bit     = digitalPinToBitMask(pin);
+    uint32_t current = hostGpioIn[digitalPinToPort(pin)];
+    uint32_t next    = level ? current | bit : current & ~bit;
+    if(next == current) return;
+
+    hostGpioIn[digitalPinToPort(pin)] = next;
+    if(masked)             pending |= 1ull << pin;
+    else if(handlers[pin]) handlers[pin]();
+}
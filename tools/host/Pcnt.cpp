@@ -0,0 +1,278 @@
+#include <driver/pcnt.h>
+#include <soc/pcnt_struct.h>
+#include "PcntFake.h"
+#include <string.h>
+
+#define PCNT_FAKE_GPIOS     40
+#define PCNT_FILTER_MAX     1023
+
+/* One input as a unit sees it, after its glitch filter */
+struct FilteredInput{
+    uint8_t  level;
+    uint8_t  pending;
+    bool     changing;
+    uint64_t since;
+};
+
+struct Unit{
+    pcnt_config_t channel[PCNT_CHANNEL_MAX];
+    bool          configured[PCNT_CHANNEL_MAX];
+    int16_t       count;
+    int16_t       highLimit;
+    int16_t       lowLimit;
+    uint16_t      filter;
+    bool          filterEnabled;
+    bool          paused;
+    uint32_t      enabled;
+    uint32_t      interrupts;
+    void        (*handler)(void*);
+    void*         arg;
+    FilteredInput input[PCNT_FAKE_GPIOS];
+};
+
+static Unit units[PCNT_UNIT_MAX];
+static bool held = false;
+
+pcnt_dev_t PCNT;
+
+static bool uses(const Unit& unit, int gpio)
+{
+    for(int c = 0; c < PCNT_CHANNEL_MAX; c++)
+    {
+        if(!unit.configured[c]) continue;
+        if(unit.channel[c].pulse_gpio_num == gpio || unit.channel[c].ctrl_gpio_num == gpio) return true;
+    }
+    return false;
+}
+
+/* The ISR service, clears each raised interrupt then runs its handler */
+static void service()
+{
+    for(int u = 0; u < PCNT_UNIT_MAX; u++)
+    {
+        if(!(PCNT.int_raw.val & (1UL << u))) continue;
+        PCNT.int_raw.val &= ~(1UL << u);
+        if(units[u].handler == nullptr) continue;
+        units[u].interrupts++;
+        units[u].handler(units[u].arg);
+    }
+}
+
+/* Only enabled events latch and interrupt. The ISR runs straight away
+   unless held, on the real chip it is microseconds later.           */
+static void raise(Unit& unit, uint32_t event)
+{
+    if(!(unit.enabled & event)) return;
+    int u = &unit - units;
+    PCNT.status_unit[u].val = event;
+    PCNT.int_raw.val       |= 1UL << u;
+    if(!held) service();
+}
+
+/* One filtered edge, through every channel it is the pulse input of */
+static void edge(Unit& unit, int gpio, uint8_t level)
+{
+    for(int c = 0; c < PCNT_CHANNEL_MAX; c++)
+    {
+        const pcnt_config_t& ch = unit.channel[c];
+        if(!unit.configured[c] || ch.pulse_gpio_num != gpio || unit.paused) continue;
+
+        uint8_t control = ch.ctrl_gpio_num < 0 ? 1 : unit.input[ch.ctrl_gpio_num].level;
+        int     action  = level ? ch.pos_mode : ch.neg_mode;
+        int     mode    = control ? ch.hctrl_mode : ch.lctrl_mode;
+
+        if(mode == PCNT_MODE_DISABLE || action == PCNT_COUNT_DIS) continue;
+        int step = action == PCNT_COUNT_INC ? 1 : -1;
+        if(mode == PCNT_MODE_REVERSE) step = -step;
+
+        unit.count += step;
+        if(unit.count >= unit.highLimit && unit.highLimit > 0)
+        {
+            unit.count = 0;
+            raise(unit, PCNT_EVT_H_LIM);
+        }
+        else if(unit.count <= unit.lowLimit && unit.lowLimit < 0)
+        {
+            unit.count = 0;
+            raise(unit, PCNT_EVT_L_LIM);
+        }
+        else if(unit.count == 0) raise(unit, PCNT_EVT_ZERO);
+    }
+}
+
+/* Changes that have been held for the filter length go through */
+static void settle(Unit& unit, uint64_t ns)
+{
+    uint64_t hold = unit.filterEnabled ? (uint64_t)(unit.filter * PCNT_FAKE_APB_NS) : 0;
+    for(int gpio = 0; gpio < PCNT_FAKE_GPIOS; gpio++)
+    {
+        FilteredInput& in = unit.input[gpio];
+        if(!in.changing || ns - in.since < hold) continue;
+        in.changing = false;
+        in.level    = in.pending;
+        edge(unit, gpio, in.level);
+    }
+}
+
+void pcntFakeSettle(uint64_t ns)
+{
+    for(Unit& unit : units) settle(unit, ns);
+}
+
+void pcntFakeDrive(int gpio, uint8_t level, uint64_t ns)
+{
+    if(gpio < 0 || gpio >= PCNT_FAKE_GPIOS) return;
+    level = level != 0;
+    pcntFakeSettle(ns);
+
+    for(Unit& unit : units)
+    {
+        FilteredInput& in = unit.input[gpio];
+        if(!uses(unit, gpio))
+        {
+            in.level = level;
+            continue;
+        }
+
+        uint8_t heading = in.changing ? in.pending : in.level;
+        if(level == heading) continue;
+
+        /* Back before the filter let it through, the spike never happened */
+        if(in.changing)
+        {
+            in.changing = false;
+            continue;
+        }
+        in.changing = true;
+        in.pending  = level;
+        in.since    = ns;
+        if(!unit.filterEnabled) settle(unit, ns);
+    }
+}
+
+void pcntFakeReset()
+{
+    memset(units, 0, sizeof(units));
+    memset((void*)&PCNT, 0, sizeof(PCNT));
+    held = false;
+}
+
+void pcntFakeHoldInterrupts(bool hold)
+{
+    held = hold;
+    if(!held) service();
+}
+
+int16_t pcntFakeCounter(int unit)
+{
+    return units[unit].count;
+}
+
+uint32_t pcntFakeInterrupts(int unit)
+{
+    return units[unit].interrupts;
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config)
+{
+    if(config->unit >= PCNT_UNIT_MAX || config->channel >= PCNT_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+    if(config->pulse_gpio_num >= PCNT_FAKE_GPIOS || config->ctrl_gpio_num >= PCNT_FAKE_GPIOS) return ESP_ERR_INVALID_ARG;
+
+    Unit& unit = units[config->unit];
+    unit.channel[config->channel]    = *config;
+    unit.configured[config->channel] = true;
+    unit.highLimit = config->counter_h_lim;
+    unit.lowLimit  = config->counter_l_lim;
+    unit.count     = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    *count = units[unit].count;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].paused = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].paused = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].count = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value)
+{
+    if(unit >= PCNT_UNIT_MAX || value > PCNT_FILTER_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].filter = value;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].filterEnabled = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].filterEnabled = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t event)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].enabled |= event;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_disable(pcnt_unit_t unit, pcnt_evt_type_t event)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].enabled &= ~(uint32_t)event;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_event_status(pcnt_unit_t unit, uint32_t* status)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    *status = PCNT.status_unit[unit].val;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*handler)(void* arg), void* arg)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].handler = handler;
+    units[unit].arg     = arg;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit)
+{
+    if(unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+    units[unit].handler = nullptr;
+    return ESP_OK;
+}
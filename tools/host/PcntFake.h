@@ -0,0 +1,27 @@
+#ifndef PCNT_FAKE
+#define PCNT_FAKE 1
+
+#include <stdint.h>
+
+#define PCNT_FAKE_APB_NS    12.5    // One filter tick, the 80MHz APB clock
+
+/* Inputs to the modelled pulse counter. Levels are driven with a time
+   stamp so the glitch filter can tell a pulse from a spike, a change
+   only reaches the counters once it has been held for the filter
+   length (or pcntFakeSettle() says time has moved on far enough).   */
+void     pcntFakeDrive(int gpio, uint8_t level, uint64_t ns);
+void     pcntFakeSettle(uint64_t ns);
+
+/* Every unit back to power on, inputs low */
+void     pcntFakeReset();
+
+/* Whilst held a limit leaves its interrupt raised in PCNT.int_raw, as
+   on the chip in the microseconds before the ISR runs or whilst a
+   critical section holds it off. Releasing runs what was raised.   */
+void     pcntFakeHoldInterrupts(bool hold);
+
+/* Raw register view, for checking against the driver's */
+int16_t  pcntFakeCounter(int unit);
+uint32_t pcntFakeInterrupts(int unit);
+
+#endif
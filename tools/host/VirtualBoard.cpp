@@ -0,0 +1,220 @@
+#include "VirtualBoard.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static thread_local VirtualBoard* s_current = nullptr;
+
+VirtualBoard::VirtualBoard(uint32_t seed, time_t epoch)
+: m_clock(0),
+  m_epoch(epoch),
+  m_timeOffset(0),
+  m_timeSynced(false),
+  m_light(daylight),
+  m_lightContext(nullptr),
+  m_encoder(0),
+  m_position(0),
+  m_velocity(0),
+  m_travel(BOARD_TRAVEL),
+  m_obstacle(0),
+  m_motorSpeed(BOARD_MOTOR_SPEED),
+  m_impactSpeed(0),
+  m_impactTime(0),
+  m_motorUpdated(0),
+  m_motorRunTime(0),
+  m_lastEdge(0),
+  m_commits(0),
+  m_seed(seed ? seed : 1)
+{
+    memset(m_pins, 0, sizeof(m_pins));
+    memset(m_pwmBits, 0, sizeof(m_pwmBits));
+    memset(m_pwmPin, 0xFF, sizeof(m_pwmPin));
+    for(int i = 0; i < BOARD_PINS; i++) m_drive[i] = 0;
+    memset(m_eeprom, 0xFF, sizeof(m_eeprom));
+}
+
+VirtualBoard& VirtualBoard::current()
+{
+    if(s_current == nullptr)
+    {
+        fprintf(stderr, "VirtualBoard: no board selected on this thread\n");
+        abort();
+    }
+    return *s_current;
+}
+
+void VirtualBoard::select(VirtualBoard* board)
+{
+    s_current = board;
+}
+
+void VirtualBoard::advance(uint64_t ms)
+{
+    /* The encoder is integrated lazily, bring it up to date first */
+    updateMotor();
+    m_clock += ms;
+}
+
+bool VirtualBoard::localTime(struct tm& info) const
+{
+    /* Like the ESP32, no time until NTP has been configured */
+    if(!m_timeSynced) return false;
+
+    time_t local = epoch() + m_timeOffset;
+    gmtime_r(&local, &info);
+    info.tm_isdst = m_timeOffset != 0;
+    return true;
+}
+
+/* configTime() applies a fixed offset, DST is never switched */
+void VirtualBoard::configureTime(long gmtOffset, int daylightOffset)
+{
+    m_timeOffset = gmtOffset + daylightOffset;
+    m_timeSynced = true;
+}
+
+uint16_t VirtualBoard::light()
+{
+    return m_light ? m_light(*this, m_lightContext) : 0;
+}
+
+/* Degrees above the horizon at BOARD_LATITUDE/LONGITUDE */
+double VirtualBoard::solarElevation(time_t utc)
+{
+    double day         = fmod(utc / 86400.0, 365.2422);
+    double declination = -23.44 * cos(2 * M_PI / 365.2422 * (day + 10));
+    double hours       = fmod(utc / 3600.0, 24.0) + BOARD_LONGITUDE / 15.0;
+    double hourAngle   = (hours - 12.0) * 15.0;
+
+    double lat = BOARD_LATITUDE * M_PI / 180, dec = declination * M_PI / 180, ha = hourAngle * M_PI / 180;
+    return asin(sin(lat) * sin(dec) + cos(lat) * cos(dec) * cos(ha)) * 180 / M_PI;
+}
+
+/* Default light model, dark below -6 degrees (civil dusk), full
+   scale from 10 degrees, with a little sensor noise on top.     */
+uint16_t VirtualBoard::daylight(VirtualBoard& board, void* context)
+{
+    double elevation = solarElevation(board.epoch());
+    double level     = (elevation + 6.0) / 16.0;
+    if(level < 0) level = 0;
+    if(level > 1) level = 1;
+
+    int noise = (int)(board.random() % 33) - 16;
+    int value = (int)(level * BOARD_ADC_MAX) + noise;
+    return value < 0 ? 0 : value > BOARD_ADC_MAX ? BOARD_ADC_MAX : value;
+}
+
+void VirtualBoard::write(uint8_t pin, uint8_t value)
+{
+    if(pin >= BOARD_PINS) return;
+
+    if(pin == BOARD_MOTOR_PIN1 || pin == BOARD_MOTOR_PIN2) updateMotor();
+    m_pins[pin]  = value;
+    m_drive[pin] = value ? 1 : 0;
+}
+
+void VirtualBoard::setupPwm(uint8_t channel, uint8_t bits)
+{
+    if(channel < BOARD_PWM_CHANNELS) m_pwmBits[channel] = bits;
+}
+
+void VirtualBoard::attachPwm(uint8_t pin, uint8_t channel)
+{
+    if(channel < BOARD_PWM_CHANNELS && pin < BOARD_PINS) m_pwmPin[channel] = pin;
+}
+
+void VirtualBoard::writePwm(uint8_t channel, uint32_t duty)
+{
+    if(channel >= BOARD_PWM_CHANNELS || m_pwmPin[channel] >= BOARD_PINS) return;
+
+    uint8_t pin = m_pwmPin[channel];
+    double  max = (1u << m_pwmBits[channel]) - 1;
+    if(pin == BOARD_MOTOR_PIN1 || pin == BOARD_MOTOR_PIN2) updateMotor();
+    m_drive[pin] = duty >= max ? 1 : duty / max;
+    m_pins[pin]  = duty != 0;
+}
+
+double VirtualBoard::motorDrive() const
+{
+    return m_drive[BOARD_MOTOR_PIN1] - m_drive[BOARD_MOTOR_PIN2];
+}
+
+int8_t VirtualBoard::motorDirection() const
+{
+    double drive = motorDrive();
+    return drive == 0 ? 0 : drive > 0 ? 1 : -1;
+}
+
+int32_t VirtualBoard::velocity()
+{
+    updateMotor();
+    return (int32_t)(m_velocity * 1000);
+}
+
+int32_t VirtualBoard::encoder()
+{
+    updateMotor();
+    return m_encoder;
+}
+
+/* Integrates the motor from the last update to now. Speed settles
+   exponentially on drive * m_motorSpeed, which integrates exactly,
+   so a long step between updates is as good as many short ones.  */
+void VirtualBoard::updateMotor()
+{
+    uint64_t elapsed = m_clock - m_motorUpdated;
+    m_motorUpdated   = m_clock;
+
+    double drive = motorDrive();
+    if(elapsed == 0 || (drive == 0 && m_velocity == 0)) return;
+    if(drive != 0) m_motorRunTime += elapsed;
+
+    double lag    = drive == 0 ? BOARD_BRAKE_LAG : BOARD_MOTOR_LAG;
+    double target = drive * m_motorSpeed;
+    double decay  = exp(-(double)elapsed / lag);
+    double moved  = target * elapsed + (m_velocity - target) * lag * (1 - decay);
+    double before = m_position;
+
+    m_velocity  = target + (m_velocity - target) * decay;
+    m_position += moved;
+
+    /* Into a stop, the motor stalls there until it's driven back out.
+       An obstacle is a stop for a door coming down onto it.          */
+    double bottom = m_obstacle > 0 && before >= m_obstacle ? m_obstacle : 0;
+    if(m_position < bottom || m_position > m_travel)
+    {
+        bool arriving = before > bottom && before < m_travel;
+        if(arriving)
+        {
+            m_impactSpeed = (uint32_t)(fabs(m_velocity) * 1000);
+            m_impactTime  = m_clock;
+        }
+        m_position = m_position < bottom ? bottom : m_travel;
+        m_velocity = 0;
+    }
+    if(drive == 0 && fabs(m_velocity) < 0.001) m_velocity = 0;
+
+    int32_t count = (int32_t)floor(m_position);
+    if(count != m_encoder)
+    {
+        m_encoder  = count;
+        m_lastEdge = m_clock;
+    }
+}
+
+uint32_t VirtualBoard::sinceEncoderEdge()
+{
+    updateMotor();
+    uint64_t since = m_clock - m_lastEdge;
+    return since > UINT32_MAX / 1000 ? UINT32_MAX / 1000 : since;
+}
+
+uint32_t VirtualBoard::random()
+{
+    /* xorshift32 */
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
@@ -0,0 +1,129 @@
+#ifndef VIRTUAL_BOARD
+#define VIRTUAL_BOARD 1
+
+#include <stdint.h>
+#include <time.h>
+
+#define BOARD_EEPROM_SIZE   64
+#define BOARD_PINS          40
+#define BOARD_ADC_MAX       4095
+#define BOARD_EPOCH         1710892800  // 2024-03-20 00:00 UTC, the equinox
+
+/* Same wiring as src/main.cpp */
+#define BOARD_MOTOR_PIN1    25
+#define BOARD_MOTOR_PIN2    32
+#define BOARD_ENCODER_PIN1  34
+#define BOARD_ENCODER_PIN2  36
+#define BOARD_LDR_PIN       35
+
+/* Same location as DoorHandler's Dusk2Dawn */
+#define BOARD_LATITUDE      51.1497923
+#define BOARD_LONGITUDE     -0.23745
+
+#define BOARD_MOTOR_SPEED   6       // Encoder counts per ms at full duty, DoorHandler's MOTOR_FULL_SPEED
+#define BOARD_MOTOR_LAG     300     // ms time constant, ~1.3s to full speed from a standing start
+#define BOARD_BRAKE_LAG     30      // ms time constant with both motor pins low
+#define BOARD_TRAVEL        30000   // Counts from closed to the top stop, DoorHandler's D_MTR_STOP_TOP
+#define BOARD_PWM_CHANNELS  16
+
+/* Everything a DoorHandler touches: clock, wall time, EEPROM, pins,
+   light on the LDR and the motor and encoder. Nothing real happens,
+   time only moves when the simulation (or delay()) advances it.      */
+class VirtualBoard{
+
+    public:
+
+        /* Light on the LDR as a 12 bit ADC reading */
+        typedef uint16_t (*LightModel)(VirtualBoard& board, void* context);
+
+        VirtualBoard(uint32_t seed = 1, time_t epoch = BOARD_EPOCH);
+
+        /* The Arduino shim acts on the board selected on this thread */
+        static VirtualBoard& current();
+        static void          select(VirtualBoard* board);
+
+        /* Simulated time, ms since power on */
+        uint64_t  now() const                   {return m_clock;}
+        void      advance(uint64_t ms);
+        void      advanceTo(uint64_t ms)        {if(ms > m_clock) advance(ms - m_clock);}
+        time_t    epoch() const                 {return m_epoch + (time_t)(m_clock / 1000);}
+        bool      localTime(struct tm& info) const;
+        void      configureTime(long gmtOffset, int daylightOffset);
+
+        /* Light */
+        void      setLight(LightModel model, void* context = nullptr) {m_light = model; m_lightContext = context;}
+        uint16_t  light();
+        static uint16_t daylight(VirtualBoard& board, void* context);
+        static double   solarElevation(time_t utc);
+
+        /* Pins, the motor pins drive the motor model */
+        void      write(uint8_t pin, uint8_t value);
+        uint8_t   read(uint8_t pin) const       {return pin < BOARD_PINS ? m_pins[pin] : 0;}
+
+        /* LEDC, a motor pin's PWM duty is its share of full voltage */
+        void      setupPwm(uint8_t channel, uint8_t bits);
+        void      attachPwm(uint8_t pin, uint8_t channel);
+        void      writePwm(uint8_t channel, uint32_t duty);
+
+        /* Motor and encoder. Speed follows the drive with a first order
+           lag, and the door stops dead at 0 and at m_travel, and on an
+           obstacle at m_obstacle counts if it comes down from above.  */
+        int32_t   encoder();
+        void      setEncoder(int32_t count)     {updateMotor(); m_encoder = count; m_position = count;}
+        int8_t    motorDirection() const;
+        double    motorDrive() const;           // -1 to 1, pin1 against pin2
+        int32_t   velocity();                   // counts/s
+        void      setTravel(int32_t counts)     {m_travel = counts;}
+        void      setObstacle(int32_t counts)   {updateMotor(); m_obstacle = counts;}  // 0 removes it
+        void      setMotorSpeed(double speed)   {m_motorSpeed = speed;}
+        double    motorSpeed() const            {return m_motorSpeed;}
+        uint32_t  impactSpeed() const           {return m_impactSpeed;}    // counts/s arriving at the last stop
+        void      resetImpact()                 {m_impactSpeed = 0;}       // Before a move, so a stop it misses reads 0
+        uint64_t  impactTime() const            {return m_impactTime;}     // ms it arrived, to the update
+        uint32_t  sinceEncoderEdge();           // ms, 0 whilst the encoder is turning
+        uint64_t  motorRunTime() const          {return m_motorRunTime;}
+
+        /* EEPROM, erased to 0xFF like a new chip */
+        uint8_t*  eeprom()                      {return m_eeprom;}
+        void      commit()                      {m_commits++;}
+        uint32_t  commits() const               {return m_commits;}
+
+        /* Deterministic per board */
+        uint32_t  random();
+        void      seed(uint32_t seed)           {m_seed = seed ? seed : 1;}
+
+    private:
+
+        uint64_t   m_clock;
+        time_t     m_epoch;
+        long       m_timeOffset;
+        bool       m_timeSynced;
+
+        LightModel m_light;
+        void*      m_lightContext;
+
+        uint8_t    m_pins[BOARD_PINS];
+        double     m_drive[BOARD_PINS];         // 0 to 1, digitalWrite() is all or nothing
+        uint8_t    m_pwmBits[BOARD_PWM_CHANNELS];
+        uint8_t    m_pwmPin[BOARD_PWM_CHANNELS];
+        int32_t    m_encoder;
+        double     m_position;                  // Counts, m_encoder is the whole part
+        double     m_velocity;                  // Counts per ms
+        int32_t    m_travel;
+        int32_t    m_obstacle;
+        double     m_motorSpeed;
+        uint32_t   m_impactSpeed;
+        uint64_t   m_impactTime;
+        uint64_t   m_motorUpdated;
+        uint64_t   m_motorRunTime;
+        uint64_t   m_lastEdge;
+
+        uint8_t    m_eeprom[BOARD_EEPROM_SIZE];
+        uint32_t   m_commits;
+        uint32_t   m_seed;
+
+        void       updateMotor();
+
+};
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_ESP_INTR_ALLOC
+#define HOST_ESP_INTR_ALLOC 1
+
+/* Interrupt allocation flags, the host runs handlers in line */
+#define ESP_INTR_FLAG_IRAM  (1 << 10)   // Handler stays runnable whilst the flash cache is off
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HOST_PCNT_STRUCT
+#define HOST_PCNT_STRUCT 1
+
+/* The few pulse counter registers PcntEncoder reads directly, laid
+   out as in ESP-IDF 4.x. Tools/host/Pcnt.cpp keeps them current.  */
+
+#include <stdint.h>
+
+typedef volatile struct pcnt_dev_s {
+    union {
+        uint32_t val;           // Bit n, unit n has an interrupt raised, until the service clears it
+    } int_raw;
+    union {
+        struct {
+            uint32_t cnt_mode:   2;
+            uint32_t thres1_lat: 1;
+            uint32_t thres0_lat: 1;
+            uint32_t l_lim_lat:  1;
+            uint32_t h_lim_lat:  1;
+            uint32_t zero_lat:   1;
+            uint32_t reserved7: 25;
+        };
+        uint32_t val;           // Events latched by the last interrupt, as PCNT_EVT_*
+    } status_unit[8];
+} pcnt_dev_t;
+
+extern pcnt_dev_t PCNT;
+
+#endif
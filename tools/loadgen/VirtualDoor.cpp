@@ -0,0 +1,183 @@
+#include "VirtualDoor.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+thread_local VirtualDoor* VirtualDoor::s_active = nullptr;
+const DoorLink VirtualDoor::s_link = {connected, send, sendReliable, command};
+
+static uint64_t elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+VirtualDoor::VirtualDoor(uint8_t id, uint32_t seed, time_t epoch, uint8_t format)
+: m_board(seed, epoch),
+  m_door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN),
+  m_scheduler(clock),
+  m_task(m_door, m_scheduler, s_link),
+  m_events(transmitReliable),
+  m_sock(-1),
+  m_controlJob(SCHEDULER_NO_JOB),
+  m_stats(nullptr)
+{
+    /* Same bring up as setup(), on a blank EEPROM */
+    VirtualBoard::select(&m_board);
+    m_door.loadSettings();
+    m_door.setDoorId(id);
+    m_door.configureNTP();
+
+    m_events.begin(m_board.random());
+
+    /* Spread the heartbeats so the doors don't all report at once */
+    m_task.begin(m_board.random() % HEARTBEAT_PERIOD);
+    m_controlJob = m_scheduler.add(controlJob, DOOR_CONTROL_PERIOD/1000, 0, false);
+    m_scheduler.add(networkJob,    NETWORK_PERIOD,    NETWORK_PERIOD);
+    m_scheduler.add(retransmitJob, RETRANSMIT_PERIOD, RETRANSMIT_PERIOD);
+
+    /* As the collector would ask for it, through the command path */
+    char request[8];
+    char reply[RESPONSE_LENGTH];
+    int  length = snprintf(request, sizeof(request), "b %d", format);
+    m_task.execute(request, length, reply, sizeof(reply));
+    VirtualBoard::select(nullptr);
+}
+
+VirtualDoor::~VirtualDoor()
+{
+    if(m_sock >= 0) close(m_sock);
+}
+
+bool VirtualDoor::connect(const sockaddr_in& target)
+{
+    m_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(m_sock < 0) return false;
+    return ::connect(m_sock, (const sockaddr*)&target, sizeof(target)) == 0;
+}
+
+void VirtualDoor::step(uint64_t until, LoadStats& stats)
+{
+    VirtualBoard::select(&m_board);
+    m_task.select();
+    s_active = this;
+    m_stats  = &stats;
+
+    /* Jump straight from one deadline to the next */
+    uint32_t wait = m_scheduler.run();
+    while(m_board.now() + wait <= until)
+    {
+        m_board.advance(wait);
+
+        auto start = std::chrono::steady_clock::now();
+        wait = m_scheduler.run();
+        m_stats->runNs += elapsedNs(start);
+        m_stats->runs++;
+
+        /* The control timer, only whilst the door moves */
+        if(m_task.isMoving() && !m_scheduler.isArmed(m_controlJob))
+        {
+            m_scheduler.arm(m_controlJob, DOOR_CONTROL_PERIOD/1000);
+            if(wait > DOOR_CONTROL_PERIOD/1000) wait = DOOR_CONTROL_PERIOD/1000;
+        }
+    }
+    m_board.advanceTo(until);
+
+    s_active = nullptr;
+    VirtualBoard::select(nullptr);
+}
+
+unsigned long VirtualDoor::clock()
+{
+    return VirtualBoard::current().now();
+}
+
+void VirtualDoor::transmit(const void* data, size_t length)
+{
+    m_stats->packets++;
+    m_stats->bytes += length;
+    if(m_sock >= 0) ::send(m_sock, data, length, MSG_DONTWAIT);
+}
+
+/* The control task, stepping the position loop */
+void VirtualDoor::controlJob()
+{
+    VirtualDoor& self = *s_active;
+    if(!self.m_task.isMoving())
+    {
+        self.m_scheduler.disarm(self.m_controlJob);
+        return;
+    }
+    self.m_door.control();
+}
+
+/* pollNetwork(), ACKs are handled here and everything else is a request */
+void VirtualDoor::networkJob()
+{
+    VirtualDoor& self = *s_active;
+    if(self.m_sock < 0) return;
+
+    char    datagram[COMMAND_LENGTH + 1];   // One over, to tell a long datagram
+    ssize_t length;
+    while((length = recv(self.m_sock, datagram, sizeof(datagram), MSG_DONTWAIT)) > 0)
+    {
+        if(datagram[0] == 'A')
+        {
+            CommandParser ack(datagram, length);
+            if(ack.hasArgument(0, 65535, 1))   self.m_events.acknowledge(ack.getArgument(), ack.getArgument(1));
+            else if(ack.hasArgument(0, 65535)) self.m_events.acknowledge(ack.getArgument());
+            self.m_stats->acks++;
+            continue;
+        }
+
+        /* As pollNetwork(), a truncated request isn't run */
+        char reply[RESPONSE_LENGTH];
+        self.transmit(reply, length > COMMAND_LENGTH ? self.m_task.reject(RESULT_MALFORMED, reply, sizeof(reply))
+                                                     : self.m_task.execute(datagram, length, reply, sizeof(reply)));
+        self.m_stats->commands++;
+    }
+}
+
+void VirtualDoor::retransmitJob()
+{
+    s_active->m_events.poll(millis());
+}
+
+bool VirtualDoor::transmitReliable(uint16_t epoch, uint16_t sequence, const char* payload, uint8_t length)
+{
+    VirtualDoor& self = *s_active;
+
+    char message[RESPONSE_LENGTH];
+    int  written = snprintf(message, sizeof(message), "(ID:%d)-E%u,%u:%.*s", self.m_door.getID(), sequence, epoch,
+                            length, payload);
+    self.transmit(message, written < RESPONSE_LENGTH ? written : RESPONSE_LENGTH - 1);
+    return true;
+}
+
+/* The door is always on the network, without a socket packets are only counted */
+bool VirtualDoor::connected()
+{
+    return true;
+}
+
+bool VirtualDoor::send(const uint8_t* data, uint8_t length)
+{
+    s_active->transmit(data, length);
+    return true;
+}
+
+bool VirtualDoor::sendReliable(const char* payload, uint8_t length)
+{
+    VirtualDoor& self = *s_active;
+    if(memmem(payload, length, "DM:", 3)) self.m_stats->moves++;
+    self.m_events.send(payload, length, millis());
+    return true;
+}
+
+/* Platform commands, there is nothing to restart or log remotely */
+bool VirtualDoor::command(CommandParser& pb)
+{
+    if(pb.getCommand() != 'v') return false;
+    return s_active->m_task.update("interpretPacketCommand() Version=loadgen");
+}
@@ -0,0 +1,72 @@
+#ifndef VIRTUAL_DOOR
+#define VIRTUAL_DOOR 1
+
+#include <VirtualBoard.h>
+#include <DoorHandler.h>
+#include <DoorTask.h>
+#include <ReliableChannel.h>
+#include <netinet/in.h>
+#include <cstdint>
+
+/* Per worker thread, summed at the end */
+struct LoadStats{
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t moves;
+    uint64_t acks;
+    uint64_t commands;      // Requests from the collector, e.g. 'k'
+    uint64_t runs;          // Scheduler passes that ran at least one job
+    uint64_t runNs;
+};
+
+/* The door task of src/main.cpp, the same DoorTask running the real
+   DoorHandler on a VirtualBoard. Heartbeats, replies and DM events go
+   out on the door's own socket, so a collector sees every door as a
+   separate sender. The network side is cut down to match.           */
+class VirtualDoor{
+
+    public:
+
+        VirtualDoor(uint8_t id, uint32_t seed, time_t epoch, uint8_t format);
+        ~VirtualDoor();
+
+        /* Without a socket the door runs as normal, packets are only counted */
+        bool    connect(const sockaddr_in& target);
+
+        /* Runs every job due up to 'until', board ms */
+        void    step(uint64_t until, LoadStats& stats);
+
+        VirtualBoard& board()   {return m_board;}
+
+    private:
+
+        VirtualBoard          m_board;
+        DoorHandler           m_door;
+        Scheduler             m_scheduler;
+        DoorTask              m_task;
+        ReliableSender        m_events;
+        int                   m_sock;
+        int8_t                m_controlJob;
+        LoadStats*            m_stats;
+
+        /* Jobs take no arguments, the door being stepped is thread local */
+        static thread_local VirtualDoor* s_active;
+        static const DoorLink s_link;
+
+        static void controlJob();
+        static void networkJob();
+        static void retransmitJob();
+        static bool transmitReliable(uint16_t epoch, uint16_t sequence, const char* payload, uint8_t length);
+        static unsigned long clock();
+
+        /* DoorLink */
+        static bool connected();
+        static bool send(const uint8_t* data, uint8_t length);
+        static bool sendReliable(const char* payload, uint8_t length);
+        static bool command(CommandParser& pb);
+
+        void    transmit(const void* data, size_t length);
+
+};
+
+#endif
@@ -0,0 +1,225 @@
+/* loadgen - thousands of simulated doors against a collector.
+
+   Usage: loadgen [options]
+     --doors N         simulated doors (default 1000)
+     --threads N       worker threads, doors are split evenly (default all cores)
+     --speed X         simulated ms per wall clock ms (default 60)
+     --seconds N       wall clock run time (default 10)
+     --start DATE      simulated start, YYYY-MM-DD (default 2024-03-20)
+     --spread HOURS    doors start up to this far into the day (default 24)
+     --format F        heartbeats as text, binary or delta (default text)
+     --obstacle N      something in every doorway N counts up, closes are
+                       stopped there until the door gives up as blocked
+     --to HOST:PORT    collector (default 127.0.0.1:3333)
+     --dry             no sockets, packets are only counted
+
+   Every door is the real DoorHandler on a VirtualBoard, see tools/host.
+   Door IDs are a byte, so past 254 doors they repeat.                 */
+#include "VirtualDoor.h"
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define REPORT_PERIOD   1000    // ms
+
+struct Options{
+    unsigned    doors    = 1000;
+    unsigned    threads  = std::thread::hardware_concurrency();
+    double      speed    = 60;
+    unsigned    seconds  = 10;
+    time_t      start    = BOARD_EPOCH;
+    unsigned    spread   = 24;
+    uint8_t     format   = HEARTBEAT_TEXT;
+    int32_t     obstacle = 0;
+    std::string to       = "127.0.0.1:3333";
+    bool        dry      = false;
+};
+
+/* One per thread, owns a contiguous slice of the doors */
+struct Worker{
+    std::vector<std::unique_ptr<VirtualDoor>> doors;
+    LoadStats             stats;
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> simulated;    // Board ms every door has reached
+    std::atomic<uint64_t> cpuNs;
+
+    Worker() : packets(0), simulated(0), cpuNs(0) {memset(&stats, 0, sizeof(stats));}
+};
+
+static bool parseEndpoint(const std::string& text, sockaddr_in& address)
+{
+    size_t colon = text.rfind(':');
+    if(colon == std::string::npos) return false;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port   = htons(atoi(text.c_str() + colon + 1));
+    return inet_pton(AF_INET, text.substr(0, colon).c_str(), &address.sin_addr) == 1;
+}
+
+static bool parseDate(const char* text, time_t& epoch)
+{
+    struct tm date;
+    memset(&date, 0, sizeof(date));
+    if(strptime(text, "%Y-%m-%d", &date) == nullptr) return false;
+    epoch = timegm(&date);
+    return true;
+}
+
+static uint64_t threadCpuNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/* Keeps every door of the worker level with the accelerated clock */
+static void run(Worker& worker, double speed, std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end)
+{
+    uint64_t cpuStart = threadCpuNs();
+    while(std::chrono::steady_clock::now() < end)
+    {
+        double   wall   = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        uint64_t target = wall * speed;
+
+        for(std::unique_ptr<VirtualDoor>& door : worker.doors) door->step(target, worker.stats);
+
+        worker.packets.store(worker.stats.packets, std::memory_order_relaxed);
+        worker.simulated.store(target, std::memory_order_relaxed);
+
+        /* Caught up, no point spinning */
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    worker.cpuNs = threadCpuNs() - cpuStart;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg  = argv[i];
+        bool        more = i + 1 < argc;
+        if     (arg == "--doors"   && more) options.doors   = atoi(argv[++i]);
+        else if(arg == "--threads" && more) options.threads = atoi(argv[++i]);
+        else if(arg == "--speed"   && more) options.speed   = atof(argv[++i]);
+        else if(arg == "--seconds" && more) options.seconds = atoi(argv[++i]);
+        else if(arg == "--spread"  && more) options.spread  = atoi(argv[++i]);
+        else if(arg == "--to"      && more) options.to      = argv[++i];
+        else if(arg == "--obstacle" && more) options.obstacle = atoi(argv[++i]);
+        else if(arg == "--dry")             options.dry     = true;
+        else if(arg == "--start"   && more && parseDate(argv[i + 1], options.start)) i++;
+        else if(arg == "--format"  && more)
+        {
+            std::string format = argv[++i];
+            options.format = format == "delta" ? HEARTBEAT_DELTA : format == "binary" ? HEARTBEAT_BINARY : HEARTBEAT_TEXT;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--doors N] [--threads N] [--speed X] [--seconds N] [--start YYYY-MM-DD]\n"
+                            "       [--spread HOURS] [--format text|binary|delta] [--obstacle N] [--to HOST:PORT] [--dry]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(options.threads == 0) options.threads = 1;
+    if(options.threads > options.doors) options.threads = options.doors ? options.doors : 1;
+
+    sockaddr_in target;
+    if(!options.dry && !parseEndpoint(options.to, target))
+    {
+        fprintf(stderr, "loadgen: bad collector address %s\n", options.to.c_str());
+        return 1;
+    }
+
+    /* A socket per door */
+    if(!options.dry)
+    {
+        rlimit files;
+        getrlimit(RLIMIT_NOFILE, &files);
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for(unsigned i = 0; i < options.threads; i++) workers.emplace_back(new Worker());
+
+    auto buildStart = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < options.doors; i++)
+    {
+        uint32_t seed  = 2654435761u * (i + 1);
+        time_t   epoch = options.start + (options.spread ? seed % (options.spread * 3600) : 0);
+        std::unique_ptr<VirtualDoor> door(new VirtualDoor(i % 254 + 1, seed, epoch, options.format));
+        door->board().setObstacle(options.obstacle);
+        if(!options.dry && !door->connect(target))
+        {
+            perror("loadgen: socket, try raising ulimit -n");
+            return 1;
+        }
+        workers[(uint64_t)i * options.threads / options.doors]->doors.push_back(std::move(door));
+    }
+    fprintf(stderr, "loadgen: %u doors on %u threads, built in %.0f ms\n", options.doors, options.threads,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count());
+
+    auto start = std::chrono::steady_clock::now();
+    auto end   = start + std::chrono::seconds(options.seconds);
+    std::vector<std::thread> threads;
+    for(std::unique_ptr<Worker>& worker : workers) threads.emplace_back(run, std::ref(*worker), options.speed, start, end);
+
+    /* Progress, read from the workers' published counters only */
+    uint64_t lastPackets = 0;
+    while(std::chrono::steady_clock::now() + std::chrono::milliseconds(REPORT_PERIOD) <= end)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(REPORT_PERIOD));
+
+        uint64_t packets = 0, simulated = UINT64_MAX;
+        for(std::unique_ptr<Worker>& worker : workers)
+        {
+            packets  += worker->packets.load(std::memory_order_relaxed);
+            uint64_t reached = worker->simulated.load(std::memory_order_relaxed);
+            if(reached < simulated) simulated = reached;
+        }
+        double wall = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "loadgen: %.0f pkt/s, simulated %.1f min, %s\n", (packets - lastPackets) * 1000.0 / REPORT_PERIOD,
+                simulated / 60000.0, simulated + options.speed * 100 < wall * options.speed ? "falling behind" : "keeping up");
+        lastPackets = packets;
+    }
+    for(std::thread& thread : threads) thread.join();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LoadStats total;
+    memset(&total, 0, sizeof(total));
+    uint64_t cpuNs = 0, simulated = UINT64_MAX;
+    for(std::unique_ptr<Worker>& worker : workers)
+    {
+        const LoadStats& s = worker->stats;
+        total.packets   += s.packets;
+        total.bytes     += s.bytes;
+        total.moves     += s.moves;
+        total.acks      += s.acks;
+        total.commands  += s.commands;
+        total.runs      += s.runs;
+        total.runNs     += s.runNs;
+        cpuNs           += worker->cpuNs;
+        if(worker->simulated < simulated) simulated = worker->simulated;
+    }
+
+    double doorHours = options.doors * simulated / 3600000.0;
+    printf("doors           %u\n", options.doors);
+    printf("simulated       %.1f min at %.0fx\n", simulated / 60000.0, options.speed);
+    printf("sustained       %.0f pkt/s, %.2f MB/s\n", total.packets / wall, total.bytes / wall / 1e6);
+    printf("moves           %llu, acks %llu, requests %llu\n", (unsigned long long)total.moves,
+           (unsigned long long)total.acks, (unsigned long long)total.commands);
+    printf("run()           %.0f ns/call over %llu calls\n", total.runs ? (double)total.runNs / total.runs : 0.0,
+           (unsigned long long)total.runs);
+    printf("cpu per door    %.1f us per simulated door hour\n", doorHours > 0 ? cpuNs / 1000.0 / doorHours : 0.0);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Builds the log format dictionary for binary remote logging.
+
+Every logError/logInfo/logDebug/logRemote call in the firmware is sent
+as a 16 bit format ID plus raw arguments (see lib/Logger/Logger.h). This
+script finds the same format literals in the sources, hashes them with
+the same FNV-1a and writes an "id<TAB>module<TAB>format" dictionary the
+collector uses to turn IDs back into text.
+
+Runs as a PlatformIO pre script, writing log_dictionary.tsv into the
+build directory, or standalone:
+
+    python3 tools/log_dictionary.py [project dir] [output file]
+"""
+
+import os
+import re
+import sys
+
+SOURCE_DIRS = ("src", "lib", "include")
+SOURCE_EXTENSIONS = (".c", ".cpp", ".h", ".hpp", ".ino")
+
+HASH_BASIS = 2166136261
+HASH_PRIME = 16777619
+
+LOG_CALL = re.compile(r"\blog(?:Error|Info|Debug|Remote)\s*\(\s*(\w+)\s*,")
+STRING_DEFINE = re.compile(r'^[ \t]*#define[ \t]+(\w+)[ \t]+((?:"(?:[^"\\\n]|\\.)*"[ \t]*)+)', re.M)
+STRING = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "0": "\0", "\\": "\\", '"': '"', "'": "'"}
+
+
+def log_id(text):
+    """Must match logId() in Logger.h"""
+    value = HASH_BASIS
+    for byte in text.encode("latin-1"):
+        value = ((value ^ byte) * HASH_PRIME) & 0xFFFFFFFF
+    return (value ^ (value >> 16)) & 0xFFFF
+
+
+def unescape(literal):
+    out, i = [], 0
+    while i < len(literal):
+        if literal[i] == "\\" and i + 1 < len(literal):
+            out.append(ESCAPES.get(literal[i + 1], literal[i + 1]))
+            i += 2
+        else:
+            out.append(literal[i])
+            i += 1
+    return "".join(out)
+
+
+def escape(text):
+    return text.replace("\\", "\\\\").replace("\t", "\\t").replace("\n", "\\n").replace("\r", "\\r")
+
+
+def strip_comments(source):
+    """Blanks out comments, keeping string literals and line numbers intact"""
+    out, i, n = [], 0, len(source)
+    while i < n:
+        if source.startswith("//", i):
+            end = source.find("\n", i)
+            i = n if end < 0 else end
+        elif source.startswith("/*", i):
+            end = source.find("*/", i + 2)
+            end = n if end < 0 else end + 2
+            out.append("\n" * source.count("\n", i, end))
+            i = end
+        elif source[i] in "\"'":
+            quote, start = source[i], i
+            i += 1
+            while i < n and source[i] != quote and source[i] != "\n":
+                i += 2 if source[i] == "\\" else 1
+            i += 1
+            out.append(source[start:i])
+        else:
+            out.append(source[i])
+            i += 1
+    return "".join(out)
+
+
+def source_files(root):
+    for directory in SOURCE_DIRS:
+        for base, _, names in os.walk(os.path.join(root, directory)):
+            for name in sorted(names):
+                if name.endswith(SOURCE_EXTENSIONS):
+                    yield os.path.join(base, name)
+
+
+def read_format(source, pos, defines):
+    """Concatenates the literals and string macros making up a format,
+       returns None if the format isn't a compile time string."""
+    parts = []
+    token = re.compile(r'\s*(?:"((?:[^"\\\n]|\\.)*)"|(\w+))')
+    while True:
+        match = token.match(source, pos)
+        if not match:
+            break
+        if match.group(1) is not None:
+            parts.append(unescape(match.group(1)))
+        elif match.group(2) in defines:
+            parts.append(defines[match.group(2)])
+        else:
+            return None
+        pos = match.end()
+    return "".join(parts) if parts else None
+
+
+def build(root):
+    sources = {}
+    for path in source_files(root):
+        with open(path, encoding="latin-1") as handle:
+            sources[path] = strip_comments(handle.read())
+
+    defines = {}
+    for source in sources.values():
+        for match in STRING_DEFINE.finditer(source):
+            defines[match.group(1)] = "".join(unescape(s) for s in STRING.findall(match.group(2)))
+
+    entries, errors = {}, []
+    for path, source in sources.items():
+        for match in LOG_CALL.finditer(source):
+            line = source.count("\n", 0, match.start()) + 1
+            text = read_format(source, match.end(), defines)
+            if text is None:
+                # The macro definitions themselves, or a non literal format
+                if not path.endswith("Logger.h"):
+                    errors.append("%s:%d: format is not a string literal" % (path, line))
+                continue
+            ident = log_id(text)
+            if ident in entries and entries[ident][1] != text:
+                errors.append("%s:%d: format ID 0x%04x collides with \"%s\""
+                              % (path, line, ident, escape(entries[ident][1])))
+                continue
+            entries[ident] = (match.group(1), text)
+    return entries, errors
+
+
+def write(entries, output):
+    with open(output, "w", encoding="latin-1") as handle:
+        handle.write("# Log format dictionary, generated by tools/log_dictionary.py\n")
+        for ident in sorted(entries):
+            module, text = entries[ident]
+            handle.write("%04x\t%s\t%s\n" % (ident, module, escape(text)))
+
+
+def main(root, output):
+    entries, errors = build(root)
+    for error in errors:
+        sys.stderr.write("log_dictionary: %s\n" % error)
+    if errors:
+        return 1
+    write(entries, output)
+    print("log_dictionary: %d formats -> %s" % (len(entries), output))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1] if len(sys.argv) > 1 else ".",
+                  sys.argv[2] if len(sys.argv) > 2 else "log_dictionary.tsv"))
+else:
+    Import("env")  # noqa: F821, provided by PlatformIO
+    build_dir = env.subst("$BUILD_DIR")  # noqa: F821
+    if not os.path.isdir(build_dir):
+        os.makedirs(build_dir)
+    if main(env.subst("$PROJECT_DIR"), os.path.join(build_dir, "log_dictionary.tsv")):  # noqa: F821
+        env.Exit(1)  # noqa: F821
@@ -0,0 +1,187 @@
+/* logbench - lib/Logger's hot path against the synchronous debug
+   output it replaced, and its rings under several writers.
+
+   Usage: logbench hot [records]
+          logbench stress [records]
+     hot       per call cost on the calling task of: debug(), a
+               formatted line written straight out, /dev/null
+               unbuffered standing in for Serial; debugUpdate(), the
+               same line as a UDP datagram to loopback; and logInfo(),
+               a record pushed into the ring. The ring is drained
+               between batches, off the clock, as the logger task would.
+     stress    LOG_SHARED_RING writers that never attach() alongside a
+               writer per attached ring, all pushing at once whilst one
+               thread drains. Every record must arrive at most once and
+               in order per writer, and received + dropped must equal
+               pushed.
+
+   Serial on the ESP32 blocks for its whole line at 115200 baud, ~87us
+   per 10 characters once its FIFO is full, so the debug() figure is a
+   floor. Exits non-zero if a record is lost, repeated or reordered. */
+#include <Logger.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LINE_LENGTH     160         // LOG_LINE_LENGTH, and the old debugUpdate() buffer
+#define BATCH           (LOG_RING_SIZE / 2)
+#define ATTACHED        LOG_SHARED_RING
+#define SHARED_WRITERS  2           // Tasks that never attach(), e.g. setup() and loop()
+
+static uint32_t ticks = 0;
+static unsigned long clockTicks()
+{
+    return ticks++;
+}
+
+static void discard(const LogRecord&)
+{
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int benchHot(uint32_t records)
+{
+    logger.begin(clockTicks, discard, nullptr);
+    records -= records % BATCH;
+
+    /* debug(), formatted and written before the call returns */
+    FILE* serial = fopen("/dev/null", "w");
+    setvbuf(serial, nullptr, _IONBF, 0);
+    char  line[LINE_LENGTH];
+    auto  start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < records; i++)
+    {
+        snprintf(line, sizeof(line), "pollDoor() position=%d target=%d\n", (int)i, 30000);
+        fputs(line, serial);
+    }
+    double debugNs = elapsedNs(start) / records;
+    fclose(serial);
+
+    /* debugUpdate(), a datagram per line */
+    int         sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_port        = htons(9);     // Discard, nothing listens
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < records; i++)
+    {
+        int length = snprintf(line, sizeof(line), "(ID:%d)-pollDoor() position=%d target=%d", 1, (int)i, 30000);
+        sendto(sock, line, length, 0, (const sockaddr*)&to, sizeof(to));
+    }
+    double updateNs = elapsedNs(start) / records;
+    close(sock);
+
+    /* logInfo(), timed a batch at a time with the drain off the clock */
+    double   logNs = 0;
+    uint32_t dropped = logger.dropped();
+    for(uint32_t i = 0; i < records; i += BATCH)
+    {
+        start = std::chrono::steady_clock::now();
+        for(uint32_t j = 0; j < BATCH; j++) logInfo(DOOR, "pollDoor() position=%d target=%d", (int)(i + j), 30000);
+        logNs += elapsedNs(start);
+        logger.drain(LOG_RING_SIZE);
+    }
+    logNs /= records;
+
+    if(logger.dropped() != dropped)
+    {
+        fprintf(stderr, "logbench: %u records dropped with the ring drained every %d\n", logger.dropped() - dropped, BATCH);
+        return 1;
+    }
+    printf("records         %u, two integer arguments each\n", records);
+    printf("debug()         %7.1f ns/call  formatted and written\n", debugNs);
+    printf("debugUpdate()   %7.1f ns/call  formatted and sent\n", updateNs);
+    printf("logInfo()       %7.1f ns/call  pushed, %.0fx and %.0fx less\n", logNs, debugNs / logNs, updateNs / logNs);
+    return 0;
+}
+
+/* What the drain saw, per writer */
+static std::vector<int64_t>  lastSeen;
+static std::vector<uint32_t> received;
+static bool                  disordered = false;
+
+static void check(const LogRecord& record)
+{
+    uint32_t writer = record.args[0];
+    int64_t  seq    = record.args[1];
+    if(writer >= lastSeen.size() || seq <= lastSeen[writer]) disordered = true;
+    else
+    {
+        lastSeen[writer] = seq;
+        received[writer]++;
+    }
+}
+
+static int benchStress(uint32_t records)
+{
+    const uint32_t writers = ATTACHED + SHARED_WRITERS;
+    lastSeen.assign(writers, -1);
+    received.assign(writers, 0);
+    logger.begin(clockTicks, check, nullptr);
+    uint32_t dropped = logger.dropped();
+
+    std::atomic<uint32_t> running(writers);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t w = 0; w < writers; w++)
+    {
+        threads.emplace_back([w, records, &running]
+        {
+            if(w < ATTACHED) logger.attach(w);
+            for(uint32_t i = 0; i < records; i++)
+            {
+                logDebug(MAIN, "stress writer=%d record=%d", (int)w, (int)i);
+                if(i % 16 == 15) std::this_thread::yield();
+            }
+            running--;
+        });
+    }
+
+    /* The logger task, the only consumer */
+    while(running) if(!logger.drain(LOG_RING_SIZE)) std::this_thread::yield();
+    for(std::thread& thread : threads) thread.join();
+    while(logger.drain(LOG_RING_SIZE)) {}
+    double seconds = elapsedNs(start) / 1e9;
+
+    uint64_t total = 0;
+    for(uint32_t count : received) total += count;
+    uint64_t pushed = (uint64_t)writers * records;
+    dropped = logger.dropped() - dropped;
+
+    printf("writers         %d attached, %d sharing LOG_SHARED_RING, %u records each\n", ATTACHED, SHARED_WRITERS, records);
+    printf("received        %llu, %u dropped of %llu pushed, %.2f M/s\n", (unsigned long long)total, dropped,
+           (unsigned long long)pushed, pushed / seconds / 1e6);
+    if(disordered || total + dropped != pushed)
+    {
+        fprintf(stderr, "logbench: records lost, repeated or out of order\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode  = argc > 1 ? argv[1] : "";
+    uint32_t    count = argc > 2 ? strtoul(argv[2], nullptr, 0) : 0;
+
+    if(mode == "hot")    return benchHot(count ? count : 1000000);
+    if(mode == "stress") return benchStress(count ? count : 1000000);
+
+    fprintf(stderr, "Usage: %s hot [records] | stress [records]\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,92 @@
+#include "LogDictionary.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+static std::string unescape(const std::string& text)
+{
+    std::string out;
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        if(text[i] != '\\' || i + 1 == text.size())
+        {
+            out += text[i];
+            continue;
+        }
+        switch(text[++i])
+        {
+            case 'n':  out += '\n'; break;
+            case 't':  out += '\t'; break;
+            case 'r':  out += '\r'; break;
+            default:   out += text[i];
+        }
+    }
+    return out;
+}
+
+bool LogDictionary::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if(!file) return false;
+
+    /* "id<TAB>module<TAB>format", id in hex */
+    std::string line;
+    while(std::getline(file, line))
+    {
+        if(line.empty() || line[0] == '#') continue;
+
+        size_t first  = line.find('\t');
+        size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+        if(second == std::string::npos) return false;
+
+        unsigned long id = std::strtoul(line.substr(0, first).c_str(), nullptr, 16);
+        if(id > 0xFFFF) return false;
+        m_formats[(uint16_t)id] = unescape(line.substr(second + 1));
+    }
+    return true;
+}
+
+const char* LogDictionary::lookup(uint16_t id) const
+{
+    auto it = m_formats.find(id);
+    return it == m_formats.end() ? nullptr : it->second.c_str();
+}
+
+int LogDictionary::decode(const uint8_t* datagram, size_t len, std::string& out) const
+{
+    if(len < LOG_WIRE_HEADER_LENGTH || datagram[0] != LOG_WIRE_MAGIC || datagram[1] != LOG_WIRE_VERSION) return -1;
+
+    uint8_t id    = datagram[2];
+    uint8_t count = datagram[3];
+    size_t  pos   = LOG_WIRE_HEADER_LENGTH;
+
+    int decoded = 0;
+    for(; decoded < count; decoded++)
+    {
+        LogRecord record;
+        uint8_t used = Logger::decode(datagram + pos, len - pos > 0xFFFF ? 0xFFFF : len - pos, record);
+        if(used == 0) break; // Truncated, keep what we have
+        pos += used;
+
+        char line[LOG_LINE_LENGTH];
+        record.format = lookup(record.id);
+        if(record.format != nullptr)
+        {
+            Logger::format(record, line, sizeof(line));
+        }
+        else
+        {
+            /* Still worth showing, the arguments may be enough */
+            int written = snprintf(line, sizeof(line), "<unknown format %04x>", record.id);
+            for(uint8_t i = 0; i < record.argCount && written < (int)sizeof(line); i++)
+                written += snprintf(line + written, sizeof(line) - written, " %d", record.args[i]);
+        }
+
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "(ID:%d)[%u]-", id, record.timestamp);
+        out += prefix;
+        out += line;
+        out += '\n';
+    }
+    return decoded;
+}
@@ -0,0 +1,34 @@
+#ifndef LOG_DICTIONARY
+#define LOG_DICTIONARY 1
+
+#include <Logger.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/* Host side of binary remote logging. Loads the dictionary written by
+   tools/log_dictionary.py and turns LOG_WIRE_MAGIC datagrams back into
+   the text the firmware would have formatted itself.                 */
+class LogDictionary{
+
+    public:
+
+        /* Returns false if the file can't be read or is malformed */
+        bool        load(const std::string& path);
+        size_t      size() const            {return m_formats.size();}
+
+        /* Null if the ID isn't known, e.g. a stale dictionary */
+        const char* lookup(uint16_t id) const;
+
+        /* Renders every record in a datagram, one line each, prefixed
+           "(ID:n)-" like the text log. Returns the records decoded,
+           -1 if the datagram isn't a binary log.                     */
+        int         decode(const uint8_t* datagram, size_t len, std::string& out) const;
+
+    private:
+
+        std::unordered_map<uint16_t, std::string> m_formats;
+
+};
+
+#endif
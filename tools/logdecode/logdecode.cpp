@@ -0,0 +1,96 @@
+/* logdecode - prints binary remote logs as text.
+
+   Usage: logdecode <log_dictionary.tsv> [port | -]
+
+   Listens on port (default 3333) for LOG_WIRE_MAGIC datagrams, anything
+   else is ignored. With '-' a single captured datagram is read from
+   stdin instead.                                                      */
+#include "LogDictionary.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#define DEFAULT_PORT    3333
+#define MAX_DATAGRAM    1500
+
+static int decodeStdin(const LogDictionary& dictionary)
+{
+    std::vector<uint8_t> datagram((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+
+    std::string text;
+    if(dictionary.decode(datagram.data(), datagram.size(), text) < 0)
+    {
+        fprintf(stderr, "logdecode: not a binary log datagram\n");
+        return 1;
+    }
+    fputs(text.c_str(), stdout);
+    return 0;
+}
+
+static int decodeSocket(const LogDictionary& dictionary, uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0)
+    {
+        perror("logdecode: socket");
+        return 1;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port        = htons(port);
+    if(bind(sock, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+        perror("logdecode: bind");
+        close(sock);
+        return 1;
+    }
+
+    uint8_t     datagram[MAX_DATAGRAM];
+    std::string text;
+    for(;;)
+    {
+        ssize_t len = recv(sock, datagram, sizeof(datagram), 0);
+        if(len < 0)
+        {
+            perror("logdecode: recv");
+            break;
+        }
+
+        text.clear();
+        if(dictionary.decode(datagram, len, text) <= 0) continue;
+        fputs(text.c_str(), stdout);
+        fflush(stdout);
+    }
+    close(sock);
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <log_dictionary.tsv> [port | -]\n", argv[0]);
+        return 2;
+    }
+
+    LogDictionary dictionary;
+    if(!dictionary.load(argv[1]))
+    {
+        fprintf(stderr, "logdecode: can't load dictionary %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(stderr, "logdecode: %zu formats\n", dictionary.size());
+
+    if(argc > 2 && strcmp(argv[2], "-") == 0) return decodeStdin(dictionary);
+    return decodeSocket(dictionary, argc > 2 ? atoi(argv[2]) : DEFAULT_PORT);
+}
@@ -0,0 +1,243 @@
+/* motiontest - checks DoorHandler's motion state machine against the
+   simulated encoder in tools/host.
+
+   Usage: motiontest
+   Runs each of, in turn:
+     open/close  moveDoor() returns at once, the door goes Idle ->
+                 Starting -> Travelling -> Settling -> Idle, getState()
+                 reports the state and a position that only moves one
+                 way, and the move ends on its target; with the motor
+                 position saved and without
+     busy        moveDoor() is refused whilst moving and when the door
+                 is already where it was asked to go
+     seized      a motor that never turns, Starting gives up without
+                 Travelling and the motor is cut
+     jammed      the door stops dead part way up, the motor is cut
+                 within the stall time and the door is then neither
+                 open nor closed; with the motor position saved and
+                 without
+
+   The board only moves on when the test advances it: every
+   MOTION_PERIOD ms update() runs once and control() runs every
+   DOOR_CONTROL_PERIOD, as the door and control tasks do. Neither
+   call may take any simulated time. Exits non-zero on the first
+   failure.                                                         */
+#include <Arduino.h>
+#include <DoorHandler.h>
+#include <DoorTask.h>
+#include <VirtualBoard.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define MOVE_TIMEOUT    60000       // ms, a move that runs this long has failed
+#define TARGET_BAND     POSITION_TOLERANCE
+#define STALL_SLACK     100         // ms past the stall time to notice a jam
+#define REPORT_EVERY    20          // updates between getState() reads
+
+static const char* stateNames[] = {"Idle", "Starting", "Travelling", "Settling", "Backoff", "Calibrating"};
+
+struct Motion{
+    std::vector<uint8_t> states;    // Each state in turn, from the one moveDoor() left
+    uint32_t updates;
+    uint32_t ms;
+    uint32_t reports;               // getState() positions that moved on
+    bool     backwards;             // getState() came back further than an overshoot
+    bool     tookTime;              // update() or control() advanced the clock
+    uint64_t motorOff;              // Board ms the motor drive went to 0, 0 if never
+};
+
+/* One MOTION_PERIOD of the door and control tasks */
+static bool step(DoorHandler& door, VirtualBoard& board, Motion& motion)
+{
+    for(uint32_t ms = 0; ms < MOTION_PERIOD; ms += DOOR_CONTROL_PERIOD/1000)
+    {
+        board.advance(DOOR_CONTROL_PERIOD/1000);
+        uint64_t before = board.now();
+        door.control();
+        if(board.now() != before) motion.tookTime = true;
+    }
+
+    uint64_t before = board.now();
+    bool     moving = door.update();
+    if(board.now() != before) motion.tookTime = true;
+    motion.updates++;
+
+    if(!motion.motorOff && board.motorDrive() == 0) motion.motorOff = board.now();
+    if(motion.states.back() != door.getMotionState()) motion.states.push_back(door.getMotionState());
+    return moving;
+}
+
+/* Runs a move to rest, reading the state back as a heartbeat would */
+static bool runMove(DoorHandler& door, VirtualBoard& board, bool open, Motion& motion)
+{
+    motion = Motion();
+    uint64_t start = board.now();
+
+    if(!door.moveDoor(open)) return false;
+    if(board.now() != start) motion.tookTime = true;
+    motion.states.push_back(door.getMotionState());
+
+    int32_t last = door.getState().getStatus().motorPosition, furthest = last;
+    while(step(door, board, motion))
+    {
+        if(board.now() - start > MOVE_TIMEOUT) return false;
+
+        /* getState() reads the LDR, 30ms of delay(), so not every step */
+        if(motion.updates % REPORT_EVERY) continue;
+        TelemetryStatus status = door.getState().getStatus();
+        if(status.motionState != door.getMotionState()) motion.backwards = true;
+
+        /* The loop may overshoot and come back, but no further than that */
+        int32_t position = status.motorPosition;
+        if(open ? position > furthest : position < furthest) furthest = position;
+        if(abs(furthest - position) > TARGET_BAND) motion.backwards = true;
+        if(position != last) motion.reports++;
+        last = position;
+    }
+    motion.ms = board.now() - start;
+    return true;
+}
+
+static void printStates(FILE* out, const Motion& motion)
+{
+    for(size_t i = 0; i < motion.states.size(); i++)
+    {
+        fprintf(out, "%s%s", i ? " -> " : "", motion.states[i] < 6 ? stateNames[motion.states[i]] : "?");
+    }
+}
+
+static bool sameStates(const Motion& motion, const std::vector<uint8_t>& expected)
+{
+    return motion.states == expected;
+}
+
+static int testMoves(bool saved)
+{
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+    door.setMotorSaved(saved);
+
+    const std::vector<uint8_t> expected = {MOTION_STARTING, MOTION_TRAVELLING, MOTION_SETTLING, MOTION_IDLE};
+    for(bool open : {true, false})
+    {
+        Motion  motion;
+        bool    ran    = runMove(door, board, open, motion);
+        int32_t target = open ? door.getTopPosition() : 0;
+        bool    there  = open ? door.isOpen() && !door.isClosed() : door.isClosed() && !door.isOpen();
+
+        /* Without position saving only the end state says where it is */
+        bool    moved  = !saved || motion.reports > 10;
+        if(!ran || !sameStates(motion, expected) || motion.backwards || !moved || motion.tookTime ||
+           abs(board.encoder() - target) > TARGET_BAND || !there)
+        {
+            fprintf(stderr, "motiontest: %s (saved=%d) went ", open ? "open" : "close", saved);
+            printStates(stderr, motion);
+            fprintf(stderr, " in %u ms to %d, target %d, %u position reports%s%s\n", motion.ms, board.encoder(), target,
+                    motion.reports, motion.backwards ? ", state or position went backwards" : "",
+                    motion.tookTime ? ", a call took simulated time" : "");
+            return 1;
+        }
+        printf("  %-5s saved=%d  %6.2f s, %5u updates, %4u position reports  ", open ? "open" : "close", saved,
+               motion.ms / 1000.0, motion.updates, motion.reports);
+        printStates(stdout, motion);
+        printf("\n");
+    }
+    return 0;
+}
+
+static int testBusy()
+{
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+
+    bool   refused = !door.moveDoor(false);     // Starts closed
+    Motion motion;
+    motion.states.push_back(MOTION_IDLE);
+    refused = refused && door.moveDoor(true);
+    for(int i = 0; i < 100; i++) step(door, board, motion);
+    refused = refused && !door.moveDoor(false) && !door.moveDoor(true);
+    while(step(door, board, motion)) {}
+    refused = refused && !door.moveDoor(true);
+
+    if(!refused)
+    {
+        fprintf(stderr, "motiontest: moveDoor() accepted a move whilst busy or already there\n");
+        return 1;
+    }
+    printf("  busy        moves refused whilst moving, closed then open\n");
+    return 0;
+}
+
+static int testSeized()
+{
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+    board.setMotorSpeed(0);
+
+    Motion motion;
+    bool   ran = runMove(door, board, true, motion);
+    if(!ran || !sameStates(motion, {MOTION_STARTING, MOTION_SETTLING, MOTION_IDLE}) || board.motorDrive() != 0 ||
+       board.encoder() != 0)
+    {
+        fprintf(stderr, "motiontest: seized motor went ");
+        printStates(stderr, motion);
+        fprintf(stderr, ", drive %.2f at %d\n", board.motorDrive(), board.encoder());
+        return 1;
+    }
+    printf("  seized      %6.2f s  ", motion.ms / 1000.0);
+    printStates(stdout, motion);
+    printf("\n");
+    return 0;
+}
+
+static int testJammed(bool saved)
+{
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+    door.setMotorSaved(saved);
+
+    Motion motion;
+    motion.states.push_back(MOTION_IDLE);
+    if(!door.moveDoor(true)) return 1;
+    while(board.encoder() < BOARD_TRAVEL / 3) step(door, board, motion);
+
+    /* Dead stop, as if the door caught on the frame */
+    board.setTravel(board.encoder() + 1);
+    uint64_t jammed = board.now();
+    motion.motorOff = 0;
+    while(step(door, board, motion) && board.now() - jammed < MOVE_TIMEOUT) {}
+
+    uint32_t reaction = motion.motorOff ? motion.motorOff - jammed : MOVE_TIMEOUT;
+    if(reaction > (uint32_t)door.getStallTime() + STALL_SLACK || door.getMotionState() != MOTION_IDLE ||
+       door.isOpen() || door.isClosed())
+    {
+        fprintf(stderr, "motiontest: jammed (saved=%d) at %d, motor cut after %u ms, stall time %u, open=%d closed=%d\n",
+                saved, board.encoder(), reaction, door.getStallTime(), door.isOpen(), door.isClosed());
+        return 1;
+    }
+    printf("  jammed      saved=%d  at %d, motor cut after %u ms, stall time %u  ", saved, board.encoder(), reaction,
+           door.getStallTime());
+    printStates(stdout, motion);
+    printf("\n");
+    return 0;
+}
+
+int main()
+{
+    printf("moves\n");
+    if(testMoves(true) || testMoves(false)) return 1;
+    printf("refusals\n");
+    if(testBusy()) return 1;
+    printf("failures\n");
+    if(testSeized()) return 1;
+    return testJammed(true) || testJammed(false);
+}
@@ -0,0 +1,391 @@
+/* motorsim - one open and one close through the motor model, for
+   each set of position loop gains.
+
+   Usage: motorsim [options]
+     --profile P       scurve, trapezoid, or full for the old full power
+                       drive with no profile (default scurve)
+     --time N          m_motorMoveTime, n*100ms for a full travel (default 75)
+     --accel N         m_motorAccelTime, n*100ms (default 10)
+     --decel N         m_motorDecelTime, n*100ms (default 15)
+     --load F          motor speed against the model's, e.g. 0.7 for a
+                       heavy door (default 1)
+     --gains KP,KI,KD,KFF
+                       position loop gains, more than one --gains runs
+                       each set in turn (default the door's own)
+     --travel N        counts to the board's top stop, past the open
+                       position so an overshoot shows (default 31500)
+     --obstacle N      close onto something N counts up instead, and
+                       report how long the door takes to react to it
+     --clear MS        take the obstacle away MS after the first hit,
+                       so a retry can close (default never, blocked)
+     --stall MS        m_stallTime, the obstruction window (default the
+                       door's own)
+     --calibrate       run calibrate() first, from a third of the way up,
+                       and open to the top position it learned
+     --trace           CSV of every control step instead of the summary
+
+   The real DoorHandler::moveDoor() and update() run every
+   MOTION_PERIOD ms, and control() every DOOR_CONTROL_PERIOD, on a
+   VirtualBoard (tools/host), its LEDC output driving a motor with a
+   first order lag and hard stops at 0 and --travel. For each move:
+   settling time, the last time the door came into the target band;
+   overshoot, furthest past the target; and the steady state error it
+   came to rest with. Exits non-zero if any move doesn't come to rest
+   in the band, or with full, doesn't get there at all.
+
+   With --obstacle, each hit is timed from the door landing on it to
+   the motor no longer driving it down, the obstruction detector's
+   reaction latency, and the close must end blocked, or closed with
+   --clear, for a zero exit.
+
+   With --calibrate, the learned top, speeds and travel times are
+   printed and the calibration must end with the door closed.       */
+#include <Arduino.h>
+#include <DoorHandler.h>
+#include <DoorTask.h> // MOTION_PERIOD, the firmware's own
+#include <VirtualBoard.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define MOVE_TIMEOUT    60000       // ms, a move that runs this long has failed
+#define SETTLE_BAND     30          // counts, CONTROL_TOLERANCE in DoorHandler.cpp
+#define BOARD_OVERTRAVEL 1500       // counts of --travel past the open position
+#define OBSTRUCTED_TIMEOUT 180000   // ms, reversing and backing off included
+
+struct Move{
+    uint32_t ms;            // Motor on to motor off
+    int32_t  peakSpeed;     // counts/s
+    int32_t  peakAccel;     // counts/s/s, over one step
+    uint32_t impact;        // counts/s arriving at the stop
+    int32_t  position;      // Where it ended
+    uint32_t settle;        // ms, motor on to the last entry into the band
+    int32_t  overshoot;     // counts past the target, 0 if it never got there
+    int32_t  error;         // counts, target less where it came to rest
+};
+
+static void traceStep(uint64_t start, VirtualBoard& board)
+{
+    printf("%llu,%.3f,%d,%d\n", (unsigned long long)(board.now() - start), board.motorDrive(),
+           board.velocity(), board.encoder());
+}
+
+/* Peaks over one step, leaving out the stops themselves */
+static void measure(VirtualBoard& board, int32_t travel, uint32_t period, Move& move, int32_t& last)
+{
+    int32_t position = board.encoder();
+    if(position <= 0 || position >= travel) return;
+
+    int32_t speed = board.velocity();
+    int32_t accel = (speed - last) * 1000 / (int32_t)period;
+    if(abs(speed) > move.peakSpeed) move.peakSpeed = abs(speed);
+    if(abs(accel) > move.peakAccel) move.peakAccel = abs(accel);
+    last = speed;
+}
+
+/* Settling and overshoot against the target, every control step */
+static void track(VirtualBoard& board, int32_t target, bool open, uint64_t start, Move& move, bool& inside)
+{
+    int32_t position = board.encoder();
+    int32_t past     = open ? position - target : target - position;
+    if(past > move.overshoot) move.overshoot = past;
+
+    bool band = abs(target - position) <= SETTLE_BAND;
+    if(band && !inside) move.settle = board.now() - start;
+    inside = band;
+}
+
+static bool moveDoor(DoorHandler& door, VirtualBoard& board, int32_t travel, int32_t target, bool open,
+                     bool trace, Move& move)
+{
+    move = Move();
+    board.resetImpact();
+    uint64_t start  = board.now();
+    int32_t  last   = 0;
+    bool     inside = false;
+
+    if(!door.moveDoor(open)) return false;
+    while(door.getMotionState() == MOTION_STARTING || door.getMotionState() == MOTION_TRAVELLING)
+    {
+        if(board.now() - start > MOVE_TIMEOUT) return false;
+        for(uint32_t ms = 0; ms < MOTION_PERIOD; ms += DOOR_CONTROL_PERIOD/1000)
+        {
+            board.advance(DOOR_CONTROL_PERIOD/1000);
+            door.control();
+            track(board, target, open, start, move, inside);
+            measure(board, travel, DOOR_CONTROL_PERIOD/1000, move, last);
+            if(trace) traceStep(start, board);
+        }
+        door.update();
+    }
+    move.ms = board.now() - start;
+
+    /* Let it settle so the next move starts from standing */
+    while(door.update()) board.advance(MOTION_PERIOD);
+    move.impact   = board.impactSpeed();
+    move.position = board.encoder();
+    move.error    = target - move.position;
+    return true;
+}
+
+/* What moveDoor() did before there was a profile: both pins straight
+   to full and off once the encoder reads past the stop.           */
+static bool moveFull(VirtualBoard& board, int32_t travel, bool open, int32_t top, bool trace, Move& move)
+{
+    move = Move();
+    board.resetImpact();
+    uint64_t start  = board.now();
+    int32_t  last   = 0;
+    bool     inside = false;
+
+    board.write(BOARD_MOTOR_PIN1, open);
+    board.write(BOARD_MOTOR_PIN2, !open);
+    while(open ? board.encoder() < top : board.encoder() > 0)
+    {
+        if(board.now() - start > MOVE_TIMEOUT) return false;
+        board.advance(MOTION_PERIOD);
+        track(board, open ? top : 0, open, start, move, inside);
+        measure(board, travel, MOTION_PERIOD, move, last);
+        if(trace) traceStep(start, board);
+    }
+    board.write(BOARD_MOTOR_PIN1, LOW);
+    board.write(BOARD_MOTOR_PIN2, LOW);
+    move.ms = board.now() - start;
+
+    for(int ms = 0; ms < 1000; ms += MOTION_PERIOD)
+    {
+        board.advance(MOTION_PERIOD);
+        track(board, open ? top : 0, open, start, move, inside);
+    }
+    move.impact   = board.impactSpeed();
+    move.position = board.encoder();
+    move.error    = (open ? top : 0) - move.position;
+    return true;
+}
+
+/* Closes onto the board's obstacle, timing each hit until the door
+   either closes or gives up. Returns false if it does neither.    */
+static bool closeObstructed(DoorHandler& door, VirtualBoard& board, uint32_t clearAfter, bool trace)
+{
+    uint64_t start    = board.now();
+    uint64_t lastHit  = board.impactTime();
+    uint64_t firstHit = 0;
+    uint64_t hit      = 0;      // Waiting for the motor to let go, 0 if not
+    int      hits     = 0;
+
+    if(!door.moveDoor(false)) return false;
+    while(door.update())
+    {
+        if(board.now() - start > OBSTRUCTED_TIMEOUT) return false;
+        for(uint32_t ms = 0; ms < MOTION_PERIOD; ms += DOOR_CONTROL_PERIOD/1000)
+        {
+            board.advance(DOOR_CONTROL_PERIOD/1000);
+            door.control();
+            if(trace) traceStep(start, board);
+
+            if(board.impactTime() != lastHit && board.encoder() > 0)
+            {
+                lastHit = hit = board.impactTime();
+                if(!firstHit) firstHit = hit;
+                hits++;
+            }
+            if(hit && board.motorDrive() >= 0)
+            {
+                if(!trace) printf("hit %d at %d counts, motor off it after %llu ms\n", hits, board.encoder(),
+                                  (unsigned long long)(board.now() - hit));
+                hit = 0;
+            }
+            if(firstHit && clearAfter && board.now() - firstHit >= clearAfter) board.setObstacle(0);
+        }
+    }
+
+    if(!trace) printf("%s at %d after %.2f s, %d hits\n", door.isBlocked() ? "blocked" : door.isClosed() ? "closed" : "stopped",
+                      board.encoder(), (board.now() - start) / 1000.0, hits);
+    return true;
+}
+
+/* Runs calibrate() through to rest, from wherever the board is */
+static bool calibrateDoor(DoorHandler& door, VirtualBoard& board, bool trace)
+{
+    uint64_t start = board.now();
+
+    /* control() only samples the encoder whilst calibrating, but it must run */
+    if(!door.calibrate()) return false;
+    while(door.getMotionState() == MOTION_CALIBRATING)
+    {
+        if(board.now() - start > OBSTRUCTED_TIMEOUT) return false;
+        for(uint32_t ms = 0; ms < MOTION_PERIOD; ms += DOOR_CONTROL_PERIOD/1000)
+        {
+            board.advance(DOOR_CONTROL_PERIOD/1000);
+            door.control();
+        }
+        door.update();
+    }
+    while(door.update()) board.advance(MOTION_PERIOD);
+
+    if(!trace)
+    {
+        printf("calibrated in %.2f s, top %d at the encoder's %d\n", (board.now() - start) / 1000.0,
+               door.getTopPosition(), board.encoder());
+        printf("       up %6.2f s  %5u counts/s full duty\n", door.getTravelTime(true) / 1000.0, door.getMotorSpeed(true));
+        printf("       down %4.2f s  %5u counts/s full duty\n", door.getTravelTime(false) / 1000.0, door.getMotorSpeed(false));
+    }
+    return door.isClosed() && door.getMotorSpeed(true) && door.getMotorSpeed(false);
+}
+
+static void printMove(const char* name, const Move& move)
+{
+    printf("%-6s %6.2f s  peak %5d counts/s  %6d counts/s/s  stop hit at %5u counts/s  ended at %d\n",
+           name, move.ms / 1000.0, move.peakSpeed, move.peakAccel, move.impact, move.position);
+    printf("       settled %6.2f s  overshoot %5d counts  steady state error %5d counts\n",
+           move.settle / 1000.0, move.overshoot, move.error);
+}
+
+static bool parseGains(const char* text, PositionGains& gains)
+{
+    return sscanf(text, "%f,%f,%f,%f", &gains.kp, &gains.ki, &gains.kd, &gains.kff) == 4;
+}
+
+int main(int argc, char** argv)
+{
+    std::string profile = "scurve";
+    int         time    = 75;
+    int         accel   = 10;
+    int         decel   = 15;
+    double      load    = 1;
+    int32_t     travel  = BOARD_TRAVEL + BOARD_OVERTRAVEL;
+    int32_t     obstacle = 0;
+    uint32_t    clear   = 0;
+    uint16_t    stall   = 0;
+    bool        trace   = false;
+    bool        calibrate = false;
+    std::vector<PositionGains> gainSets;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg  = argv[i];
+        bool        more = i + 1 < argc;
+        if     (arg == "--profile" && more) profile = argv[++i];
+        else if(arg == "--time"    && more) time    = atoi(argv[++i]);
+        else if(arg == "--accel"   && more) accel   = atoi(argv[++i]);
+        else if(arg == "--decel"   && more) decel   = atoi(argv[++i]);
+        else if(arg == "--load"    && more) load    = atof(argv[++i]);
+        else if(arg == "--travel"  && more) travel  = atoi(argv[++i]);
+        else if(arg == "--obstacle" && more) obstacle = atoi(argv[++i]);
+        else if(arg == "--clear"   && more) clear   = atoi(argv[++i]);
+        else if(arg == "--stall"   && more) stall   = atoi(argv[++i]);
+        else if(arg == "--trace")           trace   = true;
+        else if(arg == "--calibrate")       calibrate = true;
+        else if(arg == "--gains"   && more)
+        {
+            PositionGains gains;
+            if(!parseGains(argv[++i], gains))
+            {
+                fprintf(stderr, "motorsim: --gains wants KP,KI,KD,KFF, not %s\n", argv[i]);
+                return 2;
+            }
+            gainSets.push_back(gains);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--profile scurve|trapezoid|full] [--time N] [--accel N] [--decel N]\n"
+                            "       [--load F] [--gains KP,KI,KD,KFF]... [--travel N] [--obstacle N [--clear MS]] [--stall MS]\n"
+                            "       [--calibrate] [--trace]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(profile != "scurve" && profile != "trapezoid" && profile != "full")
+    {
+        fprintf(stderr, "motorsim: unknown profile %s\n", profile.c_str());
+        return 2;
+    }
+    if(obstacle && (profile == "full" || obstacle <= 0 || obstacle >= BOARD_TRAVEL))
+    {
+        fprintf(stderr, "motorsim: --obstacle wants a profile and 0 < N < %d\n", BOARD_TRAVEL);
+        return 2;
+    }
+
+    /* Same bring up as setup(), on a blank EEPROM */
+    VirtualBoard board;
+    VirtualBoard::select(&board);
+    board.setMotorSpeed(BOARD_MOTOR_SPEED * load);
+    board.setTravel(travel);
+
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+    door.beginBatch();
+    door.setMotorMoveSpeed(time);
+    door.setMotorAccelTime(accel);
+    door.setMotorDecelTime(decel);
+    door.setMotorProfile(profile == "trapezoid" ? PROFILE_TRAPEZOID : PROFILE_SCURVE);
+    door.endBatch();
+    if(stall) door.setStallTime(stall);
+    if(gainSets.empty()) gainSets.push_back(door.getGains());
+
+    int32_t top    = BOARD_TRAVEL;
+    bool    passed = true;
+
+    if(trace) printf("ms,drive,velocity,position\n");
+    else printf("profile %s, %.1fs travel, %.1fs accel, %.1fs decel, load %.2f, stop %d past open\n",
+                profile.c_str(), time / 10.0, accel / 10.0, decel / 10.0, load, travel - top);
+
+    if(calibrate)
+    {
+        board.setEncoder(travel / 3);
+        if(!calibrateDoor(door, board, trace))
+        {
+            fprintf(stderr, "motorsim: calibration didn't finish closed, ended at %d\n", board.encoder());
+            return 1;
+        }
+        top = door.getTopPosition();
+    }
+
+    for(const PositionGains& gains : gainSets)
+    {
+        Move opening, closing;
+        bool ok;
+
+        door.setGains(gains);
+        if(obstacle)
+        {
+            if(!trace) printf("\ngains kp %.3f ki %.3f kd %.3f kff %.3f, obstacle at %d\n",
+                              gains.kp, gains.ki, gains.kd, gains.kff, obstacle);
+            board.setObstacle(obstacle);
+            bool closed = moveDoor(door, board, travel, top, true, false, opening) && closeObstructed(door, board, clear, trace);
+            if(!closed || (clear ? !door.isClosed() : !door.isBlocked()))
+            {
+                fprintf(stderr, "motorsim: door should have ended %s\n", clear ? "closed" : "blocked");
+                passed = false;
+            }
+            board.setObstacle(0);
+            board.setEncoder(0);
+            continue;
+        }
+
+        if(profile == "full")
+            ok = moveFull(board, travel, true, top, trace, opening) && moveFull(board, travel, false, top, trace, closing);
+        else
+            ok = moveDoor(door, board, travel, top, true, trace, opening) && moveDoor(door, board, travel, 0, false, trace, closing);
+
+        if(!trace)
+        {
+            printf("\ngains kp %.3f ki %.3f kd %.3f kff %.3f\n", gains.kp, gains.ki, gains.kd, gains.kff);
+            printMove("open", opening);
+            printMove("close", closing);
+        }
+
+        /* Full power has no loop to bring it back, only its stops count */
+        bool rested = profile == "full" || (abs(opening.error) <= SETTLE_BAND && abs(closing.error) <= SETTLE_BAND);
+        if(!ok || !rested)
+        {
+            fprintf(stderr, "motorsim: door didn't come to rest on target, ended open at %d and closed at %d\n",
+                    opening.position, closing.position);
+            passed = false;
+        }
+
+        /* Back to closed for the next set, whatever this one did */
+        board.setEncoder(0);
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+/* parsebench - lib/CommandParser against the ParameterBuffer it replaced.
+
+   Usage: parsebench fuzz [cases]
+          parsebench throughput [commands]
+     fuzz        random datagrams of 0 to COMMAND_LENGTH bytes, mostly
+                 digits, signs and separators, each placed hard against
+                 a page the process can't read, so a read past the
+                 length faults. Every result is checked against a
+                 reference built on strtoll().
+     throughput  the commands the old parser could express, "o", "c",
+                 "4120", "520" and so on, through both paths: the old
+                 copy out of the receive buffer into ParameterBuffer,
+                 and CommandParser on the buffer in place. Each must
+                 give the argument ParameterBuffer did.
+
+   ParameterBuffer is as it was in src/main.cpp bar its copy, which
+   now stops at the three characters it has room for and ends in the
+   NUL atoi() read past. Exits non-zero on a
+   mismatch; a read out of bounds is a SIGSEGV.                      */
+#include <CommandParser.h>
+#include <DoorTask.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* src/main.cpp's parser before lib/CommandParser */
+class ParameterBuffer
+{
+
+    public:
+        ParameterBuffer(char* buf, int len)
+        {
+            m_command = len > 0 ? buf[0] : ILLEGAL_COMMAND;
+            /* If this command has no parameters */
+            if(len <= 1)
+            {
+                m_valid = false;
+                m_argument = 0;
+                m_length = 0;
+            }
+            /* Command has parameters            */
+            else
+            {
+                /* Pre-emptive setup for parsing */
+                m_valid = true;
+                /* If value exceeds 255 (3 char) then max length at 3*/
+                m_length = len-1 > 3 ? 3 : len-1;
+
+                /* Find values, fill buffer and parse */
+                char tmpBuf[m_length + 1];
+                for( uint8_t i = 1 ; i <= m_length; i++)
+                    tmpBuf[i-1] = buf[i];
+                tmpBuf[m_length] = '\0';
+                /* Parse the buffer into a uint8_t    */
+                m_argument = atoi(tmpBuf);
+            }
+        }
+
+        uint8_t getArgument() {return m_argument;                  }
+        char    getCommand()  {return m_command;                   }
+        bool    hasParameter(){return m_valid;                     }
+
+    private:
+        uint8_t m_argument;
+        uint8_t m_length;
+        char    m_command;
+        bool    m_valid;
+
+};
+
+static uint32_t seed = 1;
+static uint32_t next()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* What CommandParser should make of buf, the slow and obvious way */
+struct Parsed{
+    char    command;
+    uint8_t count;
+    int32_t arguments[COMMAND_MAX_ARGUMENTS];
+    bool    valid;
+};
+
+static Parsed reference(const char* buf, uint16_t len)
+{
+    std::string text(buf, len);
+    Parsed      parsed = {ILLEGAL_COMMAND, 0, {0}, true};
+    const char* separators = " ,\t\r\n";
+
+    size_t i = text.find_first_not_of(separators);
+    if(i == std::string::npos) return parsed;
+    parsed.command = text[i++];
+
+    while((i = text.find_first_not_of(separators, i)) != std::string::npos)
+    {
+        size_t      end   = text.find_first_of(separators, i);
+        std::string token = text.substr(i, end == std::string::npos ? std::string::npos : end - i);
+        i = end == std::string::npos ? text.size() : end;
+
+        /* [+-] then digits, nothing else, in int32_t */
+        size_t digits = token[0] == '+' || token[0] == '-' ? 1 : 0;
+        bool   ok     = parsed.count < COMMAND_MAX_ARGUMENTS && token.size() > digits &&
+                        token.find_first_not_of("0123456789", digits) == std::string::npos;
+        long long value = ok ? strtoll(token.c_str(), nullptr, 10) : 0;
+        if(!ok || value < INT32_MIN || value > INT32_MAX)
+        {
+            parsed.valid = false;
+            return parsed;
+        }
+        parsed.arguments[parsed.count++] = value;
+    }
+    return parsed;
+}
+
+/* Mostly the characters a command is made of, now and then anything */
+static char randomChar()
+{
+    static const char alphabet[] = "0123456789012345678901234567890123456789 , ,-+\t\n4578lto";
+    uint32_t r = next();
+    if(r % 16 == 0) return (char)(r >> 8);
+    return alphabet[(r >> 8) % (sizeof(alphabet) - 1)];
+}
+
+static int fuzz(uint32_t cases)
+{
+    /* Two pages, the second unreadable, datagrams end where it starts */
+    long  page  = sysconf(_SC_PAGESIZE);
+    char* guard = (char*)mmap(nullptr, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(guard == MAP_FAILED || mprotect(guard + page, page, PROT_NONE))
+    {
+        perror("parsebench: guard page");
+        return 1;
+    }
+    char* end = guard + page;
+
+    uint32_t valid = 0, arguments = 0;
+    for(uint32_t c = 0; c < cases; c++)
+    {
+        uint16_t len = next() % (COMMAND_LENGTH + 1);
+        char*    buf = end - len;
+        for(uint16_t i = 0; i < len; i++) buf[i] = randomChar();
+
+        /* Now and then a number right at the edge of int32_t */
+        if(len > 12 && next() % 8 == 0)
+            memcpy(buf + 1, next() % 2 ? " -2147483648" : " 2147483648", next() % 2 ? 12 : 11);
+
+        CommandParser parser(buf, len);
+        Parsed        expected = reference(buf, len);
+        bool          same     = parser.getCommand() == expected.command && parser.isValid() == expected.valid;
+        if(same && expected.valid)
+        {
+            same = parser.getArgumentCount() == expected.count;
+            for(uint8_t a = 0; same && a < expected.count; a++)
+                same = parser.getArgument(a) == expected.arguments[a];
+        }
+        if(!same)
+        {
+            fprintf(stderr, "parsebench: case %u parsed differently: \"%.*s\"\n", c, len, buf);
+            fprintf(stderr, "  got command %d valid %d count %u, expected command %d valid %d count %u\n",
+                    parser.getCommand(), parser.isValid(), parser.getArgumentCount(), expected.command,
+                    expected.valid, expected.count);
+            return 1;
+        }
+        valid     += expected.valid && expected.command != ILLEGAL_COMMAND;
+        arguments += expected.valid ? expected.count : 0;
+    }
+
+    printf("cases           %u datagrams of 0 to %d bytes against a guard page\n", cases, COMMAND_LENGTH);
+    printf("valid           %u commands, %u arguments, all as the reference\n", valid, arguments);
+    return 0;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int throughput(uint32_t commands)
+{
+    /* What a controller sent ParameterBuffer, one command per datagram */
+    static const char* corpus[] = {"o", "c", "s", "4120", "520", "640", "73", "l1", "t0", "890", "a1"};
+    const uint8_t CORPUS_COUNT = sizeof(corpus)/sizeof(corpus[0]);
+    char  packets[CORPUS_COUNT][COMMAND_LENGTH];
+    int   lengths[CORPUS_COUNT];
+    for(uint8_t i = 0; i < CORPUS_COUNT; i++)
+    {
+        lengths[i] = strlen(corpus[i]);
+        memcpy(packets[i], corpus[i], lengths[i]);
+    }
+
+    /* Both must agree wherever the old one had an argument */
+    for(uint8_t i = 0; i < CORPUS_COUNT; i++)
+    {
+        ParameterBuffer old(packets[i], lengths[i]);
+        CommandParser   parser(packets[i], lengths[i]);
+        if(old.getCommand() != parser.getCommand() || old.hasParameter() != parser.hasParameter() ||
+           (old.hasParameter() && old.getArgument() != parser.getArgument()))
+        {
+            fprintf(stderr, "parsebench: \"%s\" parses differently\n", corpus[i]);
+            return 1;
+        }
+    }
+
+    /* pollNetwork()'s old path, the datagram copied out of the
+       receive buffer then again by ParameterBuffer. The sum keeps
+       the compiler from dropping the parse.                    */
+    uint32_t oldSum = 0, newSum = 0;
+    auto     start  = std::chrono::steady_clock::now();
+    for(uint32_t c = 0; c < commands; c++)
+    {
+        uint8_t i = c % CORPUS_COUNT;
+        char    incomingPacket[lengths[i]];
+        memcpy(incomingPacket, packets[i], lengths[i]);
+        ParameterBuffer old(incomingPacket, lengths[i]);
+        oldSum += old.getCommand() + old.getArgument();
+    }
+    double oldSeconds = seconds(start);
+
+    /* The new one, tokenised where it was received */
+    start = std::chrono::steady_clock::now();
+    for(uint32_t c = 0; c < commands; c++)
+    {
+        uint8_t       i = c % CORPUS_COUNT;
+        CommandParser parser(packets[i], lengths[i]);
+        newSum += parser.getCommand() + (uint8_t)parser.getArgument();
+    }
+    double newSeconds = seconds(start);
+
+    if(oldSum != newSum)
+    {
+        fprintf(stderr, "parsebench: the parsers disagreed, %u against %u\n", oldSum, newSum);
+        return 1;
+    }
+    printf("commands        %u, %d distinct\n", commands, CORPUS_COUNT);
+    printf("copy + old      %6.1f ns/command  %6.2f M/s\n", oldSeconds * 1e9 / commands, commands / oldSeconds / 1e6);
+    printf("in place        %6.1f ns/command  %6.2f M/s\n", newSeconds * 1e9 / commands, commands / newSeconds / 1e6);
+    printf("ratio           %6.2fx\n", oldSeconds / newSeconds);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode  = argc > 1 ? argv[1] : "";
+    uint32_t    count = argc > 2 ? strtoul(argv[2], nullptr, 0) : 0;
+
+    if(mode == "fuzz")       return fuzz(count ? count : 1000000);
+    if(mode == "throughput") return throughput(count ? count : 20000000);
+
+    fprintf(stderr, "Usage: %s fuzz [cases] | throughput [commands]\n", argv[0]);
+    return 2;
+}
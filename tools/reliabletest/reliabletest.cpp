@@ -0,0 +1,235 @@
+/* reliabletest - lib/ReliableChannel over loopback UDP, datagrams
+   dropped on purpose and the door restarting part way through.
+
+   Usage: reliabletest window|collector [events] [loss%] [ackloss%] [gap]
+     window      the collector side is a bare ReliableReceiver
+     collector   the collector side is tools/collector's Collector,
+                 parsing, ACKing and de-duplicating as the daemon
+                 does; it must also count every restart
+
+   Two sockets on 127.0.0.1, the door's and the collector's. The door
+   sends 'events' reliable events 'gap' ms apart through a shim
+   dropping loss% of them; the collector ACKs each, duplicates too,
+   through one dropping ackloss%. Every RESTART_EVERY events the door
+   restarts as after ESP.restart(): a new ReliableSender counting from
+   0 under a new epoch. Time is simulated, the backoff runs to the ms
+   but the test takes no real time waiting.
+
+   The door side handles ACKs as pollNetwork() does. Every event must reach
+   the collector exactly once, exits non-zero otherwise. With heavy
+   loss and a short gap the sender's RELIABLE_WINDOW fills and drops
+   its oldest, so events are lost by design, e.g. 40 60 at 3000ms.  */
+#include <ReliableChannel.h>
+#include <CommandParser.h>
+#include "../collector/Collector.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define DOOR_ID         1
+#define EVENT_GAP       3000        // ms between events by default, DM:0 and DM:1 are further apart than this
+#define RESTART_EVERY   13          // Events per boot, not a multiple of anything in the window
+#define TICK            10          // ms, the network task's loop is NETWORK_PERIOD but retransmits are finer
+#define SETTLE_TIME     120000      // ms after the last event, RELIABLE_MAX_ATTEMPTS of backoff is ~80s
+
+static uint32_t seed = 1;
+static uint32_t next()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+struct Link{
+    int         sock;
+    sockaddr_in to;
+    uint32_t    loss;               // Percent dropped
+    uint32_t    sent;
+    uint32_t    dropped;
+};
+
+static Link door, collector;
+
+/* The loss shim, a dropped datagram never reaches the socket */
+static void transmit(Link& link, const void* data, size_t length)
+{
+    link.sent++;
+    if(next() % 100 < link.loss)
+    {
+        link.dropped++;
+        return;
+    }
+    sendto(link.sock, data, length, 0, (const sockaddr*)&link.to, sizeof(link.to));
+}
+
+/* transmitReliable() of src/main.cpp */
+static bool transmitEvent(uint16_t epoch, uint16_t sequence, const char* payload, uint8_t length)
+{
+    char message[128];
+    int  written = snprintf(message, sizeof(message), "(ID:%d)-E%u,%u:%.*s", DOOR_ID, sequence, epoch, length, payload);
+    transmit(door, message, written);
+    return true;
+}
+
+static int openSocket(sockaddr_in& address)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if(sock < 0 || bind(sock, (const sockaddr*)&address, sizeof(address)) ||
+       getsockname(sock, (sockaddr*)&address, &length))
+    {
+        perror("reliabletest: socket");
+        exit(1);
+    }
+    return sock;
+}
+
+/* The collector, ACK then de-duplicate, counting each event it keeps.
+   Through a Collector, kept events are counted from its log output. */
+static void collectorPoll(ReliableReceiver& window, Collector* daemon, std::vector<uint32_t>& delivered,
+                          uint32_t& malformed, uint32_t now)
+{
+    char    datagram[256];
+    ssize_t length;
+    while((length = recv(collector.sock, datagram, sizeof(datagram) - 1, MSG_DONTWAIT)) > 0)
+    {
+        if(daemon)
+        {
+            Endpoint from = {ntohl(collector.to.sin_addr.s_addr), ntohs(collector.to.sin_port)};
+            Reply    reply;
+            if(daemon->ingest((const uint8_t*)datagram, length, from, now, reply))
+                transmit(collector, reply.data, reply.length);
+            continue;
+        }
+
+        datagram[length] = '\0';
+        unsigned id, sequence, epoch, event;
+        if(sscanf(datagram, "(ID:%u)-E%u,%u:EV%u", &id, &sequence, &epoch, &event) != 4 || event >= delivered.size())
+        {
+            malformed++;
+            continue;
+        }
+
+        char ack[24];
+        transmit(collector, ack, snprintf(ack, sizeof(ack), "A%u,%u", sequence, epoch));
+        if(window.accept(sequence, epoch)) delivered[event]++;
+    }
+}
+
+/* pollNetwork(), ACKs go straight to the sender */
+static void doorPoll(ReliableSender& sender)
+{
+    char    datagram[64];
+    ssize_t length;
+    while((length = recv(door.sock, datagram, sizeof(datagram), MSG_DONTWAIT)) > 0)
+    {
+        if(datagram[0] != 'A') continue;
+        CommandParser ack(datagram, length);
+        if(ack.hasArgument(0, 65535, 1))   sender.acknowledge(ack.getArgument(), ack.getArgument(1));
+        else if(ack.hasArgument(0, 65535)) sender.acknowledge(ack.getArgument());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+    if(mode != "window" && mode != "collector")
+    {
+        fprintf(stderr, "Usage: %s window|collector [events] [loss%%] [ackloss%%] [gap]\n", argv[0]);
+        return 2;
+    }
+    uint32_t events  = argc > 2 ? strtoul(argv[2], nullptr, 0) : 2000;
+    door.loss        = argc > 3 ? strtoul(argv[3], nullptr, 0) : 20;
+    collector.loss   = argc > 4 ? strtoul(argv[4], nullptr, 0) : 20;
+    uint32_t gap     = argc > 5 ? strtoul(argv[5], nullptr, 0) : EVENT_GAP;
+
+    sockaddr_in doorAddress, collectorAddress;
+    door.sock      = openSocket(doorAddress);
+    collector.sock = openSocket(collectorAddress);
+    door.to        = collectorAddress;
+    collector.to   = doorAddress;
+
+    ReliableReceiver      window;
+    char*                 logText   = nullptr;
+    size_t                logLength = 0;
+    FILE*                 log       = mode == "collector" ? open_memstream(&logText, &logLength) : nullptr;
+    Collector*            daemon    = log ? new Collector(nullptr, log) : nullptr;
+    std::vector<uint32_t> delivered(events, 0);
+    uint32_t              malformed = 0, boots = 0;
+    uint16_t              epoch     = 0;
+
+    /* Sends on schedule, unless the door is waiting to restart */
+    ReliableSender* sender = nullptr;
+    uint32_t        event  = 0, now = 0, last = 0;
+    for(; event < events || now < last + SETTLE_TIME; now += TICK)
+    {
+        /* A new boot once the last one's events are through, counting from 0 again */
+        if(event < events && boots <= event / RESTART_EVERY && (!sender || sender->pending() == 0))
+        {
+            delete sender;
+            sender = new ReliableSender(transmitEvent);
+            uint16_t previous = epoch;
+            while((epoch = next()) == previous || epoch == 0) {}
+            sender->begin(epoch);
+            boots++;
+        }
+
+        if(event < events && boots > event / RESTART_EVERY && now >= event * gap)
+        {
+            char payload[16];
+            sender->send(payload, snprintf(payload, sizeof(payload), "EV%u", event), now);
+            event++;
+            last = now;
+        }
+
+        sender->poll(now);
+        collectorPoll(window, daemon, delivered, malformed, now);
+        doorPoll(*sender);
+    }
+    delete sender;
+
+    /* "(ID:1)-EV<n>" for every event the Collector kept */
+    uint32_t restarts = boots - 1;
+    if(daemon)
+    {
+        fclose(log);
+        for(char* line = strtok(logText, "\n"); line; line = strtok(nullptr, "\n"))
+        {
+            unsigned event;
+            if(sscanf(line, "(ID:%*u)-EV%u", &event) == 1 && event < events) delivered[event]++;
+            else malformed++;
+        }
+        malformed += daemon->stats().malformed;
+        restarts   = daemon->doors().get(DOOR_ID).restarts;
+        free(logText);
+    }
+
+    uint32_t lost = 0, duplicated = 0;
+    for(uint32_t count : delivered)
+    {
+        lost       += count == 0;
+        duplicated += count > 1;
+    }
+
+    printf("events          %u over %u boots, one every %u ms, %u%% of events and %u%% of ACKs dropped\n", events,
+           boots, gap, door.loss, collector.loss);
+    printf("datagrams       %u events sent, %u dropped; %u ACKs sent, %u dropped\n", door.sent, door.dropped,
+           collector.sent, collector.dropped);
+    printf("delivered       %u once, %u lost, %u more than once, %u malformed\n", events - lost - duplicated, lost,
+           duplicated, malformed);
+    if(daemon) printf("restarts        %u seen by the collector of %u\n", restarts, boots - 1);
+    delete daemon;
+    close(door.sock);
+    close(collector.sock);
+    return lost || duplicated || malformed || restarts != boots - 1 ? 1 : 0;
+}
@@ -0,0 +1,328 @@
+/* schedtest - drives the Scheduler on a fake clock with the firmware's
+   own job layout and checks it keeps time.
+
+   Usage: schedtest [minutes]
+   Runs each of, in turn:
+     door      the door task's jobs, with a move every few minutes,
+               each job late by no more than SCHEDTEST_MAX_JITTER
+               and none drifting off its period
+     network   commands arriving at random against the network
+               task's jobs; the worst wait before pollNetwork() sees
+               one, next to the old 1s loop that polled every 5th pass
+     wrap      the door task again, across millis() overflowing
+     stall     a job blocking for seconds, periodic jobs resync
+               rather than running back to back to catch up
+     oneshot   the automation delay: fires once, re-arms, disarms
+
+   Every job costs a random few ms of fake time, sleeps overrun by up
+   to a tick and are cut short at random as a task notification would.
+   Exits non-zero on the first failure.                              */
+#include <Scheduler.h>
+#include <DoorTask.h>
+#include <cstdio>
+#include <cstdlib>
+
+#define SCHEDTEST_MAX_JITTER    10      // ms late, a pass of job costs plus a tick
+#define SCHEDTEST_COMMAND_GAP   300     // ms, longest gap between random commands
+#define SCHEDTEST_STALL         3000    // ms a stalled job blocks for
+#define TICK                    1       // ms, FreeRTOS tick at 1kHz
+
+static uint32_t fakeNow = 0;
+static unsigned long fakeClock()
+{
+    return fakeNow;
+}
+
+static uint32_t seed = 1;
+static uint32_t next()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* Wrap safe, as the scheduler compares */
+static bool reached(uint32_t deadline)
+{
+    return (int32_t)(fakeNow - deadline) >= 0;
+}
+
+/* What a job expects of its own timing, mirrored from Scheduler::run() */
+struct Timing{
+    const char* name;
+    uint32_t    period;
+    uint32_t    deadline;
+    uint32_t    cost;       // Most a run costs, ms
+    uint32_t    runs;
+    uint32_t    worst;      // Latest past its deadline
+    uint32_t    resyncs;
+};
+
+static Timing* timings[SCHEDULER_MAX_JOBS];
+
+static void track(Timing& t)
+{
+    uint32_t late = fakeNow - t.deadline;
+    if(late > t.worst) t.worst = late;
+    t.runs++;
+
+    t.deadline += t.period;
+    if(reached(t.deadline))
+    {
+        t.deadline = fakeNow + t.period;
+        t.resyncs++;
+    }
+    fakeNow += t.cost ? next() % (t.cost + 1) : 0;
+}
+
+/* One job function per slot, a Job takes no arguments */
+template<int N> static void job() {track(*timings[N]);}
+static const Scheduler::Job jobs[] = {job<0>, job<1>, job<2>, job<3>, job<4>, job<5>, job<6>, job<7>};
+
+static int8_t add(Scheduler& scheduler, uint8_t slot, Timing& t, uint32_t firstDelay)
+{
+    t.deadline = fakeNow + firstDelay;
+    timings[slot] = &t;
+    return scheduler.add(jobs[slot], t.period, firstDelay);
+}
+
+/* The task loop: run, then sleep until the next deadline or a notification */
+static void loopFor(Scheduler& scheduler, uint32_t duration)
+{
+    uint32_t end = fakeNow + duration;
+    while(!reached(end))
+    {
+        uint32_t wait = scheduler.run();
+        if(wait && next() % 4 == 0) wait = next() % wait;
+        fakeNow += wait + next() % (TICK + 1);
+    }
+}
+
+static int checkTiming(const Timing& t, uint32_t duration)
+{
+    uint32_t expected = duration / t.period;
+    if(t.worst > SCHEDTEST_MAX_JITTER || t.resyncs || t.runs + 1 < expected || t.runs > expected + 1)
+    {
+        fprintf(stderr, "schedtest: %s ran %u times, expected %u, worst %ums late, %u resyncs\n",
+                t.name, t.runs, expected, t.worst, t.resyncs);
+        return 1;
+    }
+    printf("  %-12s %8u runs  worst %2ums late\n", t.name, t.runs, t.worst);
+    return 0;
+}
+
+/* The door task as DoorTask::begin() lays it out. doorJob() starts a
+   move every few minutes and the motion job disarms itself after it,
+   as pollDoor() and doorMotionJob() do.                            */
+static Scheduler* doorScheduler = nullptr;
+static int8_t   motion   = SCHEDULER_NO_JOB;
+static uint32_t moveEnd  = 0, nextMove = 0;
+static Timing   doorTiming   = {"doorJob",    POLLING_PERIOD, 0, 2, 0, 0, 0};
+static Timing   motionTiming = {"doorMotion", MOTION_PERIOD,  0, 1, 0, 0, 0};
+
+static void doorJob()
+{
+    track(doorTiming);
+    if(!reached(nextMove) || doorScheduler->isArmed(motion)) return;
+
+    doorScheduler->arm(motion, 0);
+    motionTiming.deadline = fakeNow;
+    moveEnd  = fakeNow + 7000 + next() % 3000;
+    nextMove = fakeNow + 60000 + next() % 240000;
+}
+
+static void doorMotionJob()
+{
+    track(motionTiming);
+    if(reached(moveEnd)) doorScheduler->disarm(motion);
+}
+
+static int testDoor(uint32_t minutes, uint32_t start)
+{
+    fakeNow = start;
+    Scheduler scheduler(fakeClock);
+    doorScheduler = &scheduler;
+
+    Timing offline   = {"offlineJob", OFFLINE_PERIOD,   0, 1, 0, 0, 0};
+    Timing heartbeat = {"heartbeat",  HEARTBEAT_PERIOD, 0, 3, 0, 0, 0};
+    doorTiming.runs = doorTiming.worst = doorTiming.resyncs = 0;
+    motionTiming.runs = motionTiming.worst = motionTiming.resyncs = 0;
+    doorTiming.deadline = fakeNow + POLLING_PERIOD;
+    scheduler.add(doorJob, POLLING_PERIOD, POLLING_PERIOD);
+    add(scheduler, 1, offline, OFFLINE_PERIOD);
+    motion = scheduler.add(doorMotionJob, MOTION_PERIOD, 0, false);
+    add(scheduler, 3, heartbeat, HEARTBEAT_PERIOD);
+    nextMove = fakeNow + 30000;
+
+    uint32_t duration = minutes * 60000;
+    loopFor(scheduler, duration);
+
+    if(checkTiming(doorTiming, duration) || checkTiming(offline, duration) || checkTiming(heartbeat, duration)) return 1;
+    if(motionTiming.worst > SCHEDTEST_MAX_JITTER || motionTiming.resyncs)
+    {
+        fprintf(stderr, "schedtest: motion step %ums late, %u resyncs\n", motionTiming.worst, motionTiming.resyncs);
+        return 1;
+    }
+    printf("  %-12s %8u runs  worst %2ums late, only whilst moving\n", motionTiming.name, motionTiming.runs, motionTiming.worst);
+    return 0;
+}
+
+/* Commands arrive at random, pollNetwork() sees everything up to now */
+static uint32_t arrival = 0, commands = 0, worstWait = 0;
+static uint64_t totalWait = 0;
+
+static void pollNetwork()
+{
+    while(reached(arrival))
+    {
+        uint32_t wait = fakeNow - arrival;
+        if(wait > worstWait) worstWait = wait;
+        totalWait += wait;
+        commands++;
+        arrival += 1 + next() % SCHEDTEST_COMMAND_GAP;
+    }
+}
+
+static Timing networkTiming = {"networkJob", NETWORK_PERIOD, 0, 2, 0, 0, 0};
+static void networkJob()
+{
+    track(networkTiming);
+    pollNetwork();
+}
+
+static int testNetwork(uint32_t minutes)
+{
+    fakeNow = 0;
+    Scheduler scheduler(fakeClock);
+
+    Timing retransmit = {"retransmit", RETRANSMIT_PERIOD, 0, 1, 0, 0, 0};
+    Timing reconnect  = {"reconnect",  RECONNECT_PERIOD,  0, 0, 0, 0, 0};
+    networkTiming.deadline = NETWORK_PERIOD;
+    scheduler.add(networkJob, NETWORK_PERIOD, NETWORK_PERIOD);
+    add(scheduler, 1, retransmit, RETRANSMIT_PERIOD);
+    add(scheduler, 2, reconnect, RECONNECT_PERIOD);
+
+    uint32_t duration = minutes * 60000;
+    arrival = 1 + next() % SCHEDTEST_COMMAND_GAP;
+    loopFor(scheduler, duration);
+
+    if(checkTiming(networkTiming, duration) || checkTiming(retransmit, duration) || checkTiming(reconnect, duration)) return 1;
+    if(worstWait > NETWORK_PERIOD + SCHEDTEST_MAX_JITTER)
+    {
+        fprintf(stderr, "schedtest: a command waited %ums for pollNetwork()\n", worstWait);
+        return 1;
+    }
+    printf("  commands     %8u      mean %.1fms, worst %ums before pollNetwork()\n", commands,
+           commands ? (double)totalWait / commands : 0.0, worstWait);
+
+    /* The loop it replaced, delay(1000) and pollNetwork() on every 5th pass */
+    uint32_t scheduled = worstWait;
+    fakeNow = 0;
+    commands = worstWait = 0;
+    totalWait = 0;
+    arrival = 1 + next() % SCHEDTEST_COMMAND_GAP;
+    for(uint32_t counter = 1; fakeNow < duration; counter++)
+    {
+        if(counter % 5 == 0) pollNetwork();
+        fakeNow += 1000;
+    }
+    printf("  old loop     %8u      mean %.1fms, worst %ums\n", commands,
+           commands ? (double)totalWait / commands : 0.0, worstWait);
+    return scheduled < worstWait ? 0 : 1;
+}
+
+/* One job blocks for seconds, e.g. a reconnect, the rest must not burst */
+static Timing   stallTiming = {"stalls", 60000,          0, 0, 0, 0, 0};
+static Timing   fastTiming  = {"fast",   NETWORK_PERIOD, 0, 0, 0, 0, 0};
+static uint32_t lastFast = 0, shortestGap = UINT32_MAX;
+
+static void stallJob()
+{
+    track(stallTiming);
+    fakeNow += SCHEDTEST_STALL;
+}
+
+static void fastJob()
+{
+    if(fastTiming.runs && fakeNow - lastFast < shortestGap) shortestGap = fakeNow - lastFast;
+    lastFast = fakeNow;
+    track(fastTiming);
+}
+
+static int testStall()
+{
+    fakeNow = 0;
+    Scheduler scheduler(fakeClock);
+
+    fastTiming.deadline  = NETWORK_PERIOD;
+    stallTiming.deadline = 30000;
+    scheduler.add(fastJob, NETWORK_PERIOD, NETWORK_PERIOD);
+    scheduler.add(stallJob, stallTiming.period, 30000);
+    loopFor(scheduler, 5 * 60000);
+
+    /* Once straight after each stall, not once per missed period */
+    if(shortestGap + SCHEDTEST_MAX_JITTER < NETWORK_PERIOD || fastTiming.resyncs != stallTiming.runs)
+    {
+        fprintf(stderr, "schedtest: runs %ums apart around a %ums stall, %u resyncs for %u stalls\n",
+                shortestGap, SCHEDTEST_STALL, fastTiming.resyncs, stallTiming.runs);
+        return 1;
+    }
+    printf("  stall        %8u stalls of %ums, resynced, never closer than %ums\n", stallTiming.runs,
+           SCHEDTEST_STALL, shortestGap);
+    return 0;
+}
+
+static uint32_t fired = 0;
+static void automationExpiry() {fired++;}
+
+static int testOneShot()
+{
+    fakeNow = 0xFFFFFFFF - 1000;
+    Scheduler scheduler(fakeClock);
+    int8_t id = scheduler.add(automationExpiry, 0, AUTOMATION_DELAY_X);
+
+    bool ok = scheduler.timeUntil(id) == AUTOMATION_DELAY_X;
+    fakeNow += AUTOMATION_DELAY_X - 1;
+    scheduler.run();
+    ok = ok && fired == 0 && scheduler.timeUntil(id) == 1;
+    fakeNow += 1;
+    scheduler.run();
+    scheduler.run();
+    ok = ok && fired == 1 && !scheduler.isArmed(id) && scheduler.timeUntil(id) == 0;
+
+    /* delayAutomation() restarting the window, then 'a' cancelling it */
+    scheduler.arm(id, 1000);
+    fakeNow += 500;
+    scheduler.arm(id, 1000);
+    fakeNow += 999;
+    scheduler.run();
+    ok = ok && fired == 1;
+    scheduler.disarm(id);
+    fakeNow += 10;
+    ok = ok && scheduler.run() == 1000 && fired == 1;
+
+    if(!ok)
+    {
+        fprintf(stderr, "schedtest: one-shot fired %u times\n", fired);
+        return 1;
+    }
+    printf("  oneshot      fires once across the wrap, re-arms and disarms\n");
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t minutes = argc > 1 ? strtoul(argv[1], nullptr, 0) : 24 * 60;
+
+    printf("door, %u simulated minutes\n", minutes);
+    if(testDoor(minutes, 0)) return 1;
+    printf("network\n");
+    if(testNetwork(minutes)) return 1;
+    printf("wrap, from %u\n", 0xFFFFFFFF - 60000);
+    if(testDoor(5, 0xFFFFFFFF - 60000)) return 1;
+    printf("stall\n");
+    if(testStall()) return 1;
+    printf("oneshot\n");
+    return testOneShot();
+}
@@ -0,0 +1,264 @@
+/* spscbench - the handoff between src/main.cpp's network and door
+   tasks, with std::thread standing in for the FreeRTOS tasks.
+
+   Usage: spscbench throughput [items]
+          spscbench latency [items]
+     throughput  the network task pushing Commands as fast as the ring
+                 takes them and the door task popping them, against a
+                 mutex guarded deque of the same depth; every item must
+                 arrive once and in order
+     latency     one Command at a time, each push followed by a wake
+                 as wakeTask() does, the door task sleeping in a
+                 stand in for ulTaskNotifyTake() between them; push to
+                 pop time, percentiles over every item
+
+   Queue depths and item sizes are those of src/main.cpp. Threads are
+   pinned to separate CPUs where there are two. Exits non-zero if an
+   item is lost, duplicated or out of order.                         */
+#include <SpscQueue.h>
+#include <DoorTask.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define COMMAND_QUEUE_SIZE  16          // As src/main.cpp
+#define EVENT_QUEUE_SIZE    8
+#define NETWORK_CORE        0
+#define DOOR_CORE           1
+#define DOOR_SLEEP          1000        // ms, longest the door task sleeps, the Scheduler's MAX_IDLE_SLEEP
+
+/* src/main.cpp's Command and Event, an IPAddress is four bytes */
+struct Command{
+    char      packet[COMMAND_LENGTH];
+    uint8_t   length;
+    uint32_t  address;
+    uint16_t  port;
+    uint64_t  sent;         // Bench only, ns the producer pushed it
+    uint32_t  sequence;     // Bench only
+};
+
+struct Event{
+    char      message[RESPONSE_LENGTH];
+    uint8_t   length;
+    uint32_t  address;
+    uint16_t  port;
+    bool      reliable;
+};
+
+/* xTaskNotifyGive() and ulTaskNotifyTake(pdTRUE, timeout) */
+class Notification{
+
+    public:
+
+        Notification() : m_count(0) {}
+
+        void give()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_count++;
+            }
+            m_wake.notify_one();
+        }
+
+        uint32_t take(std::chrono::milliseconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, timeout, [this]{return m_count != 0;});
+            uint32_t count = m_count;
+            m_count = 0;
+            return count;
+        }
+
+    private:
+
+        std::mutex              m_mutex;
+        std::condition_variable m_wake;
+        uint32_t                m_count;
+
+};
+
+/* What the ring replaces, a lock around a bounded deque */
+template <typename T, uint16_t CAPACITY>
+class LockedQueue{
+
+    public:
+
+        bool push(const T& item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_items.size() >= CAPACITY - 1) return false;
+            m_items.push_back(item);
+            return true;
+        }
+
+        bool pop(T& item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_items.empty()) return false;
+            item = m_items.front();
+            m_items.pop_front();
+            return true;
+        }
+
+    private:
+
+        std::mutex    m_mutex;
+        std::deque<T> m_items;
+
+};
+
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void pin(uint8_t core)
+{
+    if(std::thread::hardware_concurrency() < 2) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/* Items through a queue as fast as both sides go, false on a bad item.
+   A full or empty queue yields, so it still works on a single CPU.    */
+template <typename Queue>
+static bool pump(Queue& queue, uint32_t items, double& seconds)
+{
+    std::atomic<bool> failed(false);
+    auto start  = std::chrono::steady_clock::now();
+
+    std::thread door([&]
+    {
+        pin(DOOR_CORE);
+        Command  command;
+        uint32_t expected = 0;
+        while(expected < items)
+        {
+            if(!queue.pop(command))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            if(command.sequence != expected || command.packet[0] != (char)expected)
+            {
+                failed = true;
+                return;
+            }
+            expected++;
+        }
+    });
+
+    pin(NETWORK_CORE);
+    Command command;
+    memset(&command, 0, sizeof(command));
+    for(uint32_t i = 0; i < items && !failed; i++)
+    {
+        command.sequence  = i;
+        command.packet[0] = (char)i;
+        command.length    = 1;
+        while(!queue.push(command) && !failed) std::this_thread::yield();
+    }
+    door.join();
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return !failed;
+}
+
+static int benchThroughput(uint32_t items)
+{
+    static SpscQueue<Command, COMMAND_QUEUE_SIZE>   ring;
+    static LockedQueue<Command, COMMAND_QUEUE_SIZE> locked;
+    double ringSeconds, lockedSeconds;
+
+    if(!pump(ring, items, ringSeconds) || !pump(locked, items, lockedSeconds))
+    {
+        fprintf(stderr, "spscbench: an item arrived out of order\n");
+        return 1;
+    }
+
+    printf("items           %u Commands of %zu bytes, %d slot queue\n", items, sizeof(Command), COMMAND_QUEUE_SIZE);
+    printf("SpscQueue       %7.2f M/s  %6.1f ns/item  %7.1f MB/s\n", items / ringSeconds / 1e6,
+           ringSeconds * 1e9 / items, items * sizeof(Command) / ringSeconds / 1e6);
+    printf("mutex deque     %7.2f M/s  %6.1f ns/item  %7.1f MB/s\n", items / lockedSeconds / 1e6,
+           lockedSeconds * 1e9 / items, items * sizeof(Command) / lockedSeconds / 1e6);
+    printf("Event           %zu bytes, %d slot queue, the same ring\n", sizeof(Event), EVENT_QUEUE_SIZE);
+    return 0;
+}
+
+static int benchLatency(uint32_t items)
+{
+    static SpscQueue<Command, COMMAND_QUEUE_SIZE> ring;
+    Notification          wake;
+    std::vector<uint32_t> latency;
+    latency.reserve(items);
+    std::atomic<bool>     failed(false);
+
+    /* doorTask(): drain, then sleep until the next deadline or a wake */
+    std::thread door([&]
+    {
+        pin(DOOR_CORE);
+        Command  command;
+        uint32_t expected = 0;
+        while(expected < items)
+        {
+            while(ring.pop(command))
+            {
+                latency.push_back(nowNs() - command.sent);
+                if(command.sequence != expected++) failed = true;
+            }
+            wake.take(std::chrono::milliseconds(DOOR_SLEEP));
+        }
+    });
+
+    /* pollNetwork(): a datagram now and then, each pushed then woken */
+    pin(NETWORK_CORE);
+    Command command;
+    memset(&command, 0, sizeof(command));
+    for(uint32_t i = 0; i < items; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        command.sequence = i;
+        command.sent     = nowNs();
+        while(!ring.push(command)) std::this_thread::yield();
+        wake.give();
+    }
+    door.join();
+
+    if(failed || latency.size() != items)
+    {
+        fprintf(stderr, "spscbench: %zu of %u items arrived, in order=%d\n", latency.size(), items, !failed);
+        return 1;
+    }
+    std::sort(latency.begin(), latency.end());
+    printf("items           %u, one every 50us\n", items);
+    printf("push to pop     p50 %6.1f us  p99 %6.1f us  p99.9 %6.1f us  max %7.1f us\n",
+           latency[items / 2] / 1e3, latency[items * 99 / 100] / 1e3, latency[items * 999 / 1000] / 1e3,
+           latency.back() / 1e3);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode  = argc > 1 ? argv[1] : "";
+    uint32_t    count = argc > 2 ? strtoul(argv[2], nullptr, 0) : 0;
+
+    if(mode == "throughput") return benchThroughput(count ? count : 20000000);
+    if(mode == "latency")    return benchLatency(count ? count : 20000);
+
+    fprintf(stderr, "Usage: %s throughput [items] | latency [items]\n", argv[0]);
+    return 2;
+}
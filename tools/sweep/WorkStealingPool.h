@@ -0,0 +1,90 @@
+#ifndef WORK_STEALING_POOL
+#define WORK_STEALING_POOL 1
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Runs task(index) for every index in [0, count) on 'threads' workers.
+   Each worker starts with a contiguous share in its own deque, works
+   it from the back and, once empty, steals from the front of the
+   others. Tasks here last milliseconds to seconds, so a mutex per
+   deque costs nothing next to them.                                 */
+class WorkStealingPool{
+
+    public:
+
+        typedef std::function<void(size_t index, unsigned worker)> Task;
+
+        WorkStealingPool(unsigned threads) : m_queues(threads ? threads : 1), m_done(0), m_steals(0) {}
+
+        void run(size_t count, const Task& task)
+        {
+            unsigned workers = m_queues.size();
+            for(unsigned w = 0; w < workers; w++)
+            {
+                m_queues[w].items.clear();
+                for(size_t i = count * w / workers; i < count * (w + 1) / workers; i++) m_queues[w].items.push_back(i);
+            }
+
+            std::vector<std::thread> threads;
+            for(unsigned w = 0; w < workers; w++) threads.emplace_back(&WorkStealingPool::work, this, w, std::cref(task));
+            for(std::thread& thread : threads) thread.join();
+        }
+
+        /* Safe to read while run() is going */
+        size_t done() const   {return m_done.load(std::memory_order_relaxed);}
+        size_t steals() const {return m_steals.load(std::memory_order_relaxed);}
+
+    private:
+
+        struct Queue{
+            std::mutex         lock;
+            std::deque<size_t> items;
+        };
+        std::vector<Queue>  m_queues;
+        std::atomic<size_t> m_done;
+        std::atomic<size_t> m_steals;
+
+        bool pop(unsigned worker, size_t& index)
+        {
+            Queue& own = m_queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if(own.items.empty()) return false;
+            index = own.items.back();
+            own.items.pop_back();
+            return true;
+        }
+
+        bool steal(unsigned worker, size_t& index)
+        {
+            for(unsigned i = 1; i < m_queues.size(); i++)
+            {
+                Queue& victim = m_queues[(worker + i) % m_queues.size()];
+                std::lock_guard<std::mutex> guard(victim.lock);
+                if(victim.items.empty()) continue;
+                index = victim.items.front();
+                victim.items.pop_front();
+                m_steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        /* Nothing is ever added once running, so all empty means finished */
+        void work(unsigned worker, const Task& task)
+        {
+            size_t index;
+            while(pop(worker, index) || steal(worker, index))
+            {
+                task(index, worker);
+                m_done.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+};
+
+#endif
@@ -0,0 +1,268 @@
+/* sweep - ranks light thresholds, close offsets and modes by simulation.
+
+   Usage: sweep [options]
+     --upper A:B[:S]   m_lightUpperThreshold range (default 20:80:5)
+     --lower A:B[:S]   m_lightLowerThreshold range (default 5:60:5)
+     --offset A:B[:S]  m_minuteOffset range (default -30:90:15)
+     --modes LIST      any of time,ldr,both (default all three)
+     --days N          simulated days per configuration (default 365)
+     --start DATE      first day, YYYY-MM-DD (default 2024-03-20, or the trace start)
+     --overcast D      daily random cloud, 0 clear to 1 dark (default 0.6)
+     --trace FILE      recorded "unix_time adc" light instead of the model
+     --seed N          noise and cloud, the same for every configuration (default 1)
+     --threads N       workers (default all cores)
+     --weights D,S,F,C score per minute open after dark, per minute shut in
+                       daylight, per flap and per cycle off one a day
+                       (default 10,1,120,60)
+     --top N           configurations listed (default 20)
+     --csv FILE        every configuration and its result
+
+   Every configuration is a doorsim year (tools/doorsim). Settings a mode
+   ignores aren't swept, time mode never reads the thresholds and LDR
+   mode never reads the offset. Lower scores are better. A configuration
+   the door doesn't take as asked, read back once it is set, is dropped
+   with a note rather than ranked as something it wasn't.             */
+#include "WorkStealingPool.h"
+#include <DoorYear.h>
+#include <LightTrace.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define REPORT_PERIOD       1000    // ms
+
+#define SWEEP_MODE_TIME     1
+#define SWEEP_MODE_LDR      2
+#define SWEEP_MODE_BOTH     4
+
+struct Range{
+    int from;
+    int to;
+    int step;
+};
+
+struct Weights{
+    double dark;
+    double shut;
+    double flap;
+    double cycle;
+};
+
+struct Candidate{
+    DoorSettings settings;
+    uint32_t     opens;
+    uint32_t     closes;
+    uint32_t     flaps;
+    double       darkMinutes;
+    double       shutMinutes;
+    double       score;
+    bool         refused;       // The door didn't take the settings, never simulated
+};
+
+static bool parseRange(const char* text, Range& range)
+{
+    range.step = 1;
+    int fields = sscanf(text, "%d:%d:%d", &range.from, &range.to, &range.step);
+    if(fields == 1) range.to = range.from;
+    return fields >= 1 && range.step > 0 && range.to >= range.from;
+}
+
+static bool parseDate(const char* text, time_t& epoch)
+{
+    struct tm date;
+    memset(&date, 0, sizeof(date));
+    if(strptime(text, "%Y-%m-%d", &date) == nullptr) return false;
+    epoch = timegm(&date);
+    return true;
+}
+
+static const char* modeName(const DoorSettings& s)
+{
+    return s.ldr && s.time ? "both" : s.ldr ? "ldr" : "time";
+}
+
+/* Every distinct configuration the door would behave differently under */
+static std::vector<Candidate> buildGrid(const Range& upper, const Range& lower, const Range& offset, uint8_t modes)
+{
+    std::vector<Candidate> grid;
+    Candidate c;
+    memset(&c, 0, sizeof(c));
+
+    if(modes & SWEEP_MODE_TIME)
+        for(int o = offset.from; o <= offset.to; o += offset.step)
+        {
+            c.settings = {D_LIGHT_THRESHOLD_TOP, D_LIGHT_THRESHOLD_BOTTOM, (int16_t)o, false, true};
+            grid.push_back(c);
+        }
+
+    for(int u = upper.from; u <= upper.to; u += upper.step)
+        for(int l = lower.from; l <= lower.to; l += lower.step)
+        {
+            if(u > 254 || l < 0 || !DoorHandler::validLightThresholds(u, l)) continue;
+
+            if(modes & SWEEP_MODE_LDR)
+            {
+                c.settings = {(uint8_t)u, (uint8_t)l, 0, true, false};
+                grid.push_back(c);
+            }
+            if(modes & SWEEP_MODE_BOTH)
+                for(int o = offset.from; o <= offset.to; o += offset.step)
+                {
+                    c.settings = {(uint8_t)u, (uint8_t)l, (int16_t)o, true, true};
+                    grid.push_back(c);
+                }
+        }
+    return grid;
+}
+
+int main(int argc, char** argv)
+{
+    Range       upper    = {20, 80, 5};
+    Range       lower    = {5, 60, 5};
+    Range       offset   = {-30, 90, 15};
+    uint8_t     modes    = SWEEP_MODE_TIME | SWEEP_MODE_LDR | SWEEP_MODE_BOTH;
+    uint32_t    days     = 365;
+    time_t      start    = 0;
+    double      overcast = 0.6;
+    const char* trace    = nullptr;
+    uint32_t    seed     = 1;
+    unsigned    threads  = std::thread::hardware_concurrency();
+    Weights     weights  = {10, 1, 120, 60};
+    size_t      top      = 20;
+    const char* csv      = nullptr;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg  = argv[i];
+        bool        more = i + 1 < argc;
+        bool        ok   = true;
+        if     (arg == "--upper"    && more) ok = parseRange(argv[++i], upper);
+        else if(arg == "--lower"    && more) ok = parseRange(argv[++i], lower);
+        else if(arg == "--offset"   && more) ok = parseRange(argv[++i], offset);
+        else if(arg == "--days"     && more) days     = atoi(argv[++i]);
+        else if(arg == "--start"    && more) ok = parseDate(argv[++i], start);
+        else if(arg == "--overcast" && more) overcast = atof(argv[++i]);
+        else if(arg == "--trace"    && more) trace    = argv[++i];
+        else if(arg == "--seed"     && more) seed     = strtoul(argv[++i], nullptr, 0);
+        else if(arg == "--threads"  && more) threads  = atoi(argv[++i]);
+        else if(arg == "--top"      && more) top      = atoi(argv[++i]);
+        else if(arg == "--csv"      && more) csv      = argv[++i];
+        else if(arg == "--weights"  && more)
+            ok = sscanf(argv[++i], "%lf,%lf,%lf,%lf", &weights.dark, &weights.shut, &weights.flap, &weights.cycle) == 4;
+        else if(arg == "--modes"    && more)
+        {
+            std::string list = argv[++i];
+            modes = (list.find("time") != std::string::npos ? SWEEP_MODE_TIME : 0)
+                  | (list.find("ldr")  != std::string::npos ? SWEEP_MODE_LDR  : 0)
+                  | (list.find("both") != std::string::npos ? SWEEP_MODE_BOTH : 0);
+            ok = modes != 0;
+        }
+        else ok = false;
+
+        if(!ok)
+        {
+            fprintf(stderr, "Usage: %s [--upper A:B[:S]] [--lower A:B[:S]] [--offset A:B[:S]] [--modes time,ldr,both]\n"
+                            "       [--days N] [--start YYYY-MM-DD] [--overcast D] [--trace FILE] [--seed N]\n"
+                            "       [--threads N] [--weights D,S,F,C] [--top N] [--csv FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(threads == 0) threads = 1;
+
+    LightTrace recorded;
+    Overcast   sky = {seed, overcast};
+    if(trace && !recorded.load(trace))
+    {
+        fprintf(stderr, "sweep: no samples in %s\n", trace);
+        return 1;
+    }
+    if(start == 0) start = trace ? recorded.start() / 86400 * 86400 : BOARD_EPOCH;
+
+    std::vector<Candidate> grid = buildGrid(upper, lower, offset, modes);
+    if(grid.empty())
+    {
+        fprintf(stderr, "sweep: no valid configurations, thresholds need %d between them\n", MIN_DIFF_IN_LIGHT);
+        return 1;
+    }
+    fprintf(stderr, "sweep: %zu configurations x %u days on %u threads\n", grid.size(), days, threads);
+
+    /* Each task writes only its own candidate, nothing else is shared */
+    WorkStealingPool pool(threads);
+    auto task = [&](size_t index, unsigned worker)
+    {
+        Candidate& c = grid[index];
+        DoorYear   year(c.settings, start, seed);
+        if(!year.valid())
+        {
+            c.refused = true;
+            return;
+        }
+        if(trace)         year.setLight(LightTrace::model, &recorded);
+        else if(overcast) year.setLight(Overcast::model, &sky);
+
+        YearResult result;
+        year.run(days, result);
+
+        c.opens       = result.opens;
+        c.closes      = result.closes;
+        c.flaps       = result.flaps;
+        c.darkMinutes = result.openDarkMs / 60000.0;
+        c.shutMinutes = result.closedLightMs / 60000.0;
+
+        double offCycle = (double)result.opens - days;
+        c.score = weights.dark * c.darkMinutes + weights.shut * c.shutMinutes
+                + weights.flap * c.flaps + weights.cycle * (offCycle < 0 ? -offCycle : offCycle);
+    };
+
+    auto wallStart = std::chrono::steady_clock::now();
+    std::thread runner([&]{pool.run(grid.size(), task);});
+    while(pool.done() < grid.size())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(REPORT_PERIOD));
+        fprintf(stderr, "sweep: %zu/%zu\r", pool.done(), grid.size());
+    }
+    runner.join();
+    fputc('\n', stderr);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    /* Ranked as simulated, anything the door refused isn't */
+    for(const Candidate& c : grid)
+        if(c.refused)
+            fprintf(stderr, "sweep: the door refused %s upper %d lower %d offset %d, dropped\n", modeName(c.settings),
+                    c.settings.upper, c.settings.lower, c.settings.offset);
+    grid.erase(std::remove_if(grid.begin(), grid.end(), [](const Candidate& c){return c.refused;}), grid.end());
+
+    std::stable_sort(grid.begin(), grid.end(), [](const Candidate& a, const Candidate& b){return a.score < b.score;});
+
+    printf("rank  mode  upper lower offset  opens closes flaps  dark min  shut min      score\n");
+    for(size_t i = 0; i < grid.size() && i < top; i++)
+    {
+        const Candidate& c = grid[i];
+        printf("%4zu  %-4s  %5d %5d %6d  %5u %6u %5u  %8.0f  %8.0f  %9.0f\n", i + 1, modeName(c.settings),
+               c.settings.upper, c.settings.lower, c.settings.offset, c.opens, c.closes, c.flaps,
+               c.darkMinutes, c.shutMinutes, c.score);
+    }
+
+    if(csv)
+    {
+        FILE* out = fopen(csv, "w");
+        if(out == nullptr)
+        {
+            perror(csv);
+            return 1;
+        }
+        fprintf(out, "mode,upper,lower,offset,opens,closes,flaps,dark_minutes,shut_minutes,score\n");
+        for(const Candidate& c : grid)
+            fprintf(out, "%s,%d,%d,%d,%u,%u,%u,%.1f,%.1f,%.1f\n", modeName(c.settings), c.settings.upper,
+                    c.settings.lower, c.settings.offset, c.opens, c.closes, c.flaps, c.darkMinutes, c.shutMinutes, c.score);
+        fclose(out);
+    }
+
+    double doorDays = (double)grid.size() * days;
+    fprintf(stderr, "sweep: %.1f s, %.0f simulated door days/s, %zu steals\n", wall, doorDays / wall, pool.steals());
+    return 0;
+}
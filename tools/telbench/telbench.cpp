@@ -0,0 +1,318 @@
+/* telbench - the heartbeat's cost, text against the binary frame.
+
+   Usage: telbench codec [heartbeats]
+          telbench day [days]
+     codec     random door states through both heartbeat paths. Text is
+               DoorHandler::Response's sprintf plus update()'s "(ID:n)-"
+               prefix; binary is telemetryEncode(). Both are decoded by
+               the collector's Collector::ingest(), every field checked
+               against what went in. Per heartbeat time and bytes.
+     day       one door, the real DoorTask and DoorHandler on a
+               VirtualBoard, through simulated days in each heartbeat
+               format ('b' 0, 1 and 2), every heartbeat handed straight
+               to a Collector. The door opens and closes as it would, so
+               its state changes when it really does. Heartbeat bytes per
+               day; the collector must rebuild the same state from each.
+
+   Exits non-zero if a heartbeat doesn't decode to what was sent.     */
+#include <Arduino.h>
+#include <DoorHandler.h>
+#include <DoorTask.h>
+#include <Telemetry.h>
+#include <VirtualBoard.h>
+#include "../collector/Collector.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define DOOR_STATES     4096        // Distinct doors, cycled through
+#define DAY_MS          86400000ULL
+#define DAY_EPOCH       1714521600  // 2024-05-01 00:00 UTC, the door runs through dawn and dusk
+
+static uint32_t seed = 1;
+static uint32_t next()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* A plausible door, every field exercised */
+static TelemetryStatus randomStatus()
+{
+    TelemetryStatus status;
+    status.sequence            = 0;
+    status.id                  = 1 + next() % 254;
+    status.state               = next() % 5;
+    status.motionState         = next() % 6;
+    status.flags               = next() & 0x0F;
+    status.motorPosition       = next() % 30000;
+    status.motorTopPosition    = 30000;
+    status.lightUpperThreshold = 40 + next() % 200;
+    status.lightLowerThreshold = next() % 40;
+    status.currentLight        = next() % 256;
+    status.motorMoveTime       = 1 + next() % 255;
+    status.minuteOffset        = (int16_t)(next() % 121) - 60;
+    status.closingMinute       = 1000 + next() % 300 + status.minuteOffset;
+    status.openingMinute       = 300 + next() % 300;
+    status.uptime              = 0;
+    return status;
+}
+
+/* As DoorHandler::getState() builds it */
+static DoorHandler::Response response(const TelemetryStatus& s)
+{
+    return DoorHandler::Response(s.id, s.state, s.motorPosition, s.motorTopPosition, s.lightUpperThreshold,
+                                 s.lightLowerThreshold, s.currentLight, s.flags & TELEMETRY_FLAG_AUTOMATED,
+                                 s.flags & TELEMETRY_FLAG_LDR, s.flags & TELEMETRY_FLAG_TIME,
+                                 s.flags & TELEMETRY_FLAG_MOTOR_SAVED, s.motorMoveTime, s.closingMinute,
+                                 s.openingMinute, s.minuteOffset, s.motionState);
+}
+
+/* Everything the text heartbeat carries, it has no sequence or uptime */
+static bool sameFields(const TelemetryStatus& a, const TelemetryStatus& b)
+{
+    return a.id == b.id && a.state == b.state && a.motionState == b.motionState && a.flags == b.flags &&
+           a.motorPosition == b.motorPosition && a.motorTopPosition == b.motorTopPosition &&
+           a.lightUpperThreshold == b.lightUpperThreshold && a.lightLowerThreshold == b.lightLowerThreshold &&
+           a.currentLight == b.currentLight && a.motorMoveTime == b.motorMoveTime &&
+           a.closingMinute == b.closingMinute && a.openingMinute == b.openingMinute && a.minuteOffset == b.minuteOffset;
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int benchCodec(uint32_t heartbeats)
+{
+    /* A working set of doors, cycled through for the timed loops */
+    std::vector<TelemetryStatus> doors(DOOR_STATES);
+    for(TelemetryStatus& status : doors) status = randomStatus();
+
+    std::vector<std::string> texts(DOOR_STATES);
+    std::vector<uint8_t>     frames((size_t)DOOR_STATES * TELEMETRY_FRAME_LENGTH);
+    uint64_t textBytes = 0;
+
+    /* Encode, a fresh Response each time as getState() returns */
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < heartbeats; i++)
+    {
+        uint32_t d = i % DOOR_STATES;
+        DoorHandler::Response state = response(doors[d]);
+        char message[RESPONSE_LENGTH];
+        int  length = snprintf(message, sizeof(message), "(ID:%d)-%s", doors[d].id, state.getResponse());
+        if(i < DOOR_STATES) texts[d].assign(message, length);
+        textBytes += length;
+    }
+    double textEncode = elapsedNs(start) / heartbeats;
+
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < heartbeats; i++)
+    {
+        uint32_t d = i % DOOR_STATES;
+        DoorHandler::Response state = response(doors[d]);
+        TelemetryStatus& status = state.getStatus();
+        status.sequence = d;
+        status.uptime   = d * 15;
+        telemetryEncode(status, &frames[(size_t)d * TELEMETRY_FRAME_LENGTH]);
+    }
+    double binaryEncode = elapsedNs(start) / heartbeats;
+
+    /* Decode, through the collector as it would arrive */
+    Collector collector;
+    Endpoint  from = {0x7F000001, 3333};
+    Reply     reply;
+
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < heartbeats; i++)
+    {
+        uint32_t d = i % DOOR_STATES;
+        collector.ingest((const uint8_t*)texts[d].data(), texts[d].size(), from, i, reply);
+        if(!sameFields(collector.doors().get(doors[d].id).status, doors[d]))
+        {
+            fprintf(stderr, "telbench: text heartbeat %u decoded differently: %s\n", i, texts[d].c_str());
+            return 1;
+        }
+    }
+    double textDecode = elapsedNs(start) / heartbeats;
+
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < heartbeats; i++)
+    {
+        uint32_t d = i % DOOR_STATES;
+        collector.ingest(&frames[(size_t)d * TELEMETRY_FRAME_LENGTH], TELEMETRY_FRAME_LENGTH, from, i, reply);
+        const TelemetryStatus& got = collector.doors().get(doors[d].id).status;
+        if(!sameFields(got, doors[d]) || got.sequence != d || got.uptime != d * 15)
+        {
+            fprintf(stderr, "telbench: binary heartbeat %u decoded differently\n", i);
+            return 1;
+        }
+    }
+    double binaryDecode = elapsedNs(start) / heartbeats;
+
+    printf("heartbeats      %u over %d door states, every field decoded as sent\n", heartbeats, DOOR_STATES);
+    printf("text            %6.1f ns encode  %6.1f ns decode  %5.1f bytes\n", textEncode, textDecode,
+           (double)textBytes / heartbeats);
+    printf("binary          %6.1f ns encode  %6.1f ns decode  %5d bytes\n", binaryEncode, binaryDecode,
+           TELEMETRY_FRAME_LENGTH);
+    printf("ratio           %6.1fx encode  %6.1fx decode  %5.1fx bytes\n", textEncode / binaryEncode,
+           textDecode / binaryDecode, (double)textBytes / heartbeats / TELEMETRY_FRAME_LENGTH);
+    return 0;
+}
+
+/* What reached the collector in one format's run */
+struct DayRun{
+    std::vector<TelemetryStatus> decoded;   // The collector's state after each heartbeat
+    uint64_t bytes;
+    uint32_t keyframes;                     // Full frames, all of them bar in delta
+    uint32_t requests;                      // 'k' sent back by the collector
+    bool     failed;                        // A heartbeat the collector didn't take
+};
+
+static DayRun*    dayRun       = nullptr;
+static Collector* dayCollector = nullptr;
+static uint8_t    dayDoor;
+static bool       dayKeyframe;              // The collector asked, passed on at the next step
+
+static bool dayConnected()                      {return true;}
+static bool daySendReliable(const char*, uint8_t) {return true;}
+static bool dayCommand(CommandParser&)          {return false;}
+
+/* The door's heartbeat, straight into the collector */
+static bool daySend(const uint8_t* data, uint8_t length)
+{
+    Endpoint from = {0x7F000001, 3333};
+    Reply    reply;
+    uint64_t heartbeats = dayCollector->stats().heartbeats;
+    bool     replied    = dayCollector->ingest(data, length, from, VirtualBoard::current().now(), reply);
+    if(dayCollector->stats().heartbeats == heartbeats) dayRun->failed = true;
+    if(replied && reply.data[0] == 'k')
+    {
+        dayRun->requests++;
+        dayKeyframe = true;
+    }
+
+    dayRun->bytes += length;
+    dayRun->keyframes += data[0] != TELEMETRY_DELTA_MAGIC;
+    dayRun->decoded.push_back(dayCollector->doors().get(dayDoor).status);
+    return true;
+}
+
+static const DoorLink dayLink = {dayConnected, daySend, daySendReliable, dayCommand};
+
+static unsigned long boardClock()
+{
+    return VirtualBoard::current().now();
+}
+
+/* A day or more of one format, the door task and control timer as loadgen runs them */
+static void runDays(uint8_t format, uint32_t days, DayRun& run)
+{
+    VirtualBoard board(1, DAY_EPOCH);
+    VirtualBoard::select(&board);
+    DoorHandler door(BOARD_MOTOR_PIN1, BOARD_MOTOR_PIN2, BOARD_ENCODER_PIN1, BOARD_ENCODER_PIN2, BOARD_LDR_PIN);
+    door.loadSettings();
+    door.setDoorId(1);                  // A blank EEPROM's 255 is no door to the collector
+    door.configureNTP();
+    Scheduler   scheduler(boardClock);
+    DoorTask    task(door, scheduler, dayLink);
+    Collector   collector;
+    task.select();
+    task.begin();
+
+    run          = DayRun();
+    dayRun       = &run;
+    dayCollector = &collector;
+    dayDoor      = door.getID();
+    dayKeyframe  = false;
+
+    char request[8];
+    char reply[RESPONSE_LENGTH];
+    task.execute(request, snprintf(request, sizeof(request), "b %d", format), reply, sizeof(reply));
+
+    uint64_t end = board.now() + days * DAY_MS;
+    while(board.now() < end)
+    {
+        uint32_t wait = scheduler.run();
+        if(task.isMoving())
+        {
+            door.control();
+            wait = DOOR_CONTROL_PERIOD/1000;
+        }
+        if(dayKeyframe)
+        {
+            dayKeyframe = false;
+            task.execute("k", 1, reply, sizeof(reply));
+        }
+        board.advance(wait);
+    }
+    dayRun       = nullptr;
+    dayCollector = nullptr;
+    VirtualBoard::select(nullptr);
+}
+
+static int benchDay(uint32_t days)
+{
+    static const char* names[] = {"text", "binary", "delta"};
+    DayRun runs[3];
+    for(uint8_t format = HEARTBEAT_TEXT; format <= HEARTBEAT_DELTA; format++) runDays(format, days, runs[format]);
+
+    /* Every format must leave the collector where text did, and the
+       binary ones agree on the sequence and uptime text hasn't got  */
+    const DayRun& text = runs[HEARTBEAT_TEXT];
+    for(uint8_t format = HEARTBEAT_TEXT; format <= HEARTBEAT_DELTA; format++)
+    {
+        const DayRun& run = runs[format];
+        bool same = !run.failed && run.decoded.size() == text.decoded.size();
+        for(size_t i = 0; same && i < run.decoded.size(); i++)
+        {
+            same = sameFields(run.decoded[i], text.decoded[i]);
+            if(format == HEARTBEAT_DELTA) same = same && run.decoded[i].sequence == runs[HEARTBEAT_BINARY].decoded[i].sequence &&
+                                                 run.decoded[i].uptime == runs[HEARTBEAT_BINARY].decoded[i].uptime;
+        }
+        if(!same)
+        {
+            fprintf(stderr, "telbench: the collector's %s day differs from text, %zu heartbeats against %zu%s\n",
+                    names[format], run.decoded.size(), text.decoded.size(), run.failed ? ", one was refused" : "");
+            return 1;
+        }
+    }
+
+    /* How often the door's state really changed, as the collector saw it */
+    uint32_t changes = 0, moves = 0;
+    for(size_t i = 1; i < text.decoded.size(); i++)
+    {
+        changes += !sameFields(text.decoded[i], text.decoded[i-1]);
+        moves   += text.decoded[i].state != text.decoded[i-1].state;
+    }
+
+    uint32_t heartbeats = text.decoded.size();
+    printf("heartbeats      %u over %u day%s, every %d s, %u with a change, %u of door state\n", heartbeats, days,
+           days > 1 ? "s" : "", HEARTBEAT_PERIOD / 1000, changes, moves);
+    for(uint8_t format = HEARTBEAT_TEXT; format <= HEARTBEAT_DELTA; format++)
+    {
+        const DayRun& run = runs[format];
+        printf("%-15s %8.0f bytes/day  %5.1f bytes/heartbeat  %4.1f%% of text", names[format],
+               (double)run.bytes / days, (double)run.bytes / heartbeats, 100.0 * run.bytes / text.bytes);
+        if(format == HEARTBEAT_DELTA) printf("  %u keyframes, %u requested", run.keyframes, run.requests);
+        printf("\n");
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode  = argc > 1 ? argv[1] : "";
+    uint32_t    count = argc > 2 ? strtoul(argv[2], nullptr, 0) : 0;
+
+    if(mode == "codec") return benchCodec(count ? count : 1000000);
+    if(mode == "day")   return benchDay(count ? count : 1);
+
+    fprintf(stderr, "Usage: %s codec [heartbeats] | day [days]\n", argv[0]);
+    return 2;
+}